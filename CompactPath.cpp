@@ -0,0 +1,172 @@
+
+#include "CompactPath.h"
+#include "Path.h"
+#include <math.h>
+
+// the differences, as a prediction from the points before. Row m is for when we
+// have m points before this one in the block.
+static const int s_predict[COMPACTPATH_ORDER+1][COMPACTPATH_ORDER] =
+{
+	{ 0, 0, 0, 0 },
+	{ 1, 0, 0, 0 },
+	{ 2, -1, 0, 0 },
+	{ 3, -3, 1, 0 },
+	{ 4, -6, 4, -1 },
+};
+
+static long long predict(const long long *history, int numHistory)
+{
+	long long result = 0;
+	for ( int k=0 ; k<numHistory ; k++ )
+	{
+		result += s_predict[numHistory][k]*history[k];
+	}
+	return result;
+}
+
+// history[0] is the last point
+static void pushHistory(long long *history, long long value)
+{
+	for ( int k=COMPACTPATH_ORDER-1 ; k>0 ; k-- )
+	{
+		history[k] = history[k-1];
+	}
+	history[0] = value;
+}
+
+// zigzag, so small negatives are small too, then 7 bits a byte
+static void writeVarint(std::vector<unsigned char> &out, long long value)
+{
+	unsigned long long bits = ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+	while ( bits >= 0x80 )
+	{
+		out.push_back((unsigned char)(bits | 0x80));
+		bits >>= 7;
+	}
+	out.push_back((unsigned char)bits);
+}
+
+static long long readVarint(const unsigned char *data, int &pos)
+{
+	unsigned long long bits = 0;
+	int shift = 0;
+	while ( true )
+	{
+		unsigned char b = data[pos++];
+		bits |= (unsigned long long)(b & 0x7f) << shift;
+		if ( (b & 0x80) == 0 ) break;
+		shift += 7;
+	}
+	return (long long)(bits >> 1) ^ -(long long)(bits & 1);
+}
+
+CompactPath::CompactPath()
+{
+	clear();
+}
+
+void CompactPath::clear()
+{
+	m_originX = 0.0;
+	m_originY = 0.0;
+	m_quantum = COMPACTPATH_DEFAULT_QUANTUM;
+	m_numPoints = 0;
+	m_bytes.clear();
+	m_blockStarts.clear();
+}
+
+int CompactPath::getMemorySize()
+{
+	return (int)(sizeof(CompactPath) + m_bytes.capacity() + m_blockStarts.capacity()*sizeof(int));
+}
+
+bool CompactPath::encode(const double *x, const double *y, int count, double quantum)
+{
+	clear();
+
+	// written this way round so a nan quantum fails too
+	if ( !(quantum > 0.0) ) return false;
+	if ( count <= 0 ) return true;
+
+	m_originX = x[0];
+	m_originY = y[0];
+	m_quantum = quantum;
+	m_numPoints = count;
+
+	long long historyX[COMPACTPATH_ORDER] = { 0 };
+	long long historyY[COMPACTPATH_ORDER] = { 0 };
+	int numHistory = 0;
+	for ( int i=0 ; i<count ; i++ )
+	{
+		// every block starts over, so it can be decoded on its own
+		if ( (i % COMPACTPATH_BLOCK_SIZE) == 0 )
+		{
+			m_blockStarts.push_back((int)m_bytes.size());
+			numHistory = 0;
+		}
+
+		long long qx = llround((x[i] - m_originX)/quantum);
+		long long qy = llround((y[i] - m_originY)/quantum);
+		writeVarint(m_bytes, qx - predict(historyX, numHistory));
+		writeVarint(m_bytes, qy - predict(historyY, numHistory));
+		pushHistory(historyX, qx);
+		pushHistory(historyY, qy);
+		if ( numHistory < COMPACTPATH_ORDER ) numHistory++;
+	}
+
+	// we're done growing
+	std::vector<unsigned char>(m_bytes).swap(m_bytes);
+	std::vector<int>(m_blockStarts).swap(m_blockStarts);
+	return true;
+}
+
+bool CompactPath::encode(Path &path, double quantum)
+{
+	int count = path.getStopPoint()+1;
+	path.ensurePoints(count-1);
+
+	std::vector<double> x(count);
+	std::vector<double> y(count);
+	for ( int i=0 ; i<count ; i++ )
+	{
+		x[i] = path.m_points[i].m_fixX;
+		y[i] = path.m_points[i].m_fixY;
+	}
+	return encode(&x[0], &y[0], count, quantum);
+}
+
+void CompactPath::getPoint(int pointIdx, double &outX, double &outY)
+{
+	decode(pointIdx, 1, &outX, &outY);
+}
+
+void CompactPath::decode(int first, int count, double *outX, double *outY)
+{
+	if ( (first < 0) || (count <= 0) || (first+count > m_numPoints) ) return;
+
+	// start at the block it's in. The blocks are back to back, so from there
+	// it's just reading on.
+	int i = first - (first % COMPACTPATH_BLOCK_SIZE);
+	int pos = m_blockStarts[i/COMPACTPATH_BLOCK_SIZE];
+	const unsigned char *data = &m_bytes[0];
+
+	long long historyX[COMPACTPATH_ORDER] = { 0 };
+	long long historyY[COMPACTPATH_ORDER] = { 0 };
+	int numHistory = 0;
+	for ( ; i<first+count ; i++ )
+	{
+		if ( (i % COMPACTPATH_BLOCK_SIZE) == 0 ) numHistory = 0;
+
+		long long qx = readVarint(data, pos) + predict(historyX, numHistory);
+		long long qy = readVarint(data, pos) + predict(historyY, numHistory);
+		pushHistory(historyX, qx);
+		pushHistory(historyY, qy);
+		if ( numHistory < COMPACTPATH_ORDER ) numHistory++;
+
+		if ( i >= first )
+		{
+			outX[i-first] = m_originX + (double)qx*m_quantum;
+			outY[i-first] = m_originY + (double)qy*m_quantum;
+		}
+	}
+}
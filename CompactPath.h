@@ -0,0 +1,57 @@
+
+#ifndef __COMPACTPATH__
+#define __COMPACTPATH__
+
+#include <vector>
+
+class Path;
+
+// points are rounded to this many km by default. So each axis is within half a
+// km, and the point as a whole within quantum*sqrt(2)/2, about 0.71 km.
+#define COMPACTPATH_DEFAULT_QUANTUM 1.0
+
+// the points are coded in blocks of this many, so a point can be got at without
+// decoding everything before it
+#define COMPACTPATH_BLOCK_SIZE 64
+
+// how many differences we take. Orbits are smooth enough that the fourth
+// difference of a day's steps is a few km, so it fits in a byte.
+#define COMPACTPATH_ORDER 4
+
+// A path's points in a few bytes each, for keeping lots of them around. Each point
+// is rounded to a multiple of the quantum from the first one, and what's stored is
+// the difference from what the points before it predict, as a variable length int.
+// With the default quantum a path takes about two and a half bytes a point, where
+// FGDoubleVectors take 16.
+class CompactPath
+{
+public:
+	CompactPath();
+
+	// false (and left empty) if the quantum isn't positive
+	bool encode(const double *x, const double *y, int count, double quantum);
+	bool encode(Path &path, double quantum); // up to its stop point
+	void clear();
+
+	int getNumPoints() { return m_numPoints; }
+	double getQuantum() { return m_quantum; }
+	int getMemorySize(); // bytes, all in
+
+	// one point, decoding from the start of its block
+	void getPoint(int pointIdx, double &outX, double &outY);
+
+	// count points from first, which is quicker than one at a time
+	void decode(int first, int count, double *outX, double *outY);
+
+private:
+	double m_originX;
+	double m_originY;
+	double m_quantum;
+	int m_numPoints;
+
+	// the coded points, and where each block starts in them
+	std::vector<unsigned char> m_bytes;
+	std::vector<int> m_blockStarts;
+};
+
+#endif
@@ -0,0 +1,51 @@
+
+#include "DriftMonitor.h"
+
+DriftMonitor::DriftMonitor()
+{
+	m_threshold = DRIFT_DEFAULT_THRESHOLD;
+	reset();
+}
+
+void DriftMonitor::reset()
+{
+	m_maxEnergyDrift = 0.0;
+	m_maxAngMomDrift = 0.0;
+	m_worstIdx = -1;
+	m_numArcs = 0;
+	m_bInArc = false;
+	m_sgp = 0.0;
+	m_refEnergy = 0.0;
+	m_refAngMom = 0.0;
+	m_energyScale = 0.0;
+	m_angMomScale = 0.0;
+}
+
+void DriftMonitor::begin(double sgp, double r, double refEnergy, double refAngMom)
+{
+	// nothing to measure against at the center, or with no gravity
+	if ( (r <= 0.0) || (sgp <= 0.0) )
+	{
+		m_bInArc = false;
+		return;
+	}
+
+	m_sgp = sgp;
+	m_refEnergy = refEnergy;
+	m_refAngMom = refAngMom;
+	m_energyScale = r/sgp;
+	m_angMomScale = 1.0/sqrt(sgp*r);
+	m_bInArc = true;
+	m_numArcs++;
+}
+
+void DriftMonitor::beginArc(double sgp, double relX, double relY, double velX, double velY)
+{
+	double r = sqrt(relX*relX + relY*relY);
+	if ( r <= 0.0 )
+	{
+		m_bInArc = false;
+		return;
+	}
+	begin(sgp, r, 0.5*(velX*velX + velY*velY) - sgp/r, fabs(relX*velY - relY*velX));
+}
@@ -0,0 +1,75 @@
+
+#ifndef __DRIFTMONITOR__
+#define __DRIFTMONITOR__
+
+#include <math.h>
+
+// how much drift we put up with before flagging a run. See DriftMonitor for the units.
+#define DRIFT_DEFAULT_THRESHOLD (0.01)
+
+// we only look at every so many points. The drift changes smoothly over an orbit,
+// so this still finds the worst of it, and the square root and divide per point
+// would otherwise cost about a third of the propagation.
+#define DRIFT_CHECK_STRIDE 4
+
+// Watches energy and angular momentum while nothing but gravity acts, which is
+// when they shouldn't change. If they do, the steps are too coarse for the path
+// (usually because it swings close to the sun).
+//
+// Drift is measured against the start of each coast arc: energy relative to the
+// potential there (sgp/r), and angular momentum relative to a circular orbit's
+// there (sqrt(sgp*r)). So they mean the same thing on any orbit, escapes included.
+class DriftMonitor
+{
+public:
+	DriftMonitor();
+
+	// clear the results, for a new run
+	void reset();
+
+	// start a coast arc. Positions are relative to the orbitee.
+	void beginArc(double sgp, double relX, double relY, double velX, double velY);
+
+	void endArc() { m_bInArc = false; }
+	bool isInArc() { return m_bInArc; }
+
+	// note the state at a point in the arc
+	inline void check(int pointIdx, double relX, double relY, double velX, double velY)
+	{
+		if ( !m_bInArc || ((pointIdx % DRIFT_CHECK_STRIDE) != 0) ) return;
+
+		double r = sqrt(relX*relX + relY*relY);
+		double energy = 0.5*(velX*velX + velY*velY) - m_sgp/r;
+		double angMom = fabs(relX*velY - relY*velX);
+		double energyDrift = fabs(energy - m_refEnergy)*m_energyScale;
+		double angMomDrift = fabs(angMom - m_refAngMom)*m_angMomScale;
+
+		// the worst point is the one with the biggest drift of either kind
+		double worst = (m_maxEnergyDrift > m_maxAngMomDrift) ? m_maxEnergyDrift : m_maxAngMomDrift;
+		if ( (energyDrift > worst) || (angMomDrift > worst) ) m_worstIdx = pointIdx;
+		if ( energyDrift > m_maxEnergyDrift ) m_maxEnergyDrift = energyDrift;
+		if ( angMomDrift > m_maxAngMomDrift ) m_maxAngMomDrift = angMomDrift;
+	}
+
+	bool isFlagged() { return (m_maxEnergyDrift > m_threshold) || (m_maxAngMomDrift > m_threshold); }
+
+	double m_threshold;
+
+	// the results since the last reset
+	double m_maxEnergyDrift;
+	double m_maxAngMomDrift;
+	int m_worstIdx; // the point with the worst drift of either kind, or -1
+	int m_numArcs;
+
+private:
+	void begin(double sgp, double r, double refEnergy, double refAngMom);
+
+	bool m_bInArc;
+	double m_sgp;
+	double m_refEnergy;
+	double m_refAngMom;
+	double m_energyScale; // 1 over the scales above
+	double m_angMomScale;
+};
+
+#endif
@@ -0,0 +1,382 @@
+
+#include "IntegratorHarness.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+
+// Run a path with some kernel and some number of steps a day. This is the path's
+// own propagation, so it steps (and halts) exactly as Path does.
+template <typename Kernel>
+static void runKernel(Path &path, int substeps, int lastIdx, double *outX, double *outY)
+{
+	static typename Kernel::Vec points[PATH_NUM_POINTS];
+
+	int oldSubsteps = path.getSubsteps();
+	path.setSubsteps(substeps);
+	int numPoints = path.propagate<Kernel>(points);
+	path.setSubsteps(oldSubsteps);
+
+	// if this one halted sooner, it sits at the halt point from there on
+	for ( int i=0 ; i<=lastIdx ; i++ )
+	{
+		int from = (i < numPoints) ? i : numPoints-1;
+		outX[i] = (double)points[from].x();
+		outY[i] = (double)points[from].y();
+	}
+}
+
+// The golden runs. This is RK4 in long double, but unlike the kernels it works
+// the thrust out again at every stage. The kernels hold the thrust for a whole
+// step, which makes any of them first order while the ship is thrusting, since
+// the thrust turns with the direction to the orbitee. It walks the acceleration
+// points itself rather than going through ScheduleStepper, which holds the thrust.
+static void runGolden(Path &path, int substeps, int lastIdx, double *outX, double *outY)
+{
+	typedef long double T;
+	typedef KernelVec<T> Vec;
+
+	KernelState<Vec> state;
+	state.m_pos = Vec((T)path.m_startPos.m_fixX, (T)path.m_startPos.m_fixY);
+	state.m_vel = Vec((T)path.m_startVel.m_fixX, (T)path.m_startVel.m_fixY);
+	Vec center((T)path.m_orbitee->m_pos.m_fixX, (T)path.m_orbitee->m_pos.m_fixY);
+	T sgp = (T)path.m_orbitee->m_sgp;
+	T dt = (T)(POINTS_TIME/(double)substeps);
+	T halfDt = dt*(T)0.5;
+
+	outX[0] = path.m_startPos.m_fixX;
+	outY[0] = path.m_startPos.m_fixY;
+
+	AccelerationPointIter apIter = path.m_accelerationPoints.begin();
+	AccelerationPoint *ap = NULL;
+	for ( int i=1 ; i<=lastIdx ; i++ )
+	{
+		while ( (apIter != path.m_accelerationPoints.end()) && ((*apIter)->m_pointIdx <= i) )
+		{
+			ap = *apIter;
+			apIter++;
+		}
+		T rotX = (ap != NULL) ? (T)ap->m_rotX : (T)0;
+		T rotY = (ap != NULL) ? (T)ap->m_rotY : (T)0;
+
+		bool bRedirect = (ap != NULL) && (ap->m_pointIdx == i) && (ap->m_type == ACCTYPE_REDIRECT);
+
+		for ( int s=0 ; s<substeps ; s++ )
+		{
+			if ( bRedirect && (s == 0) )
+			{
+				// Path kicks the velocity, then redirects it, then moves. A redirect
+				// can't go in the middle of an RK4 step, so this one substep is
+				// Path's own Euler step, and the redirect comes at the same place.
+				Vec thrust = kernelThrustRot(center, state.m_pos, rotX, rotY);
+				EulerIntegrator::step(state, center, sgp, thrust, dt, true);
+				continue;
+			}
+
+			Vec p1 = state.m_pos;
+			Vec v1 = state.m_vel;
+			Vec a1 = kernelGravity(center, sgp, p1) + kernelThrustRot(center, p1, rotX, rotY);
+
+			Vec p2 = p1 + v1*halfDt;
+			Vec v2 = v1 + a1*halfDt;
+			Vec a2 = kernelGravity(center, sgp, p2) + kernelThrustRot(center, p2, rotX, rotY);
+
+			Vec p3 = p1 + v2*halfDt;
+			Vec v3 = v1 + a2*halfDt;
+			Vec a3 = kernelGravity(center, sgp, p3) + kernelThrustRot(center, p3, rotX, rotY);
+
+			Vec p4 = p1 + v3*dt;
+			Vec v4 = v1 + a3*dt;
+			Vec a4 = kernelGravity(center, sgp, p4) + kernelThrustRot(center, p4, rotX, rotY);
+
+			T sixth = dt/(T)6;
+			state.m_pos += (v1 + (v2 + v3)*(T)2 + v4)*sixth;
+			state.m_vel += (a1 + (a2 + a3)*(T)2 + a4)*sixth;
+		}
+
+		outX[i] = (double)state.m_pos.x();
+		outY[i] = (double)state.m_pos.y();
+	}
+}
+
+static HarnessKernel s_kernels[] =
+{
+	{ "euler/double",    runKernel<PathKernelDefault> },
+	{ "euler/float",     runKernel<PathKernelFast> },
+	{ "leapfrog/double", runKernel<PathKernelLeapfrog> },
+	{ "rk4/double",      runKernel<PathKernelRK4> },
+	{ "rk4/long double", runKernel<PathKernelPrecise> },
+};
+#define HARNESS_NUM_KERNELS ((int)(sizeof(s_kernels)/sizeof(s_kernels[0])))
+
+static bool compareCost(const HarnessResult &a, const HarnessResult &b)
+{
+	return a.m_usPerRun < b.m_usPerRun;
+}
+
+IntegratorHarness::IntegratorHarness()
+{
+	m_fixtureDir = ".";
+	m_numGoldenMade = 0;
+}
+
+IntegratorHarness::~IntegratorHarness()
+{
+}
+
+void IntegratorHarness::init(const char *fixtureDir)
+{
+	m_fixtureDir = fixtureDir;
+
+	// the app as it starts: earth coasting, and the ship with its stock burn
+	m_stock.init();
+
+	// a ship that cuts off, coasts, then redirects and burns again
+	m_burnShip.init(&m_stock.m_sun, m_stock.m_earthPath.m_startPos, m_stock.m_earthPath.m_startVel, 0x7f7f7f, 5);
+	AccelerationPoint *ap = m_burnShip.createAccelerationPoint(60);
+	ap->setAccel(0.0, 0.0);
+	ap = m_burnShip.createAccelerationPoint(200);
+	ap->m_type = ACCTYPE_REDIRECT;
+	ap->setAccel(2.0, PATH_ACCELERATION*0.5);
+	ap = m_burnShip.createAccelerationPoint(260);
+	ap->setAccel(0.0, 0.0);
+	m_burnShip.calcPoints();
+
+	addScenario("earth", &m_stock.m_earthPath);
+	addScenario("stock-ship", &m_stock.m_ship);
+	addScenario("burn-ship", &m_burnShip);
+
+	m_runX.resize(PATH_NUM_POINTS);
+	m_runY.resize(PATH_NUM_POINTS);
+}
+
+void IntegratorHarness::addScenario(const char *name, Path *path)
+{
+	HarnessScenario scenario;
+	scenario.m_name = name;
+	scenario.m_path = path;
+
+	// arrival is wherever the path ends, which is sooner if it falls in to the sun
+	path->calcPoints();
+	scenario.m_lastIdx = (path->m_haltIdx != -1) ? path->m_haltIdx : path->getStopPoint();
+
+	m_scenarios.push_back(scenario);
+	HarnessScenario &added = m_scenarios.back();
+	if ( !loadGolden(added) )
+	{
+		printf("Making the golden run for %s...\n", name);
+		makeGolden(added);
+		m_numGoldenMade++;
+		saveGolden(added);
+	}
+}
+
+void IntegratorHarness::getFixtureName(HarnessScenario &scenario, char *outName)
+{
+	sprintf(outName, "%s/golden_%s.dat", m_fixtureDir, scenario.m_name);
+}
+
+// A fixture is this header, then the golden x's and y's, all as doubles the way
+// they are in memory. The header is the version, the golden settings and the
+// scenario's inputs, so a fixture is remade when any of them change.
+void IntegratorHarness::getFixtureHeader(HarnessScenario &scenario, std::vector<double> &outHeader)
+{
+	Path *path = scenario.m_path;
+	outHeader.clear();
+	outHeader.push_back(HARNESS_FIXTURE_VERSION);
+	outHeader.push_back(HARNESS_GOLDEN_SUBSTEPS);
+	outHeader.push_back(scenario.m_lastIdx);
+	outHeader.push_back(path->m_startPos.m_fixX);
+	outHeader.push_back(path->m_startPos.m_fixY);
+	outHeader.push_back(path->m_startVel.m_fixX);
+	outHeader.push_back(path->m_startVel.m_fixY);
+	outHeader.push_back(path->m_orbitee->m_sgp);
+	outHeader.push_back((double)path->m_accelerationPoints.size());
+	for ( AccelerationPointIter iter = path->m_accelerationPoints.begin() ; iter != path->m_accelerationPoints.end() ; iter++ )
+	{
+		AccelerationPoint *ap = *iter;
+		outHeader.push_back(ap->m_pointIdx);
+		outHeader.push_back(ap->m_type);
+		outHeader.push_back(ap->m_angle);
+		outHeader.push_back(ap->m_mag);
+	}
+}
+
+bool IntegratorHarness::loadGolden(HarnessScenario &scenario)
+{
+	char filename[1024];
+	getFixtureName(scenario, filename);
+	FILE *f = fopen(filename, "rb");
+	if ( f == NULL ) return false;
+
+	// it has to be for the scenario as it is now
+	std::vector<double> expected;
+	getFixtureHeader(scenario, expected);
+
+	std::vector<double> header(expected.size());
+	bool bGood = (fread(&header[0], sizeof(double), header.size(), f) == header.size()) && (header == expected);
+	if ( bGood )
+	{
+		int count = scenario.m_lastIdx+1;
+		scenario.m_goldenX.resize(count);
+		scenario.m_goldenY.resize(count);
+		bGood = (fread(&scenario.m_goldenX[0], sizeof(double), count, f) == (size_t)count) &&
+			(fread(&scenario.m_goldenY[0], sizeof(double), count, f) == (size_t)count);
+	}
+	fclose(f);
+
+	if ( !bGood )
+	{
+		printf("The golden run in %s is out of date\n", filename);
+	}
+	return bGood;
+}
+
+void IntegratorHarness::saveGolden(HarnessScenario &scenario)
+{
+	char filename[1024];
+	getFixtureName(scenario, filename);
+	FILE *f = fopen(filename, "wb");
+	if ( f == NULL )
+	{
+		printf("Couldn't write %s. The golden run will be made again next time.\n", filename);
+		return;
+	}
+
+	std::vector<double> header;
+	getFixtureHeader(scenario, header);
+
+	int count = scenario.m_lastIdx+1;
+	fwrite(&header[0], sizeof(double), header.size(), f);
+	fwrite(&scenario.m_goldenX[0], sizeof(double), count, f);
+	fwrite(&scenario.m_goldenY[0], sizeof(double), count, f);
+	fclose(f);
+}
+
+void IntegratorHarness::makeGolden(HarnessScenario &scenario)
+{
+	int count = scenario.m_lastIdx+1;
+	scenario.m_goldenX.resize(count);
+	scenario.m_goldenY.resize(count);
+	runGolden(*scenario.m_path, HARNESS_GOLDEN_SUBSTEPS, scenario.m_lastIdx, &scenario.m_goldenX[0], &scenario.m_goldenY[0]);
+}
+
+void IntegratorHarness::run(double budget)
+{
+	for ( int i=0 ; i<(int)m_scenarios.size() ; i++ )
+	{
+		runScenario(m_scenarios[i], budget);
+	}
+}
+
+void IntegratorHarness::measure(HarnessScenario &scenario, HarnessKernel &kernel, int substeps, HarnessResult &outResult)
+{
+	// time it over enough runs to get past the clock's resolution
+	int numRuns = 0;
+	clock_t start = clock();
+	clock_t now = start;
+	while ( (numRuns == 0) || ((double)(now - start) < HARNESS_MIN_TIMING*CLOCKS_PER_SEC) )
+	{
+		kernel.m_run(*scenario.m_path, substeps, scenario.m_lastIdx, &m_runX[0], &m_runY[0]);
+		numRuns++;
+		now = clock();
+	}
+
+	outResult.m_kernelName = kernel.m_name;
+	outResult.m_substeps = substeps;
+	outResult.m_usPerRun = (double)(now - start)*1000000.0/CLOCKS_PER_SEC/(double)numRuns;
+	outResult.m_maxErr = 0.0;
+	for ( int i=0 ; i<=scenario.m_lastIdx ; i++ )
+	{
+		double dx = m_runX[i] - scenario.m_goldenX[i];
+		double dy = m_runY[i] - scenario.m_goldenY[i];
+		double err = sqrt(dx*dx + dy*dy);
+		if ( err > outResult.m_maxErr ) outResult.m_maxErr = err;
+		if ( i == scenario.m_lastIdx ) outResult.m_arrivalErr = err;
+	}
+	outResult.m_bPareto = false;
+}
+
+bool IntegratorHarness::matchesPath(HarnessScenario &scenario)
+{
+	s_kernels[0].m_run(*scenario.m_path, 1, scenario.m_lastIdx, &m_runX[0], &m_runY[0]);
+	for ( int i=0 ; i<=scenario.m_lastIdx ; i++ )
+	{
+		FGDoubleVector &p = scenario.m_path->getPoint(i);
+		if ( (p.m_fixX != m_runX[i]) || (p.m_fixY != m_runY[i]) ) return false;
+	}
+	return true;
+}
+
+bool IntegratorHarness::matchesPath(int scenarioIdx)
+{
+	return matchesPath(m_scenarios[scenarioIdx]);
+}
+
+double IntegratorHarness::getArrivalErr(int scenarioIdx, const char *kernelName, int substeps)
+{
+	for ( int k=0 ; k<HARNESS_NUM_KERNELS ; k++ )
+	{
+		if ( strcmp(s_kernels[k].m_name, kernelName) != 0 ) continue;
+
+		HarnessResult result;
+		measure(m_scenarios[scenarioIdx], s_kernels[k], substeps, result);
+		return result.m_arrivalErr;
+	}
+	return -1.0;
+}
+
+void IntegratorHarness::runScenario(HarnessScenario &scenario, double budget)
+{
+	std::vector<HarnessResult> results;
+	for ( int k=0 ; k<HARNESS_NUM_KERNELS ; k++ )
+	{
+		for ( int substeps=1 ; substeps<=HARNESS_MAX_SUBSTEPS ; substeps*=2 )
+		{
+			HarnessResult result;
+			measure(scenario, s_kernels[k], substeps, result);
+			results.push_back(result);
+		}
+	}
+
+	// the pareto front: cheapest first, each more accurate than everything cheaper
+	std::sort(results.begin(), results.end(), compareCost);
+	double bestErr = -1.0;
+	for ( int i=0 ; i<(int)results.size() ; i++ )
+	{
+		if ( (bestErr < 0.0) || (results[i].m_arrivalErr < bestErr) )
+		{
+			results[i].m_bPareto = true;
+			bestErr = results[i].m_arrivalErr;
+		}
+	}
+
+	// check the harness steps the way Path does
+	bool bMatches = matchesPath(scenario);
+
+	printf("\n%s: %d days to arrival. euler/double x1 %s the path's points.\n", scenario.m_name, scenario.m_lastIdx,
+		bMatches ? "matches" : "DOES NOT MATCH");
+	printf("%-16s %8s %12s %18s %18s\n", "kernel", "steps/d", "us/run", "arrival err (km)", "max err (km)");
+	for ( int i=0 ; i<(int)results.size() ; i++ )
+	{
+		HarnessResult &r = results[i];
+		printf("%-16s %8d %12.1f %18.3f %18.3f %s\n", r.m_kernelName, r.m_substeps, r.m_usPerRun,
+			r.m_arrivalErr, r.m_maxErr, r.m_bPareto ? "*" : "");
+	}
+
+	if ( budget > 0.0 )
+	{
+		// results are cheapest first, so the first one in budget is the answer
+		for ( int i=0 ; i<(int)results.size() ; i++ )
+		{
+			if ( results[i].m_arrivalErr <= budget )
+			{
+				printf("Cheapest within %.1f km: %s, %d steps a day, %.1f us\n", budget,
+					results[i].m_kernelName, results[i].m_substeps, results[i].m_usPerRun);
+				return;
+			}
+		}
+		printf("Nothing gets within %.1f km\n", budget);
+	}
+}
@@ -0,0 +1,106 @@
+
+#ifndef __INTEGRATORHARNESS__
+#define __INTEGRATORHARNESS__
+
+#include "OBScenario.h"
+#include <vector>
+
+// the golden runs take this many steps a day
+#define HARNESS_GOLDEN_SUBSTEPS 512
+
+// bump this when the fixture layout or the golden method changes, so old fixtures are remade
+#define HARNESS_FIXTURE_VERSION 2
+
+// the most steps a day we try
+#define HARNESS_MAX_SUBSTEPS 64
+
+// how long we time each configuration for, in seconds
+#define HARNESS_MIN_TIMING 0.02
+
+// propagate a path's inputs with some kernel and some number of steps a day,
+// writing the positions at each day from 0 to lastIdx
+typedef void (*HarnessRunFunc)(Path &path, int substeps, int lastIdx, double *outX, double *outY);
+
+// a kernel we try
+class HarnessKernel
+{
+public:
+	const char *m_name;
+	HarnessRunFunc m_run;
+};
+
+// how one configuration did on one scenario
+class HarnessResult
+{
+public:
+	const char *m_kernelName;
+	int m_substeps;
+	double m_usPerRun;
+	double m_arrivalErr; // km from the golden run, at the last point
+	double m_maxErr;     // km, the worst over every point
+	bool m_bPareto;      // nothing cheaper is as accurate
+};
+
+// a path we measure against its golden run
+class HarnessScenario
+{
+public:
+	const char *m_name;
+	Path *m_path;
+	int m_lastIdx; // the arrival
+	std::vector<double> m_goldenX;
+	std::vector<double> m_goldenY;
+};
+
+// Measures accuracy against cost for every kernel and step size. Each reference
+// scenario is compared against a golden run: fourth order, long double, at
+// HARNESS_GOLDEN_SUBSTEPS steps a day, with the thrust worked out at every stage. Golden runs are kept as fixtures
+// (the ones for the stock scenarios are checked in under fixtures/) and only made
+// when they're missing or their scenario has changed.
+//
+// The thrust is worked out at every substep, the same way Path does it once a day,
+// so a path's points are the 1 step a day Euler run.
+class IntegratorHarness
+{
+public:
+	IntegratorHarness();
+	~IntegratorHarness();
+
+	// set up the scenarios, and load or make their golden runs
+	void init(const char *fixtureDir);
+
+	// run everything and print a table per scenario, cheapest first. If budget
+	// is more than 0, also say which configuration is the cheapest that gets
+	// within budget km at arrival.
+	void run(double budget);
+
+	// for the self-test
+	int getNumScenarios() { return (int)m_scenarios.size(); }
+	int getNumGoldenMade() { return m_numGoldenMade; } // the ones init couldn't load
+	bool matchesPath(int scenarioIdx); // euler/double at 1 step a day against the path's points
+	double getArrivalErr(int scenarioIdx, const char *kernelName, int substeps); // -1 if there's no such kernel
+
+private:
+	void addScenario(const char *name, Path *path);
+	void getFixtureName(HarnessScenario &scenario, char *outName);
+	void getFixtureHeader(HarnessScenario &scenario, std::vector<double> &outHeader);
+	bool loadGolden(HarnessScenario &scenario);
+	void saveGolden(HarnessScenario &scenario);
+	void makeGolden(HarnessScenario &scenario);
+
+	void runScenario(HarnessScenario &scenario, double budget);
+	bool matchesPath(HarnessScenario &scenario);
+	void measure(HarnessScenario &scenario, HarnessKernel &kernel, int substeps, HarnessResult &outResult);
+
+	const char *m_fixtureDir;
+	OBScenario m_stock;
+	Path m_burnShip;
+	std::vector<HarnessScenario> m_scenarios;
+	int m_numGoldenMade;
+
+	// scratch
+	std::vector<double> m_runX;
+	std::vector<double> m_runY;
+};
+
+#endif
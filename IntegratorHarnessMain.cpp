@@ -0,0 +1,18 @@
+#include "IntegratorHarness.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// usage: integrator-harness [accuracy budget in km] [fixture directory, fixtures by default]
+int main(int argc, char **argv)
+{
+	double budget = 0.0;
+	if ( argc > 1 ) budget = atof(argv[1]);
+
+	const char *fixtureDir = "fixtures";
+	if ( argc > 2 ) fixtureDir = argv[2];
+
+	IntegratorHarness harness;
+	harness.init(fixtureDir);
+	harness.run(budget);
+	return 0;
+}
@@ -0,0 +1,75 @@
+
+#include <math.h>
+#include "Kepler.h"
+
+bool Kepler::propagate(double sgp, double r0x, double r0y, double v0x, double v0y, double dt,
+	double &outRX, double &outRY, double &outVX, double &outVY)
+{
+	double r0 = sqrt(r0x*r0x + r0y*r0y);
+	double v0Sq = v0x*v0x + v0y*v0y;
+	double sqrtMu = sqrt(sgp);
+
+	// radial velocity, and the reciprocal of the semi-major axis
+	// (negative for hyperbolas, zero for parabolas)
+	double vr0 = (r0x*v0x + r0y*v0y)/r0;
+	double alpha = 2.0/r0 - v0Sq/sgp;
+
+	// solve the universal Kepler equation for chi with Newton's method
+	double chi = sqrtMu*fabs(alpha)*dt;
+	if ( alpha < 1e-12 )
+	{
+		// not an ellipse. Start from a straight line guess instead.
+		chi = sqrtMu*dt/r0;
+	}
+
+	bool bConverged = false;
+	double z = 0.0;
+	double c = 0.5;
+	double s = 1.0/6.0;
+	for ( int i=0 ; i<KEPLER_MAX_ITERATIONS ; i++ )
+	{
+		z = alpha*chi*chi;
+		c = stumpffC(z);
+		s = stumpffS(z);
+
+		double chiSq = chi*chi;
+		double f = (r0*vr0/sqrtMu)*chiSq*c + (1.0 - alpha*r0)*chiSq*chi*s + r0*chi - sqrtMu*dt;
+		double fPrime = (r0*vr0/sqrtMu)*chi*(1.0 - z*s) + (1.0 - alpha*r0)*chiSq*c + r0;
+
+		double delta = f/fPrime;
+		chi -= delta;
+		if ( fabs(delta) < 1e-9*(1.0 + fabs(chi)) )
+		{
+			bConverged = true;
+			break;
+		}
+	}
+
+	// the Lagrange coefficients
+	z = alpha*chi*chi;
+	c = stumpffC(z);
+	s = stumpffS(z);
+	double chiSq = chi*chi;
+
+	double f = 1.0 - chiSq*c/r0;
+	double g = dt - chiSq*chi*s/sqrtMu;
+	outRX = f*r0x + g*v0x;
+	outRY = f*r0y + g*v0y;
+
+	double r = sqrt(outRX*outRX + outRY*outRY);
+	double fDot = (sqrtMu/(r*r0))*(z*chi*s - chi);
+	double gDot = 1.0 - chiSq*c/r;
+	outVX = fDot*r0x + gDot*v0x;
+	outVY = fDot*r0y + gDot*v0y;
+
+	return bConverged;
+}
+
+bool Kepler::propagate(double sgp, FGDoubleVector &r0, FGDoubleVector &v0, double dt, FGDoubleVector &outR, FGDoubleVector &outV)
+{
+	double rx, ry, vx, vy;
+	bool bConverged = propagate(sgp, r0.m_fixX, r0.m_fixY, v0.m_fixX, v0.m_fixY, dt, rx, ry, vx, vy);
+	outR.setXY(rx, ry);
+	outV.setXY(vx, vy);
+	return bConverged;
+}
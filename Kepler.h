@@ -0,0 +1,49 @@
+
+#ifndef __KEPLER__
+#define __KEPLER__
+
+#include <math.h>
+#include "FGDoubleVector.h"
+
+// the most Newton iterations we'll spend solving for the universal anomaly
+#define KEPLER_MAX_ITERATIONS 50
+
+// Analytic two-body propagation. Works for any conic (ellipse, parabola or
+// hyperbola), using universal variables. The gravitic body is at 0,0, and
+// positions and velocities are relative to it.
+class Kepler
+{
+public:
+	// move the state (r0, v0) forward by dt seconds around a body with the given sgp.
+	// Returns false if the solve didn't converge, in which case the output is the best guess.
+	static bool propagate(double sgp, double r0x, double r0y, double v0x, double v0y, double dt,
+		double &outRX, double &outRY, double &outVX, double &outVY);
+	static bool propagate(double sgp, FGDoubleVector &r0, FGDoubleVector &v0, double dt, FGDoubleVector &outR, FGDoubleVector &outV);
+
+	// Stumpff functions. Inline, since the batch solvers call them in their inner loops.
+	static inline double stumpffC(double z)
+	{
+		if ( z > 1e-6 ) return (1.0 - cos(sqrt(z)))/z;
+		if ( z < -1e-6 ) return (cosh(sqrt(-z)) - 1.0)/(-z);
+
+		// close to zero, use the series
+		return 0.5 - z/24.0 + z*z/720.0;
+	}
+
+	static inline double stumpffS(double z)
+	{
+		if ( z > 1e-6 )
+		{
+			double sz = sqrt(z);
+			return (sz - sin(sz))/(sz*sz*sz);
+		}
+		if ( z < -1e-6 )
+		{
+			double sz = sqrt(-z);
+			return (sinh(sz) - sz)/(sz*sz*sz);
+		}
+		return 1.0/6.0 - z/120.0 + z*z/5040.0;
+	}
+};
+
+#endif
@@ -0,0 +1,327 @@
+
+#include <math.h>
+#include "Lambert.h"
+#include "Path.h"
+#include "OBObject.h"
+#include "OBGlobals.h"
+#include "FGDoubleGeometry.h"
+
+LambertBatch::LambertBatch()
+{
+	m_count = 0;
+	m_capacity = 0;
+	m_r1x = NULL;
+	m_r1y = NULL;
+	m_r2x = NULL;
+	m_r2y = NULL;
+	m_tof = NULL;
+	m_v1x = NULL;
+	m_v1y = NULL;
+	m_v2x = NULL;
+	m_v2y = NULL;
+	m_bValid = NULL;
+	m_zLow = NULL;
+	m_zHigh = NULL;
+	m_A = NULL;
+	m_r1Len = NULL;
+	m_r2Len = NULL;
+}
+
+LambertBatch::~LambertBatch()
+{
+	delete[] m_r1x;
+	delete[] m_r1y;
+	delete[] m_r2x;
+	delete[] m_r2y;
+	delete[] m_tof;
+	delete[] m_v1x;
+	delete[] m_v1y;
+	delete[] m_v2x;
+	delete[] m_v2y;
+	delete[] m_bValid;
+	delete[] m_zLow;
+	delete[] m_zHigh;
+	delete[] m_A;
+	delete[] m_r1Len;
+	delete[] m_r2Len;
+}
+
+void LambertBatch::alloc(int count)
+{
+	m_count = count;
+	if ( count <= m_capacity ) return;
+
+	delete[] m_r1x;
+	delete[] m_r1y;
+	delete[] m_r2x;
+	delete[] m_r2y;
+	delete[] m_tof;
+	delete[] m_v1x;
+	delete[] m_v1y;
+	delete[] m_v2x;
+	delete[] m_v2y;
+	delete[] m_bValid;
+	delete[] m_zLow;
+	delete[] m_zHigh;
+	delete[] m_A;
+	delete[] m_r1Len;
+	delete[] m_r2Len;
+
+	m_capacity = count;
+	m_r1x = new double[count];
+	m_r1y = new double[count];
+	m_r2x = new double[count];
+	m_r2y = new double[count];
+	m_tof = new double[count];
+	m_v1x = new double[count];
+	m_v1y = new double[count];
+	m_v2x = new double[count];
+	m_v2y = new double[count];
+	m_bValid = new bool[count];
+	m_zLow = new double[count];
+	m_zHigh = new double[count];
+	m_A = new double[count];
+	m_r1Len = new double[count];
+	m_r2Len = new double[count];
+}
+
+// the Stumpff functions C(z) and S(z) from their series, by Horner's rule. The
+// same number of terms whatever z is, so there's nothing to branch on.
+static inline void stumpffSeries(const double *cSeries, const double *sSeries, double z, double &outC, double &outS)
+{
+	double c = cSeries[LAMBERT_STUMPFF_TERMS-1];
+	double s = sSeries[LAMBERT_STUMPFF_TERMS-1];
+	for ( int n=LAMBERT_STUMPFF_TERMS-2 ; n>=0 ; n-- )
+	{
+		c = c*z + cSeries[n];
+		s = s*z + sSeries[n];
+	}
+	outC = c;
+	outS = s;
+}
+
+int Lambert::getDirection(double px, double py, double vx, double vy)
+{
+	// the sign of the angular momentum
+	if ( px*vy - py*vx < 0.0 ) return -1;
+	return 1;
+}
+
+void Lambert::solveBatch(double sgp, int direction, LambertBatch &batch)
+{
+	int count = batch.m_count;
+	double sqrtMu = sqrt(sgp);
+
+	// the Stumpff series coefficients. C(z) = 1/2! - z/4! + z^2/6! - ...
+	// and S(z) = 1/3! - z/5! + z^2/7! - ...
+	double cSeries[LAMBERT_STUMPFF_TERMS];
+	double sSeries[LAMBERT_STUMPFF_TERMS];
+	cSeries[0] = 1.0/2.0;
+	sSeries[0] = 1.0/6.0;
+	for ( int n=1 ; n<LAMBERT_STUMPFF_TERMS ; n++ )
+	{
+		cSeries[n] = -cSeries[n-1]/(double)((2*n+1)*(2*n+2));
+		sSeries[n] = -sSeries[n-1]/(double)((2*n+2)*(2*n+3));
+	}
+
+	// the geometry of each pair. A is the constant from the universal variable
+	// formulation, and depends only on the two radii and the transfer angle.
+	for ( int k=0 ; k<count ; k++ )
+	{
+		double r1 = sqrt(batch.m_r1x[k]*batch.m_r1x[k] + batch.m_r1y[k]*batch.m_r1y[k]);
+		double r2 = sqrt(batch.m_r2x[k]*batch.m_r2x[k] + batch.m_r2y[k]*batch.m_r2y[k]);
+		double cosAngle = (batch.m_r1x[k]*batch.m_r2x[k] + batch.m_r1y[k]*batch.m_r2y[k])/(r1*r2);
+		double cross = batch.m_r1x[k]*batch.m_r2y[k] - batch.m_r1y[k]*batch.m_r2x[k];
+		if ( cosAngle > 1.0 ) cosAngle = 1.0;
+		if ( cosAngle < -1.0 ) cosAngle = -1.0;
+
+		// the transfer angle, going the way we're told to
+		double angle = acos(cosAngle);
+		if ( cross*(double)direction < 0.0 ) angle = TWOPI - angle;
+
+		batch.m_A[k] = sin(angle)*sqrt(r1*r2/(1.0 - cosAngle));
+		batch.m_r1Len[k] = r1;
+		batch.m_r2Len[k] = r2;
+		batch.m_zLow[k] = LAMBERT_Z_LOW;
+		batch.m_zHigh[k] = LAMBERT_Z_HIGH;
+	}
+
+	// Bisect on z. The time of flight increases with z, so each step keeps the
+	// half that holds the requested time. Every pair takes the same steps, and
+	// the pairs are the inner loop, so this runs straight down the arrays.
+	for ( int iter=0 ; iter<LAMBERT_ITERATIONS ; iter++ )
+	{
+		for ( int k=0 ; k<count ; k++ )
+		{
+			double r1 = batch.m_r1Len[k];
+			double r2 = batch.m_r2Len[k];
+			double A = batch.m_A[k];
+
+			double z = (batch.m_zLow[k] + batch.m_zHigh[k])*0.5;
+			double c, s;
+			stumpffSeries(cSeries, sSeries, z, c, s);
+			double y = r1 + r2 + A*(z*s - 1.0)/sqrt(c);
+
+			// where y goes negative we're below the solution. Work the time out
+			// either way and pick afterwards, so it's a select and not a branch.
+			bool bPositive = (y > 0.0);
+			double yPos = bPositive ? y : 0.0;
+			double yOverC = yPos/c;
+			double timeErr = yOverC*sqrt(yOverC)*s + A*sqrt(yPos) - sqrtMu*batch.m_tof[k];
+			timeErr = bPositive ? timeErr : -1.0;
+
+			bool bBelow = (timeErr < 0.0);
+			batch.m_zLow[k] = bBelow ? z : batch.m_zLow[k];
+			batch.m_zHigh[k] = bBelow ? batch.m_zHigh[k] : z;
+		}
+	}
+
+	// turn z in to the velocities at each end, with the Lagrange coefficients
+	for ( int k=0 ; k<count ; k++ )
+	{
+		double r1 = batch.m_r1Len[k];
+		double r2 = batch.m_r2Len[k];
+		double A = batch.m_A[k];
+
+		double z = (batch.m_zLow[k] + batch.m_zHigh[k])*0.5;
+		double c, s;
+		stumpffSeries(cSeries, sSeries, z, c, s);
+		double y = r1 + r2 + A*(z*s - 1.0)/sqrt(c);
+
+		double f = 1.0 - y/r1;
+		double g = A*sqrt(y/sgp);
+		double gDot = 1.0 - y/r2;
+
+		batch.m_v1x[k] = (batch.m_r2x[k] - f*batch.m_r1x[k])/g;
+		batch.m_v1y[k] = (batch.m_r2y[k] - f*batch.m_r1y[k])/g;
+		batch.m_v2x[k] = (gDot*batch.m_r2x[k] - batch.m_r1x[k])/g;
+		batch.m_v2y[k] = (gDot*batch.m_r2y[k] - batch.m_r1y[k])/g;
+
+		// if z never left one of the bounds, the answer is outside them.
+		// A of zero (or nan) is a transfer of 0 or 180 degrees, which this form can't do.
+		bool bValid = (y > 0.0) && (fabs(A) > 1e-6) &&
+			(batch.m_zLow[k] != LAMBERT_Z_LOW) && (batch.m_zHigh[k] != LAMBERT_Z_HIGH);
+		batch.m_bValid[k] = bValid && (batch.m_v1x[k] == batch.m_v1x[k]) && (batch.m_v1y[k] == batch.m_v1y[k]);
+	}
+}
+
+void Lambert::porkchop(Path &departPath, Path &arrivePath,
+	int firstDep, int numDep, int depStep, int firstTof, int numTof, int tofStep,
+	LambertBatch &batch, double *outDepartDV, double *outArriveDV)
+{
+	// we'll be reading the paths all over
+	departPath.ensurePoints(PATH_NUM_POINTS-1);
+	arrivePath.ensurePoints(PATH_NUM_POINTS-1);
+
+	OBObject *sun = departPath.m_orbitee;
+	double sunX = sun->m_pos.m_fixX;
+	double sunY = sun->m_pos.m_fixY;
+
+	// we go the same way around as the planet we leave
+	int direction = getDirection(departPath.m_startPos.m_fixX - sunX, departPath.m_startPos.m_fixY - sunY,
+		departPath.m_startVel.m_fixX, departPath.m_startVel.m_fixY);
+
+	// one batch entry per cell. Cells that run off the end of the paths still get
+	// an entry (so the indices line up), we just ignore the answer.
+	int numCells = numDep*numTof;
+	batch.alloc(numCells);
+	for ( int d=0 ; d<numDep ; d++ )
+	{
+		int depIdx = firstDep + d*depStep;
+		for ( int t=0 ; t<numTof ; t++ )
+		{
+			int cell = d*numTof + t;
+			int tofDays = firstTof + t*tofStep;
+			int arrIdx = depIdx + tofDays;
+			if ( (depIdx < 0) || (depIdx >= PATH_NUM_POINTS) || (arrIdx >= PATH_NUM_POINTS) || (tofDays <= 0) )
+			{
+				arrIdx = depIdx = 0;
+				tofDays = 1;
+			}
+
+			batch.m_r1x[cell] = departPath.m_points[depIdx].m_fixX - sunX;
+			batch.m_r1y[cell] = departPath.m_points[depIdx].m_fixY - sunY;
+			batch.m_r2x[cell] = arrivePath.m_points[arrIdx].m_fixX - sunX;
+			batch.m_r2y[cell] = arrivePath.m_points[arrIdx].m_fixY - sunY;
+			batch.m_tof[cell] = (double)tofDays*POINTS_TIME;
+		}
+	}
+
+	solveBatch(sun->m_sgp, direction, batch);
+
+	// the delta-v at each end is the difference from the planet's own velocity
+	for ( int d=0 ; d<numDep ; d++ )
+	{
+		int depIdx = firstDep + d*depStep;
+		for ( int t=0 ; t<numTof ; t++ )
+		{
+			int cell = d*numTof + t;
+			int tofDays = firstTof + t*tofStep;
+			int arrIdx = depIdx + tofDays;
+			if ( (depIdx < 0) || (depIdx >= PATH_NUM_POINTS) || (arrIdx >= PATH_NUM_POINTS) || (tofDays <= 0) || !batch.m_bValid[cell] )
+			{
+				outDepartDV[cell] = -1.0;
+				outArriveDV[cell] = -1.0;
+				continue;
+			}
+
+			FGDoubleVector planetVel;
+			departPath.getNodeVel(depIdx, planetVel);
+			double dx = batch.m_v1x[cell] - planetVel.m_fixX;
+			double dy = batch.m_v1y[cell] - planetVel.m_fixY;
+			outDepartDV[cell] = sqrt(dx*dx + dy*dy);
+
+			arrivePath.getNodeVel(arrIdx, planetVel);
+			dx = batch.m_v2x[cell] - planetVel.m_fixX;
+			dy = batch.m_v2y[cell] - planetVel.m_fixY;
+			outArriveDV[cell] = sqrt(dx*dx + dy*dy);
+		}
+	}
+}
+
+void Lambert::seedPath(Path &ship, int departIdx, double velX, double velY)
+{
+	if ( (departIdx < 0) || (departIdx >= PATH_NUM_POINTS) ) return;
+
+	// clear out everything but the initial acceleration point (which can't go)
+	AccelerationPointIter iter = ship.m_accelerationPoints.begin();
+	while ( iter != ship.m_accelerationPoints.end() )
+	{
+		AccelerationPoint *ap = *iter;
+		iter++;
+		ship.removeAccelerationPoint(ap);
+	}
+
+	// coast until departure. Removing and creating points moves the path's frontier
+	// back for us; the start point's thrust is set directly, so if that changes
+	// the path goes back to the start.
+	AccelerationPoint *start = ship.createAccelerationPoint(0);
+	int firstChangedIdx = PATH_NUM_POINTS;
+	if ( (start->m_type != ACCTYPE_NORMAL) || (start->m_mag != 0.0) ) firstChangedIdx = 0;
+	start->m_type = ACCTYPE_NORMAL;
+	start->setAccel(0.0, 0.0);
+	ship.invalidateFrom(firstChangedIdx);
+
+	// the burn makes up the difference from where the coast has us going. That
+	// only needs the path as far as the departure, which the lazy points give us.
+	FGDoubleVector shipVel;
+	ship.getNodeVel(departIdx, shipVel);
+	Vec2d dv(velX - shipVel.m_fixX, velY - shipVel.m_fixY);
+
+	// burn along the delta-v. The angle is relative to the direction to the orbitee.
+	AccelerationPoint *burn = ship.createAccelerationPoint(departIdx);
+	Vec2d gravDir = ship.getGravForPoint(departIdx);
+	burn->m_type = ACCTYPE_NORMAL;
+	burn->setAccel(FGDoubleGeometry::angleDiff(gravDir.angle(), dv.angle()), PATH_ACCELERATION);
+
+	// for as long as it takes to deliver it
+	double burnSeconds = dv.length()/PATH_ACCELERATION;
+	int burnDays = (int)(burnSeconds/POINTS_TIME + 0.5);
+	if ( burnDays < 1 ) burnDays = 1;
+	AccelerationPoint *cutoff = ship.createAccelerationPoint(departIdx + burnDays);
+	if ( cutoff != NULL )
+	{
+		cutoff->m_type = ACCTYPE_NORMAL;
+		cutoff->setAccel(0.0, 0.0);
+	}
+}
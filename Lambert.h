@@ -0,0 +1,88 @@
+
+#ifndef __LAMBERT__
+#define __LAMBERT__
+
+class Path;
+
+// bisection steps used by the batch solver. Every pair gets the same number
+// of steps, so there are no per-pair branches in the inner loop.
+#define LAMBERT_ITERATIONS 40
+
+// terms in the Stumpff series. Over the z bounds below this is good to about 1e-12,
+// well inside what the bisection gets to.
+#define LAMBERT_STUMPFF_TERMS 20
+
+// the universal variable z is searched for within these bounds. The upper
+// bound is one full revolution.
+#define LAMBERT_Z_LOW (-40.0)
+#define LAMBERT_Z_HIGH (39.4784176043) // 4*PI^2
+
+// A batch of Lambert problems, laid out as structure-of-arrays so the
+// solver can run straight down each array. Allocate once and reuse; the
+// solver itself never allocates.
+class LambertBatch
+{
+public:
+	LambertBatch();
+	~LambertBatch();
+
+	// make room for count pairs. Keeps the old arrays if they're big enough.
+	void alloc(int count);
+
+	int m_count;
+	int m_capacity;
+
+	// inputs. Positions are relative to the gravitic body.
+	double *m_r1x;
+	double *m_r1y;
+	double *m_r2x;
+	double *m_r2y;
+	double *m_tof; // seconds
+
+	// outputs. The velocities needed at each end of the transfer.
+	double *m_v1x;
+	double *m_v1y;
+	double *m_v2x;
+	double *m_v2y;
+	bool *m_bValid; // false if the pair had no single-revolution solution we could find
+
+	// working space
+	double *m_zLow;
+	double *m_zHigh;
+	double *m_A;
+	double *m_r1Len; // the lengths of r1 and r2, so the iterations don't keep working them out
+	double *m_r2Len;
+};
+
+// Lambert's problem: what orbit takes us from r1 to r2 in a given time?
+// Solved with universal variables and a fixed-step bisection on z, single revolution.
+// The Stumpff functions are summed as a fixed-length series rather than with
+// Kepler's closed forms, so the solver's inner loop has no branches on z.
+class Lambert
+{
+public:
+	// solve every pair in the batch. direction is +1 for counter-clockwise
+	// transfers, -1 for clockwise (the way the planets go in this app).
+	static void solveBatch(double sgp, int direction, LambertBatch &batch);
+
+	// the clockwise/counter-clockwise sense of an orbit, from a position and velocity
+	static int getDirection(double px, double py, double vx, double vy);
+
+	// Build porkchop data between two planet paths. Departures are every depStep days
+	// starting at firstDep, numDep of them. Flight times are every tofStep days starting
+	// at firstTof, numTof of them. Results are indexed [dep*numTof + tof] and are the
+	// delta-v (km/s) at departure and arrival. Cells that run off the end of the paths,
+	// or have no solution, get -1.
+	static void porkchop(Path &departPath, Path &arrivePath,
+		int firstDep, int numDep, int depStep, int firstTof, int numTof, int tofStep,
+		LambertBatch &batch, double *outDepartDV, double *outArriveDV);
+
+	// Set up the ship's acceleration points for a transfer: coast until departIdx,
+	// then a full-thrust burn for as long as it takes to get the ship to the
+	// velocity (velX, velY), then coast. The burn is worked out from wherever the
+	// ship's own coast takes it, not from the planet it started on. This is a
+	// starting point for hand tuning.
+	static void seedPath(Path &ship, int departIdx, double velX, double velY);
+};
+
+#endif
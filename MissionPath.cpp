@@ -0,0 +1,386 @@
+
+#include "MissionPath.h"
+#include "OBObject.h"
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+MissionPath::MissionPath()
+{
+	m_orbitee = NULL;
+	m_frontier = -1;
+	m_haltIdx = -1;
+	m_numPoints = 0;
+	m_maxResident = MISSIONPATH_DEFAULT_MAX_RESIDENT;
+	m_numResident = 0;
+	m_useClock = 0;
+	m_spillFilename = NULL;
+	m_spillFile = -1;
+	m_spillMap = NULL;
+	m_spillMapSize = 0;
+}
+
+MissionPath::~MissionPath()
+{
+	closeSpill();
+
+	for ( int i=0 ; i<(int)m_blocks.size() ; i++ )
+	{
+		delete[] m_blocks[i].m_data;
+	}
+	for ( int i=0 ; i<(int)m_freeData.size() ; i++ )
+	{
+		delete[] m_freeData[i];
+	}
+	for ( AccelerationPointIter iter = m_accelerationPoints.begin() ; iter != m_accelerationPoints.end() ; iter++ )
+	{
+		delete *iter;
+	}
+}
+
+void MissionPath::init(OBObject *orbitee, FGDoubleVector &startPos, FGDoubleVector &startVel, int numPoints)
+{
+	m_orbitee = orbitee;
+	m_startPos.set(startPos);
+	m_startVel.set(startVel);
+	setNumPoints(numPoints);
+	invalidateFrom(0);
+}
+
+void MissionPath::setNumPoints(int numPoints)
+{
+	if ( numPoints < 1 ) numPoints = 1;
+	int numBlocks = (numPoints + MISSIONPATH_BLOCK_POINTS - 1)/MISSIONPATH_BLOCK_POINTS;
+
+	// fewer points just forgets the ones past the end
+	if ( numPoints < m_numPoints )
+	{
+		invalidateFrom(numPoints);
+		for ( int i=numBlocks ; i<(int)m_blocks.size() ; i++ )
+		{
+			if ( m_blocks[i].m_data != NULL )
+			{
+				m_freeData.push_back(m_blocks[i].m_data);
+				m_numResident--;
+			}
+		}
+	}
+
+	MissionBlock empty;
+	empty.m_data = NULL;
+	empty.m_bDirty = false;
+	empty.m_bSpilled = false;
+	empty.m_lastUse = 0;
+	m_blocks.resize(numBlocks, empty);
+	m_checkpoints.resize(numBlocks*MISSIONPATH_POINT_DOUBLES);
+	m_numPoints = numPoints;
+
+	// the spill file grows with us
+	if ( (m_spillFile != -1) && !mapSpill(numBlocks) ) closeSpill();
+}
+
+int MissionPath::getStopPoint()
+{
+	for ( AccelerationPointIter iter = m_accelerationPoints.begin() ; iter != m_accelerationPoints.end() ; iter++ )
+	{
+		AccelerationPoint *ap = *iter;
+		if ( (ap->m_type == ACCTYPE_STOPTRACE) && (ap->m_pointIdx < m_numPoints) )
+		{
+			return ap->m_pointIdx;
+		}
+	}
+	return m_numPoints-1;
+}
+
+void MissionPath::setMaxResidentBlocks(int maxResident)
+{
+	if ( maxResident < 1 ) maxResident = 1;
+	m_maxResident = maxResident;
+	while ( m_numResident > m_maxResident )
+	{
+		evictOldest();
+	}
+}
+
+bool MissionPath::setSpillFile(const char *filename)
+{
+	closeSpill();
+#ifdef _WIN32
+	return false;
+#else
+	m_spillFile = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if ( m_spillFile == -1 ) return false;
+	m_spillFilename = new char[strlen(filename)+1];
+	strcpy(m_spillFilename, filename);
+
+	if ( !mapSpill((int)m_blocks.size()) )
+	{
+		closeSpill();
+		return false;
+	}
+	return true;
+#endif
+}
+
+bool MissionPath::mapSpill(int numBlocks)
+{
+#ifdef _WIN32
+	return false;
+#else
+	long long size = (long long)numBlocks*MISSIONPATH_BLOCK_BYTES;
+	if ( size == m_spillMapSize ) return true;
+
+	if ( m_spillMap != NULL )
+	{
+		munmap(m_spillMap, (size_t)m_spillMapSize);
+		m_spillMap = NULL;
+		m_spillMapSize = 0;
+	}
+	if ( ftruncate(m_spillFile, (off_t)size) != 0 ) return false;
+	if ( size == 0 ) return true;
+
+	void *map = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, m_spillFile, 0);
+	if ( map == MAP_FAILED ) return false;
+	m_spillMap = (unsigned char *)map;
+	m_spillMapSize = size;
+	return true;
+#endif
+}
+
+void MissionPath::closeSpill()
+{
+#ifndef _WIN32
+	if ( m_spillMap != NULL )
+	{
+		munmap(m_spillMap, (size_t)m_spillMapSize);
+	}
+	if ( m_spillFile != -1 )
+	{
+		close(m_spillFile);
+		unlink(m_spillFilename);
+	}
+#endif
+	delete[] m_spillFilename;
+	m_spillFilename = NULL;
+	m_spillFile = -1;
+	m_spillMap = NULL;
+	m_spillMapSize = 0;
+
+	// nothing is spilled any more. What was will be propagated again.
+	for ( int i=0 ; i<(int)m_blocks.size() ; i++ )
+	{
+		m_blocks[i].m_bSpilled = false;
+		m_blocks[i].m_bDirty = true;
+	}
+}
+
+void MissionPath::invalidateFrom(int pointIdx)
+{
+	if ( pointIdx <= 0 )
+	{
+		m_frontier = -1;
+		m_haltIdx = -1;
+	}
+	else
+	{
+		// if we halted before the change, the change makes no difference
+		if ( (m_haltIdx != -1) && (m_haltIdx < pointIdx) ) return;
+		if ( m_frontier < pointIdx ) return;
+		m_frontier = pointIdx-1;
+		m_haltIdx = -1;
+	}
+
+	// the spilled copies of blocks past the frontier are stale now
+	int firstStale = (m_frontier+1 + MISSIONPATH_BLOCK_POINTS - 1)/MISSIONPATH_BLOCK_POINTS;
+	for ( int i=firstStale ; i<(int)m_blocks.size() ; i++ )
+	{
+		m_blocks[i].m_bSpilled = false;
+	}
+}
+
+void MissionPath::evictOldest()
+{
+	int oldest = -1;
+	for ( int i=0 ; i<(int)m_blocks.size() ; i++ )
+	{
+		if ( m_blocks[i].m_data == NULL ) continue;
+		if ( (oldest == -1) || (m_blocks[i].m_lastUse < m_blocks[oldest].m_lastUse) ) oldest = i;
+	}
+	if ( oldest == -1 ) return;
+
+	MissionBlock &block = m_blocks[oldest];
+	if ( (m_spillMap != NULL) && (block.m_bDirty || !block.m_bSpilled) )
+	{
+		unsigned char *dest = &m_spillMap[(long long)oldest*MISSIONPATH_BLOCK_BYTES];
+		memcpy(dest, block.m_data, MISSIONPATH_BLOCK_BYTES);
+#if !defined(_WIN32) && defined(MADV_DONTNEED)
+		// it's in the file now. Let the pages go.
+		msync(dest, MISSIONPATH_BLOCK_BYTES, MS_ASYNC);
+		madvise(dest, MISSIONPATH_BLOCK_BYTES, MADV_DONTNEED);
+#endif
+		block.m_bSpilled = true;
+	}
+	block.m_bDirty = false;
+
+	m_freeData.push_back(block.m_data);
+	block.m_data = NULL;
+	m_numResident--;
+}
+
+double *MissionPath::useBlock(int blockIdx, bool bFill)
+{
+	MissionBlock &block = m_blocks[blockIdx];
+	block.m_lastUse = ++m_useClock;
+	if ( block.m_data != NULL ) return block.m_data;
+
+	if ( m_numResident >= m_maxResident ) evictOldest();
+	if ( m_freeData.empty() )
+	{
+		block.m_data = new double[MISSIONPATH_BLOCK_POINTS*MISSIONPATH_POINT_DOUBLES];
+	}
+	else
+	{
+		block.m_data = m_freeData.back();
+		m_freeData.pop_back();
+	}
+	m_numResident++;
+	block.m_bDirty = false;
+
+	// the points up to the frontier, from the spill file or from the checkpoint
+	int firstIdx = blockIdx*MISSIONPATH_BLOCK_POINTS;
+	if ( bFill && (firstIdx <= m_frontier) )
+	{
+		if ( block.m_bSpilled )
+		{
+			memcpy(block.m_data, &m_spillMap[(long long)blockIdx*MISSIONPATH_BLOCK_BYTES], MISSIONPATH_BLOCK_BYTES);
+		}
+		else
+		{
+			const double *cp = &m_checkpoints[blockIdx*MISSIONPATH_POINT_DOUBLES];
+			memcpy(block.m_data, cp, MISSIONPATH_POINT_DOUBLES*sizeof(double));
+
+			int lastIdx = firstIdx + MISSIONPATH_BLOCK_POINTS-1;
+			if ( lastIdx > m_frontier ) lastIdx = m_frontier;
+			PathKernelDefault::State state;
+			state.m_pos = PathKernelDefault::Vec(cp[0], cp[1]);
+			state.m_vel = PathKernelDefault::Vec(cp[2], cp[3]);
+			m_schedule.build(m_accelerationPoints, getStopPoint());
+			propagateSteps(state, firstIdx+1, lastIdx, false);
+		}
+	}
+	return block.m_data;
+}
+
+void MissionPath::ensurePoints(int pointIdx)
+{
+	int stopIdx = getStopPoint();
+	if ( pointIdx > stopIdx ) pointIdx = stopIdx;
+	if ( pointIdx <= m_frontier ) return;
+
+	// a halt stopped us short. There's no more to work out.
+	if ( (m_frontier != -1) && (m_haltIdx != -1) ) return;
+
+	m_schedule.build(m_accelerationPoints, stopIdx);
+	if ( m_frontier == -1 )
+	{
+		m_haltIdx = -1;
+		double *data = useBlock(0, false);
+		data[0] = m_startPos.m_fixX;
+		data[1] = m_startPos.m_fixY;
+		data[2] = m_startVel.m_fixX;
+		data[3] = m_startVel.m_fixY;
+		memcpy(&m_checkpoints[0], data, MISSIONPATH_POINT_DOUBLES*sizeof(double));
+		m_blocks[0].m_bDirty = true;
+		m_frontier = 0;
+	}
+
+	// pick up where we left off
+	const double *last = getPointData(m_frontier);
+	PathKernelDefault::State state;
+	state.m_pos = PathKernelDefault::Vec(last[0], last[1]);
+	state.m_vel = PathKernelDefault::Vec(last[2], last[3]);
+	int haltIdx = propagateSteps(state, m_frontier+1, pointIdx, true);
+
+	if ( haltIdx != -1 )
+	{
+		m_haltIdx = haltIdx;
+		m_frontier = haltIdx;
+	}
+	else
+	{
+		m_frontier = pointIdx;
+	}
+}
+
+int MissionPath::propagateSteps(PathKernelDefault::State &state, int firstStep, int lastStep, bool bCheckHalt)
+{
+	// the same steps as Path::propagateSteps, at one step a day
+	PathKernelDefault::Vec center(m_orbitee->m_pos.m_fixX, m_orbitee->m_pos.m_fixY);
+	double sgp = m_orbitee->m_sgp;
+	double haltDistSq = FATAL_SUN_APPROACH*FATAL_SUN_APPROACH;
+
+	ScheduleStepper<PathKernelDefault> stepper(m_schedule, center, sgp, 1, POINTS_TIME, firstStep);
+
+	int blockIdx = -1;
+	double *data = NULL;
+	for ( int i=firstStep ; i<=lastStep ; i++ )
+	{
+		stepper.stepDay(state, i);
+
+		// note the point, in a new block and checkpoint if it's the first of one
+		int offset = i % MISSIONPATH_BLOCK_POINTS;
+		if ( (data == NULL) || (offset == 0) )
+		{
+			blockIdx = i/MISSIONPATH_BLOCK_POINTS;
+			data = useBlock(blockIdx, offset != 0);
+			m_blocks[blockIdx].m_bDirty = true;
+		}
+		double *point = &data[offset*MISSIONPATH_POINT_DOUBLES];
+		point[0] = state.m_pos.x();
+		point[1] = state.m_pos.y();
+		point[2] = state.m_vel.x();
+		point[3] = state.m_vel.y();
+		if ( offset == 0 )
+		{
+			memcpy(&m_checkpoints[blockIdx*MISSIONPATH_POINT_DOUBLES], point, MISSIONPATH_POINT_DOUBLES*sizeof(double));
+		}
+
+		// the same test as the terminal sun approach event
+		if ( bCheckHalt )
+		{
+			double dx = point[0] - center.x();
+			double dy = point[1] - center.y();
+			if ( dx*dx + dy*dy < haltDistSq ) return i;
+		}
+	}
+	return -1;
+}
+
+const double *MissionPath::getPointData(int pointIdx)
+{
+	int stopIdx = getStopPoint();
+	if ( pointIdx > stopIdx ) pointIdx = stopIdx;
+	if ( pointIdx < 0 ) pointIdx = 0;
+	ensurePoints(pointIdx);
+	if ( pointIdx > m_frontier ) pointIdx = m_frontier;
+
+	double *data = useBlock(pointIdx/MISSIONPATH_BLOCK_POINTS, true);
+	return &data[(pointIdx % MISSIONPATH_BLOCK_POINTS)*MISSIONPATH_POINT_DOUBLES];
+}
+
+void MissionPath::getPoint(int pointIdx, double &outX, double &outY)
+{
+	const double *point = getPointData(pointIdx);
+	outX = point[0];
+	outY = point[1];
+}
+
+void MissionPath::getVel(int pointIdx, double &outVX, double &outVY)
+{
+	const double *point = getPointData(pointIdx);
+	outVX = point[2];
+	outVY = point[3];
+}
@@ -0,0 +1,108 @@
+
+#ifndef __MISSIONPATH__
+#define __MISSIONPATH__
+
+#include "Path.h"
+#include <vector>
+
+// points per block. Each block is allocated when the propagation gets to it,
+// and is what gets spilled or dropped.
+#define MISSIONPATH_BLOCK_POINTS 256
+
+// doubles per point in a block: x, y, vx, vy
+#define MISSIONPATH_POINT_DOUBLES 4
+#define MISSIONPATH_BLOCK_BYTES (MISSIONPATH_BLOCK_POINTS*MISSIONPATH_POINT_DOUBLES*sizeof(double))
+
+// how many blocks are kept in memory by default. 64 is 8MB, or about 45 years.
+#define MISSIONPATH_DEFAULT_MAX_RESIDENT 64
+
+// a run of points, in memory or not
+class MissionBlock
+{
+public:
+	double *m_data;  // MISSIONPATH_BLOCK_POINTS points, or NULL if it isn't in memory
+	bool m_bDirty;   // written since it was last spilled
+	bool m_bSpilled; // the spill file has a good copy
+	long long m_lastUse;
+};
+
+// A path with as many points as a mission needs, a day apart like a Path's. A Path
+// has 900, which is two and a half years, and making that bigger would cost every
+// path. Here the points are kept in blocks that are only allocated as they're
+// reached, and the state at the start of each block is kept as a checkpoint.
+//
+// Only so many blocks stay in memory. The least recently used go to the spill file
+// if there is one, and are mapped back in when they're wanted. Without one (or on
+// windows, where there's no mmap) they're just dropped, and propagated again from
+// their checkpoint. Either way the memory used stays bounded however long it runs.
+//
+// It steps exactly as a Path does, so the first 900 points are a Path's, bit for bit.
+// The only event is the terminal sun approach, which stops it there; the planets'
+// paths end at 900 points, so there's nothing else to check against.
+class MissionPath
+{
+public:
+	MissionPath();
+	~MissionPath();
+
+	void init(OBObject *orbitee, FGDoubleVector &startPos, FGDoubleVector &startVel, int numPoints);
+	void setNumPoints(int numPoints);
+	int getNumPoints() { return m_numPoints; }
+	int getStopPoint(); // the stop trace point, or the last point
+
+	// blocks kept in memory, at least 1
+	void setMaxResidentBlocks(int maxResident);
+	int getNumResidentBlocks() { return m_numResident; }
+
+	// spill cold blocks to this file, instead of dropping them. It's made (or
+	// emptied) here, and removed when we're done. Returns false if it can't be mapped.
+	bool setSpillFile(const char *filename);
+
+	// like Path's: call after changing the start or the acceleration points
+	void invalidateFrom(int pointIdx);
+	void ensurePoints(int pointIdx);
+
+	// past a halt, these are the halt point. Past the stop point, the stop point.
+	void getPoint(int pointIdx, double &outX, double &outY);
+	void getVel(int pointIdx, double &outVX, double &outVY);
+
+	// data
+	FGDoubleVector m_startPos;
+	FGDoubleVector m_startVel;
+	OBObject *m_orbitee;
+	AccelerationPointList m_accelerationPoints; // owned, in point order
+	int m_frontier; // the last point that has been worked out, or -1
+	int m_haltIdx;  // where it got too close to the sun, or -1
+
+private:
+	// not copyable. It owns its blocks, acceleration points and spill file.
+	MissionPath(const MissionPath &other);
+	MissionPath &operator=(const MissionPath &other);
+
+	// steps firstStep to lastStep from state. Returns the point it halted at, or -1.
+	int propagateSteps(PathKernelDefault::State &state, int firstStep, int lastStep, bool bCheckHalt);
+
+	// a block's points, in memory. If bFill, the points up to the frontier are good.
+	double *useBlock(int blockIdx, bool bFill);
+	const double *getPointData(int pointIdx);
+	void evictOldest();
+	void closeSpill();
+	bool mapSpill(int numBlocks);
+
+	int m_numPoints;
+	std::vector<MissionBlock> m_blocks;
+	std::vector<double> m_checkpoints; // MISSIONPATH_POINT_DOUBLES per block: its first point
+	ThrustSchedule m_schedule;
+	std::vector<double *> m_freeData; // block memory not in use, so we don't churn the heap
+	int m_maxResident;
+	int m_numResident;
+	long long m_useClock;
+
+	// the spill file
+	char *m_spillFilename;
+	int m_spillFile;
+	unsigned char *m_spillMap;
+	long long m_spillMapSize;
+};
+
+#endif
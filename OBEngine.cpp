@@ -2,9 +2,44 @@
 #include "FGDataWriter.h"
 #include "FGDataReader.h"
 #include "FGDoubleGeometry.h"
+#include <math.h>
 
 #define PLAYBACK_STEP_TIME 50
 
+// zoom. Each level is this many times closer than the one before. Level 0 shows
+// all of mars's orbit.
+#define ZOOM_STEPS_PER_DOUBLING 4
+#define ZOOM_MIN_LEVEL (-8)
+#define ZOOM_MAX_LEVEL 48
+#define ZOOM_ENCOUNTER_LEVEL 30 // close enough to see mars's sphere of influence
+
+// time warp. How many ticks go by each frame, and the asteroid belt we show.
+#define WARP_TICKS_PER_FRAME 2
+#define WARP_NUM_ASTEROIDS 500
+#define WARP_BELT_MIN_DIST (329000000.0)
+#define WARP_BELT_MAX_DIST (479000000.0)
+
+// the most recompute work that can go on at once is the three planet paths
+#define RECOMPUTE_MAX_THREADS 3
+
+// recompute graph work
+static void recomputePath(void *context)
+{
+	((Path *)context)->calcPoints();
+}
+
+static void recomputeShip(void *context)
+{
+	// the edits invalidate just what they change, so carry on from there
+	Path *ship = (Path *)context;
+	ship->ensurePoints(ship->getStopPoint());
+}
+
+static void recomputeShipEvents(void *context)
+{
+	((Path *)context)->rescanEvents();
+}
+
 OBEngine::OBEngine()
 {
 }
@@ -24,10 +59,10 @@ void OBEngine::init()
 	// init graphics metrics
 	double r = MARS_APOGEE*1.05;
 	double width = r*2.0;
-	m_kmPerPixel = width/(double)m_screenW;
+	m_baseKmPerPixel = width/(double)m_screenW;
 
 	// start off centered at 0,0
-	m_center.setXY(0.0, 0.0);
+	resetView();
 
 	// sun and earth
 	FGDoubleVector pos;
@@ -48,13 +83,67 @@ void OBEngine::init()
 	m_venusPath.initNoAcc(&m_venus, 1.4623927498);
 	m_earthPath.initNoAcc(&m_earth, 4.9745875522);
 	m_marsPath.initNoAcc(&m_mars, 5.4429575522);
+	m_ship.m_cache = &m_shipCache;
 	m_ship.init(&m_sun, m_earthPath.m_startPos, m_earthPath.m_startVel, 0x7f7f7f, 5);
 
+	// everything is drawn and hit tested through our view
+	m_sun.setView(this);
+	m_venus.setView(this);
+	m_earth.setView(this);
+	m_mars.setView(this);
+	m_venusPath.setView(this);
+	m_earthPath.setView(this);
+	m_marsPath.setView(this);
+	m_ship.setView(this);
+
+	// watch for the ship getting to mars
+	m_marsSOIEvent = m_ship.addEvent(PATHEVENT_SOI_ENTRY, &m_marsPath, MARS_SOI_RADIUS, false);
+	m_marsClosestEvent = m_ship.addEvent(PATHEVENT_CLOSEST_APPROACH, &m_marsPath, 0.0, false);
+	m_ship.rescanEvents();
+	m_shipHistory.init(&m_ship);
+
+	// what depends on what. The planets only depend on where they start, so they
+	// can work out together. The ship's propagation checks its events against
+	// mars's points, so it waits for mars, and the events wait for both.
+	m_venusPathNode = m_recompute.addNode("venus path", recomputePath, &m_venusPath);
+	m_earthPathNode = m_recompute.addNode("earth path", recomputePath, &m_earthPath);
+	m_marsPathNode = m_recompute.addNode("mars path", recomputePath, &m_marsPath);
+	m_shipNode = m_recompute.addNode("ship path", recomputeShip, &m_ship);
+	m_shipEventsNode = m_recompute.addNode("ship events", recomputeShipEvents, &m_ship);
+	m_recompute.addDependency(m_shipNode, m_marsPathNode);
+	m_recompute.addDependency(m_shipEventsNode, m_shipNode);
+	m_recompute.addDependency(m_shipEventsNode, m_marsPathNode);
+
+	int numThreads = (int)std::thread::hardware_concurrency();
+	if ( numThreads > RECOMPUTE_MAX_THREADS ) numThreads = RECOMPUTE_MAX_THREADS;
+	m_recompute.start(numThreads);
+
 	// internals
 	m_hoverPathPointIdx = -1;
 	m_hoverAccelPoint = NULL;
 	m_uiMode = UI_INERT;
 	m_bShowVenus = false;
+	m_bWarp = false;
+	m_warpTicks = 0;
+}
+
+void OBEngine::resetWorld()
+{
+	m_world.clear();
+	m_world.reserve(WARP_NUM_ASTEROIDS + 4);
+
+	// the planets start where their paths do, so warp starts on the first day of the mission
+	int sun = m_world.addObject(m_sun, -1);
+	m_world.addBody(sun, 0.0, m_venusPath.m_startPos.m_fixX, m_venusPath.m_startPos.m_fixY,
+		m_venusPath.m_startVel.m_fixX, m_venusPath.m_startVel.m_fixY, m_venus.m_color, 3);
+	m_world.addBody(sun, 0.0, m_earthPath.m_startPos.m_fixX, m_earthPath.m_startPos.m_fixY,
+		m_earthPath.m_startVel.m_fixX, m_earthPath.m_startVel.m_fixY, m_earth.m_color, 3);
+	m_world.addBody(sun, 0.0, m_marsPath.m_startPos.m_fixX, m_marsPath.m_startPos.m_fixY,
+		m_marsPath.m_startVel.m_fixX, m_marsPath.m_startVel.m_fixY, m_mars.m_color, 3);
+
+	// and a main belt
+	m_world.addBelt(sun, WARP_NUM_ASTEROIDS, WARP_BELT_MIN_DIST, WARP_BELT_MAX_DIST, 0x7f7f7f);
+	m_warpTicks = 0;
 }
 
 void OBEngine::onKeyPressed(int key)
@@ -76,6 +165,34 @@ void OBEngine::onKeyReleased(int key)
 		m_bShowVenus = !m_bShowVenus;
 	}
 
+	// zoom and pan from the keyboard. The mouse wheel zooms too.
+	if ( key == 37 ) panView(-m_screenW/4, 0); // left
+	if ( key == 39 ) panView(m_screenW/4, 0);  // right
+	if ( key == 38 ) panView(0, -m_screenH/4); // up
+	if ( key == 40 ) panView(0, m_screenH/4);  // down
+	if ( key == 33 ) setZoom(m_zoomLevel+1, m_screenW/2, m_screenH/2); // page up
+	if ( key == 34 ) setZoom(m_zoomLevel-1, m_screenW/2, m_screenH/2); // page down
+	if ( key == 36 ) resetView(); // home
+
+	if ( (key == 'M') && m_marsClosestEvent->m_bFired )
+	{
+		// go and look at the mars encounter
+		FGDoubleVector pos;
+		FGDoubleVector vel;
+		if ( m_ship.getStateAtTime(m_marsClosestEvent->m_time, pos, vel) )
+		{
+			setZoom(ZOOM_ENCOUNTER_LEVEL, m_screenW/2, m_screenH/2);
+			centerView(pos.m_fixX, pos.m_fixY);
+		}
+	}
+
+	if ( key == 'W' )
+	{
+		// time warp on or off. It always starts over from the beginning.
+		m_bWarp = !m_bWarp;
+		if ( m_bWarp ) resetWorld();
+	}
+
 	if ( key == 16 ) 
 	{
 		m_hoverPathPointIdx = -1;
@@ -83,14 +200,34 @@ void OBEngine::onKeyReleased(int key)
 		m_uiMode = UI_INERT;
 	}
 
+	if ( isKeyDown(17) && (key == 'Z') )
+	{
+		// undo
+		if ( m_shipHistory.undo() )
+		{
+			m_hoverAccelPoint = NULL;
+			shipChanged();
+		}
+		return;
+	}
+	if ( isKeyDown(17) && (key == 'Y') )
+	{
+		// redo
+		if ( m_shipHistory.redo() )
+		{
+			m_hoverAccelPoint = NULL;
+			shipChanged();
+		}
+		return;
+	}
+
 	if ( (key==8) || (key==46) )
 	{
 		// delete/backspace
 		if ( m_hoverAccelPoint != NULL )
 		{
 			m_ship.removeAccelerationPoint(m_hoverAccelPoint);
-			m_ship.calcPoints();
-			m_hoverAccelPoint = NULL;
+			shipEdited();
 		}
 	}
 
@@ -99,9 +236,9 @@ void OBEngine::onKeyReleased(int key)
 		// kill the thrust for this point
 		if ( m_hoverAccelPoint != NULL )
 		{
-			m_hoverAccelPoint->m_mag = 0.0;
-			m_ship.calcPoints();
-			m_hoverAccelPoint = NULL;
+			m_hoverAccelPoint->setMag(0.0);
+			m_ship.invalidateFrom(m_hoverAccelPoint->m_pointIdx);
+			shipEdited();
 		}
 	}
 
@@ -110,9 +247,9 @@ void OBEngine::onKeyReleased(int key)
 		// max out the thrust for this point
 		if ( m_hoverAccelPoint != NULL )
 		{
-			m_hoverAccelPoint->m_mag = PATH_ACCELERATION;
-			m_ship.calcPoints();
-			m_hoverAccelPoint = NULL;
+			m_hoverAccelPoint->setMag(PATH_ACCELERATION);
+			m_ship.invalidateFrom(m_hoverAccelPoint->m_pointIdx);
+			shipEdited();
 		}
 	}
 	if ( key == 'X' )
@@ -127,8 +264,8 @@ void OBEngine::onKeyReleased(int key)
 			{
 				m_hoverAccelPoint->m_type = ACCTYPE_NORMAL;
 			}
-			m_ship.calcPoints();
-			m_hoverAccelPoint = NULL;
+			m_ship.invalidateFrom(m_hoverAccelPoint->m_pointIdx);
+			shipEdited();
 		}
 	}
 	if ( key == 'R' )
@@ -143,11 +280,35 @@ void OBEngine::onKeyReleased(int key)
 			{
 				m_hoverAccelPoint->m_type = ACCTYPE_NORMAL;
 			}
-			m_ship.calcPoints();
-			m_hoverAccelPoint = NULL;
+			m_ship.invalidateFrom(m_hoverAccelPoint->m_pointIdx);
+			shipEdited();
 		}
 	}
 
+	if ( key == 'P' )
+	{
+		// run the ship through the patched conic evaluator and report on it
+		m_patchedConic.init(&m_ship, &m_earthPath, &m_marsPath);
+		PatchedConicResult result;
+		m_patchedConic.evaluate(result, NULL);
+
+		m_msg.set("Patched conic: Mars closest ");
+		addDistInfo(m_msg, (int)result.m_marsClosestDist);
+		m_msg.add(" on day ");
+		m_msg.add((int)(result.m_marsClosestTime/86400.0) + 1);
+		if ( result.m_bHalted )
+		{
+			m_msg.add(" (too close to the sun)");
+		}
+	}
+
+	if ( key == 'L' )
+	{
+		// find the cheapest ballistic transfer to mars and set the ship up to fly it
+		seedShipFromLambert();
+		shipEdited();
+	}
+
 	if ( key == ' ' )
 	{
 		// toggle playback
@@ -195,11 +356,16 @@ void OBEngine::load(const char *filename)
 	FGDataReader in;
 	in.init(inData);
 
-	m_earthPath.load(in);
-	m_marsPath.load(in);
-	m_ship.load(in);
+	m_earthPath.loadNoCalc(in);
+	m_marsPath.loadNoCalc(in);
+	m_ship.loadNoCalc(in);
 	delete inData;
 
+	// earth and mars work out side by side, then the ship after mars
+	m_recompute.markDirty(m_earthPathNode);
+	m_recompute.markDirty(m_marsPathNode);
+	shipEdited();
+
 	m_msg.set("Loaded ");
 	m_msg.add(filename);
 
@@ -212,6 +378,67 @@ void OBEngine::load(const char *filename)
 	int a=5;
 }
 
+void OBEngine::seedShipFromLambert()
+{
+	// porkchop the whole grid in one batch
+	int numCells = PORKCHOP_NUM_DEPARTURES*PORKCHOP_NUM_TOFS;
+	double *departDV = m_porkchopDepartDV;
+	double *arriveDV = m_porkchopArriveDV;
+	Lambert::porkchop(m_earthPath, m_marsPath,
+		0, PORKCHOP_NUM_DEPARTURES, PORKCHOP_DEPARTURE_STEP,
+		PORKCHOP_FIRST_TOF, PORKCHOP_NUM_TOFS, PORKCHOP_TOF_STEP,
+		m_lambertBatch, departDV, arriveDV);
+
+	// find the cheapest cell
+	int bestCell = -1;
+	for ( int cell=0 ; cell<numCells ; cell++ )
+	{
+		if ( departDV[cell] < 0.0 ) continue;
+		if ( (bestCell == -1) || (departDV[cell]+arriveDV[cell] < departDV[bestCell]+arriveDV[bestCell]) )
+		{
+			bestCell = cell;
+		}
+	}
+
+	if ( bestCell == -1 )
+	{
+		m_msg.set("No transfer found");
+	}
+	else
+	{
+		int departIdx = (bestCell/PORKCHOP_NUM_TOFS)*PORKCHOP_DEPARTURE_STEP;
+		int tofDays = PORKCHOP_FIRST_TOF + (bestCell%PORKCHOP_NUM_TOFS)*PORKCHOP_TOF_STEP;
+
+		// seed the ship with the departure burn
+		Lambert::seedPath(m_ship, departIdx, m_lambertBatch.m_v1x[bestCell], m_lambertBatch.m_v1y[bestCell]);
+
+		m_msg.set("Transfer: day ");
+		m_msg.add(departIdx+1);
+		m_msg.add(", ");
+		m_msg.add(tofDays);
+		m_msg.add(" days, dv ");
+		m_msg.add((int)(departDV[bestCell]*1000.0));
+		m_msg.add("+");
+		m_msg.add((int)(arriveDV[bestCell]*1000.0));
+		m_msg.add(" m/s");
+	}
+}
+
+void OBEngine::shipChanged()
+{
+	m_recompute.markDirty(m_shipNode);
+	m_recompute.update();
+}
+
+void OBEngine::shipEdited()
+{
+	shipChanged();
+	m_shipHistory.record();
+
+	// the edit may have removed the point we were hovering
+	m_hoverAccelPoint = NULL;
+}
+
 void OBEngine::onDrawSelf(FGGraphics &g)
 {
 	if ( m_uiMode == UI_PLAYBACK )
@@ -230,8 +457,9 @@ void OBEngine::drawPathObject(FGGraphics &g, Path *toDraw, int pointIdx)
 	int stopPoint = toDraw->getStopPoint();
 	if ( pointIdx > stopPoint ) return;
 
-	int x = modelToViewX(toDraw->m_points[pointIdx].m_fixX);
-	int y = modelToViewY(toDraw->m_points[pointIdx].m_fixY);
+	FGDoubleVector &pos = toDraw->getPoint(pointIdx);
+	int x = modelToViewX(pos.m_fixX);
+	int y = modelToViewY(pos.m_fixY);
 	g.fillRect(x-2, y-2, 5, 5);
 }
 
@@ -320,15 +548,32 @@ void OBEngine::drawNormal(FGGraphics &g)
 		out.add(daynum);
 
 		// report distances
-		int emDist = (int)FGDoubleGeometry::getDistance(m_earthPath.m_points[m_hoverPathPointIdx], m_marsPath.m_points[m_hoverPathPointIdx]);
-		int ehDist = (int)FGDoubleGeometry::getDistance(m_earthPath.m_points[m_hoverPathPointIdx], m_ship.m_points[m_hoverPathPointIdx]);
-		int mhDist = (int)FGDoubleGeometry::getDistance(m_marsPath.m_points[m_hoverPathPointIdx], m_ship.m_points[m_hoverPathPointIdx]);
+		FGDoubleVector &earthPos = m_earthPath.getPoint(m_hoverPathPointIdx);
+		FGDoubleVector &marsPos = m_marsPath.getPoint(m_hoverPathPointIdx);
+		FGDoubleVector &shipPos = m_ship.getPoint(m_hoverPathPointIdx);
+		int emDist = (int)FGDoubleGeometry::getDistance(earthPos, marsPos);
+		int ehDist = (int)FGDoubleGeometry::getDistance(earthPos, shipPos);
+		int mhDist = (int)FGDoubleGeometry::getDistance(marsPos, shipPos);
 		out.add("\nE-M Dist: ");
 		addDistInfo(out, emDist);
 		out.add("\nE-H Dist: ");
 		addDistInfo(out, ehDist);
 		out.add("\nH-M Dist: ");
 		addDistInfo(out, mhDist);
+
+		// and how close we get to mars overall
+		if ( m_marsClosestEvent->m_bFired )
+		{
+			out.add("\nH-M Closest: day ");
+			out.add((int)(m_marsClosestEvent->m_time/86400.0) + 1);
+			out.add(", ");
+			addDistInfo(out, (int)m_marsClosestEvent->m_dist);
+		}
+		if ( m_marsSOIEvent->m_bFired )
+		{
+			out.add("\nMars SOI: day ");
+			out.add((int)(m_marsSOIEvent->m_time/86400.0) + 1);
+		}
 		m_font.drawText(g, out.getNativeString(), 0, 0, m_screenW);
 
 		bShowPlanets = true;
@@ -360,6 +605,19 @@ void OBEngine::drawNormal(FGGraphics &g)
 		drawPathObject(g, &m_marsPath, m_hoverPathPointIdx);
 	}
 
+	// time warp
+	if ( m_bWarp )
+	{
+		m_world.drawSelf(g, *this);
+
+		FGString warp;
+		warp.set("Warp day ");
+		warp.add((int)(m_warpTicks*TICK_SECONDS/86400.0) + 1);
+		m_font.setJustify(FGFont::JUSTIFY_CENTER);
+		m_font.drawText(g, warp.getNativeString(), 0, m_screenH-20, m_screenW);
+		m_font.setJustify(FGFont::JUSTIFY_LEFT);
+	}
+
 	// message
 	if ( m_msg.length() > 0 )
 	{
@@ -385,6 +643,15 @@ void OBEngine::addDistInfo(FGString &str, int dist)
 
 void OBEngine::onTick()
 {
+	if ( m_bWarp )
+	{
+		for ( int i=0 ; i<WARP_TICKS_PER_FRAME ; i++ )
+		{
+			m_world.tick(TICK_SECONDS);
+		}
+		m_warpTicks += WARP_TICKS_PER_FRAME;
+	}
+
 	if ( m_uiMode == UI_PLAYBACK )
 	{
 		// do playback and nothing else
@@ -408,28 +675,28 @@ void OBEngine::onTick()
 	{
 		if ( m_hoverAccelPoint == NULL ) return;
 		m_ship.adjustAccelerationPoint(m_hoverAccelPoint, mx, my, m_hoverAccelPoint->m_mag);
-		m_ship.calcPoints();
+		shipChanged();
 	}
 	else if ( m_uiMode == UI_ADJUSTINGMARS)
 	{
 		// place mars's startling position. 
 		// First get the angle from the center
 		FGDoubleVector mouse;
-		mouse.setXY(mx-m_screenW/2, my-m_screenH/2);
+		mouse.setXY(mx-modelToViewX(0.0), my-modelToViewY(0.0));
 		double angle = mouse.getAngle();
 
 		// note mars's position and velocity at that angle
 		FGDoubleVector newPos;
 		FGDoubleVector newVel;
-		m_mars.m_orbit.getPos(angle, newPos);
-		m_mars.m_orbit.getVel(angle, newVel);
+		m_mars.m_orbit.getPosVel(angle, newPos, newVel);
 
 		// set it
 		m_marsPath.m_startPos.set(newPos);
 		m_marsPath.m_startVel.set(newVel);
 
-		// recalc
-		m_marsPath.calcPoints();
+		// recalc. The ship's mars events depend on where mars is.
+		m_recompute.markDirty(m_marsPathNode);
+		m_recompute.update();
 	}
 	else
 	{
@@ -476,13 +743,21 @@ void OBEngine::onMouseReleased(int button)
 	{
 		// time to add a point
 		AccelerationPoint *newPoint = m_ship.createAccelerationPoint(m_hoverPathPointIdx);
-		m_ship.calcPoints();
+		shipEdited();
+	}
+	else if ( m_uiMode == UI_ADJUSTINGPOINT )
+	{
+		// a drag is one edit, recorded when it's done
+		shipEdited();
 	}
 	m_uiMode = UI_INERT;
 }
 
 void OBEngine::onMouseWheel(int delta)
 {
+	// a notch at a time, around the mouse
+	if ( delta == 0 ) return;
+	setZoom(m_zoomLevel + ((delta > 0) ? 1 : -1), getMouseX(), getMouseY());
 }
 
 void OBEngine::onFileDrop(const char *filePath)
@@ -491,38 +766,47 @@ void OBEngine::onFileDrop(const char *filePath)
 	load(filePath);
 }
 
-int OBEngine::modelToViewX(double modelX)
+void OBEngine::setZoom(int zoomLevel, int anchorViewX, int anchorViewY)
 {
-	// offset to the centerpoint
-	double x = modelX - m_center.m_fixX;
-
-	// scale to the screen
-	x /= m_kmPerPixel;
-	int ret = (int)x;
-
-	// offset to center it
-	ret += m_screenW/2;
-	return ret;
+	if ( zoomLevel < ZOOM_MIN_LEVEL ) zoomLevel = ZOOM_MIN_LEVEL;
+	if ( zoomLevel > ZOOM_MAX_LEVEL ) zoomLevel = ZOOM_MAX_LEVEL;
+	if ( zoomLevel == m_zoomLevel ) return;
+
+	// note what's under the anchor
+	double anchorX = ((double)(m_viewOriginX + anchorViewX) + 0.5)*m_kmPerPixel;
+	double anchorY = ((double)(m_viewOriginY + anchorViewY) + 0.5)*m_kmPerPixel;
+
+	// the scale always comes from the level, so the same level always gets
+	// exactly the same scale, and the draw caches for it are found again
+	m_zoomLevel = zoomLevel;
+	m_kmPerPixel = m_baseKmPerPixel*pow(2.0, -(double)zoomLevel/(double)ZOOM_STEPS_PER_DOUBLING);
+
+	// put the anchor back under the same pixel. The center lands in the middle
+	// of a pixel, so the origin comes out exactly where we want it.
+	int originX = modelToLevelX(anchorX) - anchorViewX;
+	int originY = modelToLevelY(anchorY) - anchorViewY;
+	m_center.setXY(((double)(originX + m_screenW/2) + 0.5)*m_kmPerPixel, ((double)(originY + m_screenH/2) + 0.5)*m_kmPerPixel);
+	updateViewOrigin();
 }
 
-int OBEngine::modelToViewY(double modelY)
+void OBEngine::panView(int dx, int dy)
 {
-	// offset to the centerpoint
-	double y = modelY - m_center.m_fixY;
-
-	// scale to the screen
-	y /= m_kmPerPixel;
-	int ret = (int)y;
+	// whole pixels, so everything cached at this zoom just moves
+	int centerX = modelToLevelX(m_center.m_fixX) + dx;
+	int centerY = modelToLevelY(m_center.m_fixY) + dy;
+	m_center.setXY(((double)centerX + 0.5)*m_kmPerPixel, ((double)centerY + 0.5)*m_kmPerPixel);
+	updateViewOrigin();
+}
 
-	// offset to center it
-	ret += m_screenH/2;
-	return ret;
+void OBEngine::centerView(double modelX, double modelY)
+{
+	m_center.setXY(modelX, modelY);
+	updateViewOrigin();
 }
 
-// global helpers
-bool fnear(double a, double b, double slop)
+void OBEngine::resetView()
 {
-	double diff = fabs(a-b);
-	if ( diff < slop ) return true;
-	return false;
+	m_zoomLevel = 0;
+	m_kmPerPixel = m_baseKmPerPixel;
+	centerView(0.0, 0.0);
 }
@@ -7,8 +7,15 @@
 #include "FGTimer.h"
 
 #include "OBGlobals.h"
+#include "OBView.h"
 #include "OBObject.h"
+#include "OBWorld.h"
 #include "Path.h"
+#include "PathHistory.h"
+#include "PathCache.h"
+#include "PatchedConic.h"
+#include "Lambert.h"
+#include "RecomputeGraph.h"
 
 #define UI_INERT 0
 #define UI_ADDINGPOINT 1
@@ -16,7 +23,14 @@
 #define UI_ADJUSTINGMARS 3
 #define UI_PLAYBACK 4
 
-class OBEngine : public FGEngine
+// the porkchop grid searched when seeding the ship from a lambert transfer
+#define PORKCHOP_NUM_DEPARTURES 300
+#define PORKCHOP_DEPARTURE_STEP 2
+#define PORKCHOP_FIRST_TOF 100
+#define PORKCHOP_NUM_TOFS 150
+#define PORKCHOP_TOF_STEP 2
+
+class OBEngine : public FGEngine, public OBView
 {
 public:
 
@@ -38,8 +52,11 @@ public:
 	virtual int getForcedScreenWidth() { return 768; }
 	virtual int getForcedScreenHeight() { return 768; }
 
-	int modelToViewX(double modelX);
-	int modelToViewY(double modelY);
+	// zoom and pan. The projection itself is OBView's.
+	void setZoom(int zoomLevel, int anchorViewX, int anchorViewY); // keeps what's under the anchor where it is
+	void panView(int dx, int dy); // in pixels
+	void centerView(double modelX, double modelY);
+	void resetView();
 
 	void drawPlayback(FGGraphics &g);
 	void drawNormal(FGGraphics &g);
@@ -47,17 +64,17 @@ public:
 	void addDistInfo(FGString &str, int dist);
 
 	void load(const char *filename);
+	void seedShipFromLambert();
+	void shipEdited(); // note an edit to the ship for undo
+	void shipChanged(); // bring the ship and what depends on it up to date
+	void resetWorld(); // put the time warp bodies back at the start of the mission
 
 	// font
 	FGFont m_font;
 
-	// scale and translation
-	FGDoubleVector m_center; // this x,y location will be centered on screen
-	double m_kmPerPixel;
-
-	// cached for perf
-	int m_screenW;
-	int m_screenH;
+	// zoom
+	double m_baseKmPerPixel; // at zoom level 0, which shows all of mars's orbit
+	int m_zoomLevel;
 
 	// bodies
 	OBObject m_sun;
@@ -65,12 +82,39 @@ public:
 	OBObject m_earth;
 	OBObject m_mars;
 	Path m_ship;
+	PathHistory m_shipHistory; // undo/redo for edits to the ship
+	PathCache m_shipCache; // propagations of the ship we've already done
 
 	// paths
 	Path m_venusPath;
 	Path m_earthPath;
 	Path m_marsPath;
 
+	// ship events we report on
+	PathEvent *m_marsSOIEvent;
+	PathEvent *m_marsClosestEvent;
+
+	// what gets worked out again when something changes
+	RecomputeGraph m_recompute;
+	RecomputeNode *m_venusPathNode;
+	RecomputeNode *m_earthPathNode;
+	RecomputeNode *m_marsPathNode;
+	RecomputeNode *m_shipNode;
+	RecomputeNode *m_shipEventsNode;
+
+	// quick patched conic evaluation of the ship
+	PatchedConic m_patchedConic;
+
+	// lambert porkchop working space
+	LambertBatch m_lambertBatch;
+	double m_porkchopDepartDV[PORKCHOP_NUM_DEPARTURES*PORKCHOP_NUM_TOFS];
+	double m_porkchopArriveDV[PORKCHOP_NUM_DEPARTURES*PORKCHOP_NUM_TOFS];
+
+	// live bodies for time warp
+	OBWorld m_world;
+	bool m_bWarp;
+	int m_warpTicks;
+
 	// UI stuff
 	int m_uiMode; // a UI_XXXX constant
 	int m_hoverPathPointIdx;
@@ -0,0 +1,11 @@
+
+#include "OBGlobals.h"
+#include <math.h>
+
+// global helpers
+bool fnear(double a, double b, double slop)
+{
+	double diff = fabs(a-b);
+	if ( diff < slop ) return true;
+	return false;
+}
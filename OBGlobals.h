@@ -5,6 +5,8 @@
 
 // SGPs are in km^3/s^2
 #define SUN_SGP (132712440018.0) 
+#define EARTH_SGP (398600.4418)
+#define MARS_SGP (42828.37)
 
 
 // distances are in km
@@ -12,6 +14,10 @@
 #define EARTH_APOGEE  (152098232.0)
 #define MARS_APOGEE   (249209300.0)
 
+// sphere of influence radii, in km
+#define EARTH_SOI_RADIUS (924000.0)
+#define MARS_SOI_RADIUS  (577000.0)
+
 // velocities are in km/s
 #define VENUS_APOGEE_VEL (35.02)
 #define EARTH_APOGEE_VEL (29.3)
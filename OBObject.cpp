@@ -1,10 +1,12 @@
 #include "OBObject.h"
-#include "OBEngine.h"
+#include "OBView.h"
 
 #include "FGDoubleGeometry.h"
+#include "PathKernel.h"
 
 OBObject::OBObject()
 {
+	m_view = NULL;
 }
 
 OBObject::~OBObject()
@@ -19,8 +21,6 @@ void OBObject::initOrbitee(double sgp, FGDoubleVector &pos, int color, int size)
 	m_size = size;
 	m_sgp = sgp;
 	m_orbitee = NULL;
-
-	m_engine = (OBEngine *)FGEngine::getEngine();
 }
 
 void OBObject::initOrbiter(OBObject *orbitee, double apogeeDist, double apogeeVel, double aop, int color, int size)
@@ -52,7 +52,6 @@ void OBObject::initOrbiter(OBObject *orbitee, FGDoubleVector &pos, FGDoubleVecto
 	m_size = size;
 	m_sgp = 0.0;
 	m_orbitee = orbitee;
-	m_engine = (OBEngine *)FGEngine::getEngine();
 
 	// prep the orbit
 	m_orbit.initPV(m_orbitee->m_sgp, m_pos, m_vel);
@@ -66,52 +65,40 @@ void OBObject::initOrbiter(OBObject *orbitee, Orbit &orbit, double theta, int co
 	m_size = size;
 	m_sgp = 0.0;
 	m_orbitee = orbitee;
-	m_engine = (OBEngine *)FGEngine::getEngine();
 
 	// adopt that orbit, and note color stuff
 	m_orbit.set(orbit);
 	m_orbit.setColorFromObjectColor(m_color);
 
 	// work out our position and velocity from the sent-in angle
-	m_orbit.getPos(theta, m_pos);
-	m_orbit.getVel(theta, m_vel);
+	m_orbit.getPosVel(theta, m_pos, m_vel);
 }
 
 void OBObject::tick(double seconds)
 {
 	if ( m_orbitee == NULL ) return;
 
-	// accelerate based on the gravitic object
-	// start with a vector pointed at the orbitee
-	FGDoubleVector acc;
-	acc.set(m_orbitee->m_pos);
-	acc.subtractVector(m_pos);
-
-	// work out the strength of the acceleration. 
-	// It'll be u/d^2 where u = SGP, and d = distance to the object
-	// this is a good time to include the seconds value
-	double accLen = (seconds * m_orbitee->m_sgp)/acc.getLengthSq();
-	
-	// set the new length
-	acc.setLength(accLen);
-
-	// apply the acceleration
-	m_vel.addVector(acc);
-
-	// apply the velocity. Our vel is in km/s, so we need to multiply
-	FGDoubleVector toAdd;
-	toAdd.set(m_vel);
-	toAdd.scalarMultiply(seconds);
-	m_pos.addVector(toAdd);
+	// accelerate based on the gravitic object, then apply the velocity.
+	// This is the same kernel the paths use, with no thrust.
+	PathKernelDefault::State state;
+	state.m_pos = PathKernelDefault::Vec(m_pos.m_fixX, m_pos.m_fixY);
+	state.m_vel = PathKernelDefault::Vec(m_vel.m_fixX, m_vel.m_fixY);
+	PathKernelDefault::Vec center(m_orbitee->m_pos.m_fixX, m_orbitee->m_pos.m_fixY);
+	PathKernelDefault::Vec noThrust(0.0, 0.0);
+
+	PathKernelDefault::step(state, center, m_orbitee->m_sgp, noThrust, seconds, false);
+
+	m_pos.setXY(state.m_pos.x(), state.m_pos.y());
+	m_vel.setXY(state.m_vel.x(), state.m_vel.y());
 }
 
 void OBObject::drawSelf(FGGraphics &g)
 {
-	m_orbit.drawSelf(g);
+	m_orbit.drawSelf(g, *m_view);
 
 	// note our location, offset by half our size
-	int x = m_engine->modelToViewX(m_pos.m_fixX) - m_size/2;
-	int y = m_engine->modelToViewY(m_pos.m_fixY) - m_size/2;
+	int x = m_view->modelToViewX(m_pos.m_fixX) - m_size/2;
+	int y = m_view->modelToViewY(m_pos.m_fixY) - m_size/2;
 
 	g.setColor(m_color);
 	g.fillRect(x, y, m_size, m_size);
@@ -122,4 +109,3 @@ void OBObject::recalcOrbit()
 	m_orbit.initPV(m_orbit.m_u, m_pos, m_vel);
 }
 
-
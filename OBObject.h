@@ -5,7 +5,7 @@
 #include "FGGraphics.h"
 #include "Orbit.h"
 
-class OBEngine;
+class OBView;
 
 class OBObject
 {
@@ -18,6 +18,8 @@ public:
 	void initOrbiter(OBObject *orbitee, FGDoubleVector &pos, FGDoubleVector &vel, int color, int size);
 	void initOrbiter(OBObject *orbitee, double apogeeDist, double apogeeVel, double aop, int color, int size);
 	void initOrbiter(OBObject *orbitee, Orbit &orbit, double theta, int color, int size);
+	// draw through this view. Headless objects don't need one.
+	void setView(OBView *view) { m_view = view; }
 	void drawSelf(FGGraphics &g);
 	void tick(double seconds); 
 
@@ -36,8 +38,8 @@ public:
 	// relevant only if something is orbiting this
 	double m_sgp;
 
-	// cached for perf
-	OBEngine *m_engine;
+	// where we're drawn, or NULL. Not owned.
+	OBView *m_view;
 
 	// the thing we're orbiting
 	OBObject *m_orbitee;
@@ -0,0 +1,37 @@
+
+#include "OBScenario.h"
+
+OBScenario::OBScenario()
+{
+	m_marsSOIEvent = NULL;
+	m_marsClosestEvent = NULL;
+}
+
+OBScenario::~OBScenario()
+{
+}
+
+void OBScenario::init()
+{
+	// the sun is in the middle and doesn't move
+	FGDoubleVector pos;
+	pos.setXY(0.0, 0.0);
+	m_sun.initOrbitee(SUN_SGP, pos, 0xffffff, 8);
+
+	// the planets
+	m_earth.initOrbiter(&m_sun, EARTH_APOGEE, EARTH_APOGEE_VEL, EARTH_AOP, 0x7f7fff, 1);
+	m_mars.initOrbiter(&m_sun, MARS_APOGEE, MARS_APOGEE_VEL, MARS_AOP, 0xff7f7f, 1);
+
+	// July 7, 2035. Same as the app.
+	m_earthPath.m_cache = &m_planetCache;
+	m_marsPath.m_cache = &m_planetCache;
+	m_ship.m_cache = &m_shipCache;
+	m_earthPath.initNoAcc(&m_earth, 4.9745875522);
+	m_marsPath.initNoAcc(&m_mars, 5.4429575522);
+	m_ship.init(&m_sun, m_earthPath.m_startPos, m_earthPath.m_startVel, 0x7f7f7f, 5);
+
+	// watch for the ship getting to mars
+	m_marsSOIEvent = m_ship.addEvent(PATHEVENT_SOI_ENTRY, &m_marsPath, MARS_SOI_RADIUS, false);
+	m_marsClosestEvent = m_ship.addEvent(PATHEVENT_CLOSEST_APPROACH, &m_marsPath, 0.0, false);
+	m_ship.rescanEvents();
+}
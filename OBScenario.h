@@ -0,0 +1,39 @@
+
+#ifndef __OBSCENARIO__
+#define __OBSCENARIO__
+
+#include "OBGlobals.h"
+#include "OBObject.h"
+#include "Path.h"
+#include "PathCache.h"
+
+// The sun, earth and mars, their paths, and the ship, set up the way the app
+// starts. No graphics, so batch tools and the server can use it without an engine.
+class OBScenario
+{
+public:
+	OBScenario();
+	~OBScenario();
+
+	void init();
+
+	// bodies
+	OBObject m_sun;
+	OBObject m_earth;
+	OBObject m_mars;
+
+	// paths
+	Path m_earthPath;
+	Path m_marsPath;
+	Path m_ship;
+
+	// ship events
+	PathEvent *m_marsSOIEvent;
+	PathEvent *m_marsClosestEvent;
+
+	// propagations we've already done. These stay warm between evaluations.
+	PathCache m_planetCache;
+	PathCache m_shipCache;
+};
+
+#endif
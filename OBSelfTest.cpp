@@ -0,0 +1,1258 @@
+
+#include "OBSelfTest.h"
+#include "OBScenario.h"
+#include "Lambert.h"
+#include "Kepler.h"
+#include "PathHistory.h"
+#include "IntegratorHarness.h"
+#include "ThrustSchedule.h"
+#include "TrajectoryAPI.h"
+#include "Sweep.h"
+#include "CompactPath.h"
+#include "MissionPath.h"
+#include "PointGrid.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+// where the checked in fixtures are. The self-test is run from the top of the tree.
+#define SELFTEST_FIXTURE_DIR "fixtures"
+
+// how finely sampleSegments cuts up each step
+#define SELFTEST_SEGMENT_SAMPLES 1000
+
+// the trajectory API check's batch, and how many threads run it at once
+#define SELFTEST_TRAJ_BATCH 16
+#define SELFTEST_TRAJ_THREADS 4
+
+// the mission path check's long paths: 30 years, and how many blocks the small ones keep
+#define SELFTEST_MISSION_POINTS (365*30)
+#define SELFTEST_MISSION_RESIDENT 2
+
+// the sweep check's grid: 20 departures, 12 angles, 8 burn lengths
+#define SELFTEST_SWEEP_SPEC "0 20 3  12 0.0 0.5236  0 8 20\n"
+
+SelfTestCheck OBSelfTest::s_checks[] =
+{
+	{ "pointgrid",        &OBSelfTest::checkPointGrid },
+	{ "kernel-outputs",   &OBSelfTest::checkKernelOutputs },
+	{ "events",           &OBSelfTest::checkEvents },
+	{ "lambert",          &OBSelfTest::checkLambert },
+	{ "edits",            &OBSelfTest::checkEdits },
+	{ "stm",              &OBSelfTest::checkSTM },
+	{ "harness",          &OBSelfTest::checkHarness },
+	{ "schedule",         &OBSelfTest::checkSchedule },
+	{ "trajectory-api",   &OBSelfTest::checkTrajectoryAPI },
+#ifndef _WIN32
+	{ "sweep",            &OBSelfTest::checkSweep },
+#endif
+	{ "compact-path",     &OBSelfTest::checkCompactPath },
+	{ "mission-path",     &OBSelfTest::checkMissionPath },
+};
+#define SELFTEST_NUM_CHECKS ((int)(sizeof(OBSelfTest::s_checks)/sizeof(OBSelfTest::s_checks[0])))
+
+OBSelfTest::OBSelfTest()
+{
+	m_scratchDir = ".";
+	m_random = 1;
+	m_note[0] = 0;
+}
+
+OBSelfTest::~OBSelfTest()
+{
+}
+
+int OBSelfTest::run(const char *filter, const char *scratchDir)
+{
+	m_scratchDir = scratchDir;
+
+	int numRun = 0;
+	int numFailed = 0;
+	for ( int i=0 ; i<SELFTEST_NUM_CHECKS ; i++ )
+	{
+		SelfTestCheck &check = s_checks[i];
+		if ( (filter != NULL) && (strncmp(check.m_name, filter, strlen(filter)) != 0) ) continue;
+
+		m_note[0] = 0;
+		seed(1);
+		bool bPassed = (this->*check.m_run)();
+		printf("%-18s %-6s %s\n", check.m_name, bPassed ? "ok" : "FAILED", m_note);
+		fflush(stdout);
+
+		numRun++;
+		if ( !bPassed ) numFailed++;
+	}
+
+	printf("%d of %d checks passed\n", numRun-numFailed, numRun);
+	return numFailed;
+}
+
+int OBSelfTest::randomInt(int n)
+{
+	// the usual LCG. The high bits are the good ones.
+	m_random = m_random*1103515245u + 12345u;
+	return (int)((m_random >> 8) % (unsigned int)n);
+}
+
+double OBSelfTest::randomDouble(double lo, double hi)
+{
+	return lo + (hi-lo)*(double)randomInt(1 << 24)/(double)(1 << 24);
+}
+
+void OBSelfTest::note(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	vsnprintf(m_note, sizeof(m_note), format, args);
+	va_end(args);
+}
+
+OBScenario *OBSelfTest::makeScenario()
+{
+	OBScenario *scenario = new OBScenario();
+	scenario->init();
+
+	// checks want to see the propagation, not the cache
+	scenario->m_earthPath.m_cache = NULL;
+	scenario->m_marsPath.m_cache = NULL;
+	scenario->m_ship.m_cache = NULL;
+	return scenario;
+}
+
+void OBSelfTest::addTestBurns(Path &path)
+{
+	AccelerationPoint *ap = path.createAccelerationPoint(60);
+	ap->setAccel(0.0, 0.0);
+	ap = path.createAccelerationPoint(200);
+	ap->m_type = ACCTYPE_REDIRECT;
+	ap->setAccel(2.0, PATH_ACCELERATION*0.5);
+	ap = path.createAccelerationPoint(260);
+	ap->setAccel(0.0, 0.0);
+	path.invalidateFrom(0);
+}
+
+bool OBSelfTest::matchesFresh(Path &path, PathEvent *event)
+{
+	Path *fresh = new Path();
+	fresh->initNoAcc(path.m_orbitee, path.m_startPos, path.m_startVel, 0xffffff, 5);
+	for ( AccelerationPointIter iter = path.m_accelerationPoints.begin() ; iter != path.m_accelerationPoints.end() ; iter++ )
+	{
+		fresh->m_accelerationPoints.push_back(new AccelerationPoint(**iter));
+	}
+	PathEvent *freshEvent = fresh->addEvent(event->m_type, event->m_target, event->m_radius, event->m_bTerminal);
+	fresh->calcPoints();
+
+	// the path's own points may only go part way, and its events and halt aren't
+	// known until they go all the way
+	path.ensurePoints(PATH_NUM_POINTS-1);
+	int stopIdx = path.getStopPoint();
+	bool bSame = (stopIdx == fresh->getStopPoint()) && (path.m_haltIdx == fresh->m_haltIdx);
+	for ( int i=0 ; bSame && (i<=stopIdx) ; i++ )
+	{
+		FGDoubleVector &p = path.getPoint(i);
+		FGDoubleVector &q = fresh->getPoint(i);
+		if ( (p.m_fixX != q.m_fixX) || (p.m_fixY != q.m_fixY) ) bSame = false;
+	}
+	if ( (event->m_bFired != freshEvent->m_bFired) || (event->m_time != freshEvent->m_time) ||
+		(event->m_dist != freshEvent->m_dist) ) bSame = false;
+
+	for ( AccelerationPointIter iter = fresh->m_accelerationPoints.begin() ; iter != fresh->m_accelerationPoints.end() ; iter++ ) delete *iter;
+	delete fresh;
+	return bSame;
+}
+
+void OBSelfTest::sampleSegments(Path &path, Path *target, int lastIdx, double radius,
+	double &outMinDist, double &outMinTime, double &outEntryTime)
+{
+	outMinDist = -1.0;
+	outMinTime = 0.0;
+	outEntryTime = -1.0;
+	for ( int i=1 ; i<=lastIdx ; i++ )
+	{
+		double rx0 = path.getPoint(i-1).m_fixX;
+		double ry0 = path.getPoint(i-1).m_fixY;
+		double rx1 = path.getPoint(i).m_fixX;
+		double ry1 = path.getPoint(i).m_fixY;
+		if ( target != NULL )
+		{
+			rx0 -= target->getPoint(i-1).m_fixX;
+			ry0 -= target->getPoint(i-1).m_fixY;
+			rx1 -= target->getPoint(i).m_fixX;
+			ry1 -= target->getPoint(i).m_fixY;
+		}
+
+		for ( int j=0 ; j<=SELFTEST_SEGMENT_SAMPLES ; j++ )
+		{
+			double s = (double)j/(double)SELFTEST_SEGMENT_SAMPLES;
+			double rx = rx0 + s*(rx1-rx0);
+			double ry = ry0 + s*(ry1-ry0);
+			double dist = sqrt(rx*rx + ry*ry);
+			double t = ((double)(i-1) + s)*POINTS_TIME;
+			if ( (outMinDist < 0.0) || (dist < outMinDist) )
+			{
+				outMinDist = dist;
+				outMinTime = t;
+			}
+			if ( (outEntryTime < 0.0) && (dist < radius) ) outEntryTime = t;
+		}
+	}
+}
+
+// PointGrid::findNearest against a scan of every point. Once on screen-sized
+// coordinates, and once spread over millions of pixels, the way a path looks
+// zoomed right in, where the grid grows its cells and the far points in a
+// cell are too far away to square.
+bool OBSelfTest::checkPointGrid()
+{
+	const int numPoints = 900;
+	const int numQueries = 20000;
+	const int maxDist = 110;
+	int spreads[2] = { 1024, 4000000 };
+
+	int viewX[numPoints];
+	int viewY[numPoints];
+	int numWrong = 0;
+	for ( int pass=0 ; pass<2 ; pass++ )
+	{
+		int spread = spreads[pass];
+		for ( int i=0 ; i<numPoints ; i++ )
+		{
+			viewX[i] = randomInt(2*spread+1) - spread;
+			viewY[i] = randomInt(2*spread+1) - spread;
+		}
+
+		PointGrid grid;
+		grid.build(viewX, viewY, numPoints, maxDist);
+		for ( int q=0 ; q<numQueries ; q++ )
+		{
+			// half of them right by a point, so there's something to find
+			int qx, qy;
+			if ( (q & 1) != 0 )
+			{
+				int i = randomInt(numPoints);
+				qx = viewX[i] + randomInt(2*maxDist) - maxDist;
+				qy = viewY[i] + randomInt(2*maxDist) - maxDist;
+			}
+			else
+			{
+				qx = randomInt(2*spread+1) - spread;
+				qy = randomInt(2*spread+1) - spread;
+			}
+
+			int best = -1;
+			long long bestDistSq = 0;
+			for ( int i=0 ; i<numPoints ; i++ )
+			{
+				long long dx = (long long)qx - viewX[i];
+				long long dy = (long long)qy - viewY[i];
+				long long distSq = dx*dx + dy*dy;
+				if ( distSq >= (long long)maxDist*maxDist ) continue;
+				if ( (best == -1) || (distSq < bestDistSq) )
+				{
+					best = i;
+					bestDistSq = distSq;
+				}
+			}
+
+			if ( grid.findNearest(qx, qy, maxDist) != best ) numWrong++;
+		}
+	}
+
+	note("%d queries, %d differ from a full scan", 2*numQueries, numWrong);
+	return (numWrong == 0);
+}
+
+// The default kernel writes the same points whatever it writes them in to, and
+// they're the points the path works out for itself.
+bool OBSelfTest::checkKernelOutputs()
+{
+	OBScenario *scenario = makeScenario();
+	Path &ship = scenario->m_ship;
+	addTestBurns(ship);
+	ship.calcPoints();
+
+	int stopIdx = ship.getStopPoint();
+	FGDoubleVector *vectors = new FGDoubleVector[PATH_NUM_POINTS];
+	PathKernelDefault::Vec *vecs = new PathKernelDefault::Vec[PATH_NUM_POINTS];
+	PathPoint *points = new PathPoint[PATH_NUM_POINTS];
+	ship.propagate<PathKernelDefault>(vectors);
+	ship.propagate<PathKernelDefault>(vecs);
+	ship.propagate<PathKernelDefault>(points);
+
+	int numDiffer = 0;
+	for ( int i=0 ; i<=stopIdx ; i++ )
+	{
+		FGDoubleVector &p = ship.getPoint(i);
+		bool bSame = (vectors[i].m_fixX == p.m_fixX) && (vectors[i].m_fixY == p.m_fixY) &&
+			(vecs[i].x() == p.m_fixX) && (vecs[i].y() == p.m_fixY) &&
+			(points[i].m_x == p.m_fixX) && (points[i].m_y == p.m_fixY);
+		if ( !bSame ) numDiffer++;
+	}
+
+	delete[] vectors;
+	delete[] vecs;
+	delete[] points;
+	delete scenario;
+
+	note("%d points, %d differ between output types", stopIdx+1, numDiffer);
+	return (numDiffer == 0);
+}
+
+// The events against sampleSegments: a closest approach to the sun and two
+// thresholds on a long ellipse, one of them only crossed between points, a
+// closest approach to mars, and a sun approach
+// that halts a ship falling in. The refined times have to land within a sample
+// of the slow answer, and the distances within a hair of it.
+bool OBSelfTest::checkEvents()
+{
+	OBScenario *scenario = makeScenario();
+	int numBad = 0;
+	double worstTime = 0.0;
+
+	// a long ellipse, in past the earth once and well clear of the sun
+	Path *probe = new Path();
+	FGDoubleVector pos, vel;
+	pos.setXY(-3.0e8, 0.0);
+	vel.setXY(25.0, 12.0);
+	probe->initNoAcc(&scenario->m_sun, pos, vel, 0xffffff, 5);
+	probe->m_cache = NULL;
+	PathEvent *closest = probe->addEvent(PATHEVENT_CLOSEST_APPROACH, NULL, 0.0, false);
+	PathEvent *threshold = probe->addEvent(PATHEVENT_THRESHOLD, NULL, 1.0e8, false);
+	probe->calcPoints();
+
+	double minDist, minTime, entryTime;
+	sampleSegments(*probe, NULL, probe->getStopPoint(), threshold->m_radius, minDist, minTime, entryTime);
+	if ( !closest->m_bFired || (closest->m_dist > minDist) || (closest->m_dist < minDist*(1.0-1e-6)) ) numBad++;
+	if ( fabs(closest->m_time - minTime) > worstTime ) worstTime = fabs(closest->m_time - minTime);
+	if ( !threshold->m_bFired || (entryTime < 0.0) || (fabs(threshold->m_dist - threshold->m_radius) > 1.0) ) numBad++;
+	if ( fabs(threshold->m_time - entryTime) > worstTime ) worstTime = fabs(threshold->m_time - entryTime);
+
+	// a radius the path only dips inside between two points
+	double minPointDist = -1.0;
+	for ( int i=0 ; i<=probe->getStopPoint() ; i++ )
+	{
+		double dist = probe->getPoint(i).getLength();
+		if ( (minPointDist < 0.0) || (dist < minPointDist) ) minPointDist = dist;
+	}
+	PathEvent *graze = probe->addEvent(PATHEVENT_THRESHOLD, NULL, 0.5*(minDist + minPointDist), false);
+	probe->rescanEvents();
+	sampleSegments(*probe, NULL, probe->getStopPoint(), graze->m_radius, minDist, minTime, entryTime);
+	if ( !graze->m_bFired || (entryTime < 0.0) || (fabs(graze->m_dist - graze->m_radius) > 1.0) ) numBad++;
+	if ( fabs(graze->m_time - entryTime) > worstTime ) worstTime = fabs(graze->m_time - entryTime);
+
+	// the ship's closest approach to mars, with some burns to make it interesting
+	Path &ship = scenario->m_ship;
+	addTestBurns(ship);
+	ship.calcPoints();
+	closest = scenario->m_marsClosestEvent;
+	sampleSegments(ship, &scenario->m_marsPath, ship.getStopPoint(), 0.0, minDist, minTime, entryTime);
+	if ( !closest->m_bFired || (closest->m_dist > minDist) || (closest->m_dist < minDist*(1.0-1e-6)) ) numBad++;
+	if ( fabs(closest->m_time - minTime) > worstTime ) worstTime = fabs(closest->m_time - minTime);
+
+	// falling in to the sun. It should stop there, and the rest of the points sit at the halt.
+	pos.setXY(-1.5e8, 0.0);
+	vel.setXY(0.0, 5.0);
+	probe->initNoAcc(&scenario->m_sun, pos, vel, 0xffffff, 5);
+	probe->m_cache = NULL;
+	PathEvent *fatal = probe->addEvent(PATHEVENT_SUN_APPROACH, NULL, FATAL_SUN_APPROACH, true);
+	probe->calcPoints();
+
+	int haltIdx = probe->m_haltIdx;
+	if ( !fatal->m_bFired || (haltIdx == -1) || (haltIdx != fatal->m_pointIdx) )
+	{
+		numBad++;
+	}
+	else
+	{
+		sampleSegments(*probe, NULL, haltIdx, FATAL_SUN_APPROACH, minDist, minTime, entryTime);
+		if ( (entryTime < 0.0) || (fabs(fatal->m_dist - FATAL_SUN_APPROACH) > 1.0) ) numBad++;
+		if ( fabs(fatal->m_time - entryTime) > worstTime ) worstTime = fabs(fatal->m_time - entryTime);
+		for ( int i=haltIdx+1 ; i<PATH_NUM_POINTS ; i++ )
+		{
+			FGDoubleVector &p = probe->getPoint(i);
+			if ( (p.m_fixX != probe->getPoint(haltIdx).m_fixX) || (p.m_fixY != probe->getPoint(haltIdx).m_fixY) )
+			{
+				numBad++;
+				break;
+			}
+		}
+	}
+
+	delete probe;
+	delete scenario;
+
+	if ( worstTime > POINTS_TIME/SELFTEST_SEGMENT_SAMPLES ) numBad++;
+	note("%d bad, worst time %.0f s off (halted at %d)", numBad, worstTime, haltIdx);
+	return (numBad == 0);
+}
+
+// Lambert round trips. Coast a random orbit forward with Kepler, then ask the
+// batch solver how to get from the start to the end in that time. It should
+// come back with the velocity we started with, to within a cm/s. Transfers of
+// close to half an orbit are the worst, since the geometry says little there.
+// Both directions.
+bool OBSelfTest::checkLambert()
+{
+	const int numPairs = 2000;
+	LambertBatch batch;
+	batch.alloc(numPairs);
+	double *startVX = new double[numPairs];
+	double *startVY = new double[numPairs];
+
+	int numInvalid = 0;
+	double worstErr = 0.0;
+	for ( int direction=-1 ; direction<=1 ; direction+=2 )
+	{
+		for ( int k=0 ; k<numPairs ; k++ )
+		{
+			// somewhere around the earth, a bit slower or faster than circular,
+			// for 60 to 260 days
+			double r = 1.5e8*randomDouble(0.7, 1.3);
+			double angle = randomDouble(0.0, 2.0*M_PI);
+			double speed = sqrt(SUN_SGP/r)*randomDouble(0.85, 1.15)*(double)direction;
+			batch.m_r1x[k] = r*cos(angle);
+			batch.m_r1y[k] = r*sin(angle);
+			startVX[k] = -speed*sin(angle);
+			startVY[k] = speed*cos(angle);
+
+			// the solver is single revolution, so keep well short of a full orbit
+			double a = 1.0/(2.0/r - speed*speed/SUN_SGP);
+			double period = 2.0*M_PI*sqrt(a*a*a/SUN_SGP);
+			batch.m_tof[k] = POINTS_TIME*randomDouble(60.0, 260.0);
+			if ( batch.m_tof[k] > 0.8*period ) batch.m_tof[k] = 0.8*period;
+
+			double vx, vy;
+			Kepler::propagate(SUN_SGP, batch.m_r1x[k], batch.m_r1y[k], startVX[k], startVY[k], batch.m_tof[k],
+				batch.m_r2x[k], batch.m_r2y[k], vx, vy);
+		}
+
+		Lambert::solveBatch(SUN_SGP, direction, batch);
+		for ( int k=0 ; k<numPairs ; k++ )
+		{
+			if ( !batch.m_bValid[k] )
+			{
+				numInvalid++;
+				continue;
+			}
+
+			double err = hypot(batch.m_v1x[k] - startVX[k], batch.m_v1y[k] - startVY[k]);
+			if ( err > worstErr ) worstErr = err;
+		}
+	}
+
+	delete[] startVX;
+	delete[] startVY;
+
+	// seedPath's burn, against the same ship left to coast. By the cutoff the
+	// difference should be the delta-v we asked for, give or take what rounding
+	// the burn to whole days and the sun moving round during it do. A tenth of
+	// a km/s covers those.
+	OBScenario *scenario = makeScenario();
+	Path &ship = scenario->m_ship;
+	Path *coast = new Path();
+	coast->initNoAcc(&scenario->m_sun, ship.m_startPos, ship.m_startVel, 0xffffff, 5);
+	coast->m_cache = NULL;
+
+	const int departIdx = 100;
+	FGDoubleVector coastVel;
+	coast->getNodeVel(departIdx, coastVel);
+	double dvX = 0.6;
+	double dvY = -0.8;
+	Lambert::seedPath(ship, departIdx, coastVel.m_fixX + dvX, coastVel.m_fixY + dvY);
+
+	int cutoffIdx = departIdx + (int)(hypot(dvX, dvY)/PATH_ACCELERATION/POINTS_TIME + 0.5);
+	FGDoubleVector shipVel;
+	ship.getNodeVel(cutoffIdx, shipVel);
+	coast->getNodeVel(cutoffIdx, coastVel);
+	double seedErr = hypot(shipVel.m_fixX - coastVel.m_fixX - dvX, shipVel.m_fixY - coastVel.m_fixY - dvY);
+
+	delete coast;
+	delete scenario;
+
+	note("%d pairs, %d no solution, worst %g km/s out, seeded burn %g km/s out", 2*numPairs, numInvalid, worstErr, seedErr);
+	return (numInvalid == 0) && (worstErr < 1e-5) && (seedErr < 0.1);
+}
+
+// Random edits to the ship, with the history recording, undoing and redoing
+// between them and the points read part way along now and then. However it
+// got there, the ship has to match the same ship worked out from scratch.
+// The ship keeps its cache here, the way the app runs it.
+bool OBSelfTest::checkEdits()
+{
+	OBScenario *scenario = makeScenario();
+	Path &ship = scenario->m_ship;
+	ship.m_cache = &scenario->m_shipCache;
+	PathHistory history;
+	history.init(&ship);
+
+	const int numEdits = 300;
+	int numChecked = 0;
+	int numDiffer = 0;
+	for ( int i=0 ; i<numEdits ; i++ )
+	{
+		int pointIdx = 1 + randomInt(PATH_NUM_POINTS-2);
+		int numAPs = (int)ship.m_accelerationPoints.size();
+		switch ( randomInt(4) )
+		{
+		case 0:
+			{
+				AccelerationPoint *ap = ship.createAccelerationPoint(pointIdx);
+				ap->setAccel(randomDouble(0.0, 2.0*M_PI), (double)randomInt(2)*PATH_ACCELERATION);
+				ship.invalidateFrom(pointIdx);
+			}
+			break;
+		case 1:
+			// anything but the first
+			if ( numAPs > 1 )
+			{
+				AccelerationPointIter iter = ship.m_accelerationPoints.begin();
+				std::advance(iter, 1 + randomInt(numAPs-1));
+				ship.removeAccelerationPoint(*iter);
+			}
+			break;
+		case 2:
+			{
+				AccelerationPointIter iter = ship.m_accelerationPoints.begin();
+				std::advance(iter, randomInt(numAPs));
+				(*iter)->m_type = randomInt(3);
+				ship.invalidateFrom((*iter)->m_pointIdx);
+			}
+			break;
+		default:
+			if ( randomInt(2) == 0 )
+			{
+				history.undo();
+			}
+			else
+			{
+				history.redo();
+			}
+			break;
+		}
+
+		if ( randomInt(3) == 0 ) ship.getPoint(randomInt(PATH_NUM_POINTS));
+		if ( randomInt(2) == 0 ) history.record();
+		if ( randomInt(4) == 0 )
+		{
+			numChecked++;
+			if ( !matchesFresh(ship, scenario->m_marsClosestEvent) ) numDiffer++;
+		}
+	}
+
+	int numHits = scenario->m_shipCache.m_numHits;
+	delete scenario;
+
+	note("%d edits, %d checked, %d differ, %d cache hits", numEdits, numChecked, numDiffer, numHits);
+	return (numDiffer == 0);
+}
+
+// The state transition matrix against finite differences: nudge each of the
+// start position and velocity in turn, propagate again, and see how far the
+// state at a later point moves. Then ask for the delta-v that moves the
+// arrival by 1000 km, and check it does.
+bool OBSelfTest::checkSTM()
+{
+	OBScenario *scenario = makeScenario();
+	Path *ship = new Path();
+	FGDoubleVector pos, vel;
+	pos.setXY(-1.5e8, 0.0);
+	vel.setXY(0.0, 30.0);
+	ship->init(&scenario->m_sun, pos, vel, 0xffffff, 5);
+	ship->m_cache = NULL;
+	addTestBurns(*ship);
+	ship->calcPoints();
+	ship->setTrackSTM(true);
+
+	const int pointIdx = 400;
+	double phi[16];
+	ship->ensureSTM(pointIdx);
+	ship->getSTM(0, pointIdx, phi);
+	double base[4] = { ship->m_points[pointIdx].m_fixX, ship->m_points[pointIdx].m_fixY,
+		ship->m_vels[pointIdx].m_fixX, ship->m_vels[pointIdx].m_fixY };
+
+	// a km for the positions, a mm/s for the velocities
+	double nudge[4] = { 1.0, 1.0, 1e-6, 1e-6 };
+	double worstRel = 0.0;
+	for ( int k=0 ; k<4 ; k++ )
+	{
+		FGDoubleVector nudgedPos, nudgedVel;
+		nudgedPos.setXY(pos.m_fixX + ((k == 0) ? nudge[k] : 0.0), pos.m_fixY + ((k == 1) ? nudge[k] : 0.0));
+		nudgedVel.setXY(vel.m_fixX + ((k == 2) ? nudge[k] : 0.0), vel.m_fixY + ((k == 3) ? nudge[k] : 0.0));
+		ship->m_startPos.set(nudgedPos);
+		ship->m_startVel.set(nudgedVel);
+		ship->calcPoints();
+
+		double state[4] = { ship->m_points[pointIdx].m_fixX, ship->m_points[pointIdx].m_fixY,
+			ship->m_vels[pointIdx].m_fixX, ship->m_vels[pointIdx].m_fixY };
+		for ( int r=0 ; r<4 ; r++ )
+		{
+			// entries that are next to nothing are all rounding in the differences
+			double expected = phi[r*4 + k];
+			if ( fabs(expected) < 1e-6 ) continue;
+
+			double rel = fabs((state[r] - base[r])/nudge[k] - expected)/fabs(expected);
+			if ( rel > worstRel ) worstRel = rel;
+		}
+	}
+
+	ship->m_startPos.set(pos);
+	ship->m_startVel.set(vel);
+	ship->calcPoints();
+	double dvX, dvY, dx, dy;
+	ship->getDeltaVForShift(300, pointIdx, 1000.0, 0.0, dvX, dvY);
+	ship->getArrivalShift(300, pointIdx, dvX, dvY, dx, dy);
+	double shiftErr = hypot(dx - 1000.0, dy);
+
+	delete ship;
+	delete scenario;
+
+	note("worst %g relative to finite differences, shift %g km out", worstRel, shiftErr);
+	return (worstRel < 1e-4) && (shiftErr < 1e-6);
+}
+
+// The integrator harness: the checked in golden runs load as they are, the
+// harness's 1 step a day Euler run is the path's own points, and fourth order
+// at 64 steps a day gets closer to the golden run than that does.
+bool OBSelfTest::checkHarness()
+{
+	IntegratorHarness *harness = new IntegratorHarness();
+	harness->init(SELFTEST_FIXTURE_DIR);
+
+	int numScenarios = harness->getNumScenarios();
+	int numMade = harness->getNumGoldenMade();
+	int numMismatched = 0;
+	int numWorse = 0;
+	for ( int i=0 ; i<numScenarios ; i++ )
+	{
+		if ( !harness->matchesPath(i) ) numMismatched++;
+		if ( harness->getArrivalErr(i, "rk4/double", 64) >= harness->getArrivalErr(i, "euler/double", 1) ) numWorse++;
+	}
+	delete harness;
+
+	note("%d scenarios, %d golden runs made, %d don't match their path, %d rk4 no better", numScenarios,
+		numMade, numMismatched, numWorse);
+	return (numMade == 0) && (numMismatched == 0) && (numWorse == 0);
+}
+
+// Thrust schedules from random acceleration points, some for a Path and some
+// for paths far longer than one. Packing and unpacking gives back the same
+// arcs with the thrust rounded to floats, and unpacking turns down a schedule
+// that's cut short or runs off the end of the path. Turning a schedule back in
+// to acceleration points and building again gives the same arcs exactly, and
+// a ship flown on those points goes exactly where the original one does.
+bool OBSelfTest::checkSchedule()
+{
+	OBScenario *scenario = makeScenario();
+	Path *ship = new Path();
+	Path *rebuilt = new Path();
+	ship->initNoAcc(&scenario->m_sun, scenario->m_ship.m_startPos, scenario->m_ship.m_startVel, 0xffffff, 5);
+	rebuilt->initNoAcc(&scenario->m_sun, scenario->m_ship.m_startPos, scenario->m_ship.m_startVel, 0xffffff, 5);
+	ship->m_cache = NULL;
+	rebuilt->m_cache = NULL;
+
+	const int numTrials = 60;
+	int numBad = 0;
+	int maxLastStep = 0;
+	for ( int t=0 ; t<numTrials ; t++ )
+	{
+		int lastStep = ((t & 1) == 0) ? PATH_NUM_POINTS-1 : PATH_NUM_POINTS + randomInt(20000);
+		if ( lastStep > maxLastStep ) maxLastStep = lastStep;
+
+		// up to 8 points, in order, with some doubled up on a step and some
+		// repeating the one before
+		AccelerationPointList points;
+		int numPoints = randomInt(9);
+		for ( int k=0 ; k<numPoints ; k++ )
+		{
+			AccelerationPoint *ap = new AccelerationPoint();
+			ap->m_pointIdx = randomInt(lastStep+1);
+			ap->m_type = (randomInt(5) == 0) ? ACCTYPE_REDIRECT : ACCTYPE_NORMAL;
+			if ( randomInt(9) == 0 ) ap->m_type = ACCTYPE_STOPTRACE;
+			ap->setAccel(0.7*(double)randomInt(4), 0.5*PATH_ACCELERATION*(double)randomInt(3));
+
+			AccelerationPointIter iter = points.begin();
+			while ( (iter != points.end()) && ((*iter)->m_pointIdx <= ap->m_pointIdx) ) iter++;
+			points.insert(iter, ap);
+			if ( randomInt(4) == 0 )
+			{
+				AccelerationPoint *same = new AccelerationPoint(*ap);
+				same->m_type = ACCTYPE_NORMAL;
+				if ( (randomInt(2) == 0) && (same->m_pointIdx < lastStep) ) same->m_pointIdx++;
+				points.insert(iter, same);
+			}
+		}
+
+		ThrustSchedule schedule;
+		schedule.build(points, lastStep);
+
+		// pack and unpack
+		std::vector<unsigned char> packed;
+		schedule.pack(packed);
+		ThrustSchedule unpacked;
+		int pos = 0;
+		if ( !unpacked.unpack(&packed[0], (int)packed.size(), pos, lastStep+1) || (pos != (int)packed.size()) ||
+			(unpacked.getNumArcs() != schedule.getNumArcs()) )
+		{
+			numBad++;
+		}
+		else
+		{
+			for ( int i=0 ; i<schedule.getNumArcs() ; i++ )
+			{
+				ThrustArc &a = schedule.getArc(i);
+				ThrustArc &b = unpacked.getArc(i);
+				if ( (a.m_start != b.m_start) || (a.m_end != b.m_end) || (a.m_type != b.m_type) ||
+					(a.m_bRedirect != b.m_bRedirect) || ((double)(float)a.m_angle != b.m_angle) ||
+					((double)(float)a.m_mag != b.m_mag) ) numBad++;
+			}
+		}
+		pos = 0;
+		if ( unpacked.unpack(&packed[0], (int)packed.size()-1, pos, lastStep+1) ) numBad++;
+		pos = 0;
+		if ( unpacked.unpack(&packed[0], (int)packed.size(), pos, lastStep) ) numBad++;
+
+		// back to acceleration points and built again
+		AccelerationPointList remade;
+		schedule.makeAccelerationPoints(remade);
+		ThrustSchedule again;
+		again.build(remade, lastStep);
+		if ( again.getNumArcs() != schedule.getNumArcs() )
+		{
+			numBad++;
+		}
+		else
+		{
+			for ( int i=0 ; i<schedule.getNumArcs() ; i++ )
+			{
+				ThrustArc &a = schedule.getArc(i);
+				ThrustArc &b = again.getArc(i);
+				if ( (a.m_start != b.m_start) || (a.m_end != b.m_end) || (a.m_type != b.m_type) ||
+					(a.m_bRedirect != b.m_bRedirect) || (a.m_angle != b.m_angle) || (a.m_mag != b.m_mag) ||
+					(a.m_rotX != b.m_rotX) || (a.m_rotY != b.m_rotY) ) numBad++;
+			}
+		}
+
+		// and flown, when it's for a Path. The paths take the points over.
+		if ( lastStep == PATH_NUM_POINTS-1 )
+		{
+			ship->m_accelerationPoints.swap(points);
+			rebuilt->m_accelerationPoints.swap(remade);
+			ship->calcPoints();
+			rebuilt->calcPoints();
+
+			int stopIdx = ship->getStopPoint();
+			if ( (rebuilt->getStopPoint() != stopIdx) || (rebuilt->m_haltIdx != ship->m_haltIdx) ) numBad++;
+			for ( int i=0 ; i<=stopIdx ; i++ )
+			{
+				FGDoubleVector &p = ship->getPoint(i);
+				FGDoubleVector &q = rebuilt->getPoint(i);
+				if ( (p.m_fixX != q.m_fixX) || (p.m_fixY != q.m_fixY) )
+				{
+					numBad++;
+					break;
+				}
+			}
+		}
+
+		for ( AccelerationPointIter iter = points.begin() ; iter != points.end() ; iter++ ) delete *iter;
+		for ( AccelerationPointIter iter = remade.begin() ; iter != remade.end() ; iter++ ) delete *iter;
+	}
+
+	// paths don't own their points
+	for ( AccelerationPointIter iter = ship->m_accelerationPoints.begin() ; iter != ship->m_accelerationPoints.end() ; iter++ ) delete *iter;
+	for ( AccelerationPointIter iter = rebuilt->m_accelerationPoints.begin() ; iter != rebuilt->m_accelerationPoints.end() ; iter++ ) delete *iter;
+	delete ship;
+	delete rebuilt;
+	delete scenario;
+
+	note("%d schedules, up to %d steps, %d bad", numTrials, maxLastStep+1, numBad);
+	return (numBad == 0);
+}
+
+// a thread of the trajectory API check: its own context, the same batch a few times over
+static void runTrajThread(const traj_batch_in *in, double *outPoints, double *outClosestDist)
+{
+	traj_context *ctx = traj_create();
+	traj_batch_out out;
+	memset(&out, 0, sizeof(out));
+	out.points = outPoints;
+	out.closest_dist = outClosestDist;
+	for ( int i=0 ; i<5 ; i++ )
+	{
+		traj_propagate_batch(ctx, in, &out);
+	}
+	traj_destroy(ctx);
+}
+
+// A batch through the trajectory API against the app's own ship and events,
+// bit for bit. Then the same batch again on the same context, the batch with a
+// bad scenario in it, and the batch on several threads at once, each with its
+// own context. All of those have to give exactly the first results.
+bool OBSelfTest::checkTrajectoryAPI()
+{
+	const int count = SELFTEST_TRAJ_BATCH;
+	OBScenario *scenario = makeScenario();
+	Path &ship = scenario->m_ship;
+	Path &mars = scenario->m_marsPath;
+
+	// each scenario a little faster than the last, with a burn that cuts off later,
+	// and every fourth with a redirect and a stop trace
+	double shipPosX[count], shipPosY[count], shipVelX[count], shipVelY[count];
+	double marsPosX[count], marsPosY[count], marsVelX[count], marsVelY[count];
+	int accelFirst[count+1];
+	int accelStep[count*4], accelType[count*4];
+	double accelAngle[count*4], accelMag[count*4];
+	int numAccels = 0;
+	for ( int i=0 ; i<count ; i++ )
+	{
+		shipPosX[i] = ship.m_startPos.m_fixX;
+		shipPosY[i] = ship.m_startPos.m_fixY;
+		shipVelX[i] = ship.m_startVel.m_fixX*(1.0 + 0.002*(double)i);
+		shipVelY[i] = ship.m_startVel.m_fixY;
+		marsPosX[i] = mars.m_startPos.m_fixX;
+		marsPosY[i] = mars.m_startPos.m_fixY;
+		marsVelX[i] = mars.m_startVel.m_fixX;
+		marsVelY[i] = mars.m_startVel.m_fixY;
+
+		accelFirst[i] = numAccels;
+		accelStep[numAccels] = 0;
+		accelType[numAccels] = TRAJ_ACCEL_NORMAL;
+		accelAngle[numAccels] = 0.5*M_PI;
+		accelMag[numAccels] = PATH_ACCELERATION;
+		numAccels++;
+		accelStep[numAccels] = 20 + i;
+		accelType[numAccels] = TRAJ_ACCEL_NORMAL;
+		accelAngle[numAccels] = 0.0;
+		accelMag[numAccels] = 0.0;
+		numAccels++;
+		if ( (i % 4) == 3 )
+		{
+			accelStep[numAccels] = 300;
+			accelType[numAccels] = TRAJ_ACCEL_REDIRECT;
+			accelAngle[numAccels] = 2.0;
+			accelMag[numAccels] = 0.5*PATH_ACCELERATION;
+			numAccels++;
+			accelStep[numAccels] = 500;
+			accelType[numAccels] = TRAJ_ACCEL_STOPTRACE;
+			accelAngle[numAccels] = 0.0;
+			accelMag[numAccels] = 0.0;
+			numAccels++;
+		}
+	}
+	accelFirst[count] = numAccels;
+
+	traj_batch_in in;
+	memset(&in, 0, sizeof(in));
+	in.count = count;
+	in.ship_pos_x = shipPosX;
+	in.ship_pos_y = shipPosY;
+	in.ship_vel_x = shipVelX;
+	in.ship_vel_y = shipVelY;
+	in.mars_pos_x = marsPosX;
+	in.mars_pos_y = marsPosY;
+	in.mars_vel_x = marsVelX;
+	in.mars_vel_y = marsVelY;
+	in.accel_first = accelFirst;
+	in.accel_step = accelStep;
+	in.accel_type = accelType;
+	in.accel_angle = accelAngle;
+	in.accel_mag = accelMag;
+
+	// only the points up to a stop trace get written, so clear the rest for comparing
+	const int pointsSize = count*TRAJ_NUM_POINTS*2;
+	double *points = new double[pointsSize];
+	memset(points, 0, pointsSize*sizeof(double));
+	int status[count], numPoints[count], haltIdx[count], soiFired[count];
+	double soiTime[count], closestDist[count], closestTime[count];
+	traj_batch_out out;
+	memset(&out, 0, sizeof(out));
+	out.points = points;
+	out.status = status;
+	out.num_points = numPoints;
+	out.halt_idx = haltIdx;
+	out.soi_fired = soiFired;
+	out.soi_time = soiTime;
+	out.closest_dist = closestDist;
+	out.closest_time = closestTime;
+
+	traj_context *ctx = traj_create();
+	int numOK = traj_propagate_batch(ctx, &in, &out);
+
+	// the app's ship, given each scenario in turn
+	int numDiffer = 0;
+	for ( int i=0 ; i<count ; i++ )
+	{
+		for ( AccelerationPointIter iter = ship.m_accelerationPoints.begin() ; iter != ship.m_accelerationPoints.end() ; iter++ ) delete *iter;
+		ship.m_accelerationPoints.clear();
+		for ( int j=accelFirst[i] ; j<accelFirst[i+1] ; j++ )
+		{
+			AccelerationPoint *ap = new AccelerationPoint();
+			ap->m_pointIdx = accelStep[j];
+			ap->m_type = accelType[j];
+			ap->setAccel(accelAngle[j], accelMag[j]);
+			ship.m_accelerationPoints.push_back(ap);
+		}
+		ship.m_startVel.setXY(shipVelX[i], shipVelY[i]);
+		ship.calcPoints();
+
+		bool bSame = (status[i] == TRAJ_STATUS_OK) && (numPoints[i] == ship.getStopPoint()+1) &&
+			(haltIdx[i] == ship.m_haltIdx) && (soiFired[i] == (scenario->m_marsSOIEvent->m_bFired ? 1 : 0)) &&
+			(closestDist[i] == scenario->m_marsClosestEvent->m_dist) && (closestTime[i] == scenario->m_marsClosestEvent->m_time);
+		if ( bSame && (soiFired[i] != 0) && (soiTime[i] != scenario->m_marsSOIEvent->m_time) ) bSame = false;
+		for ( int p=0 ; bSame && (p<numPoints[i]) ; p++ )
+		{
+			double *point = &points[(i*TRAJ_NUM_POINTS + p)*2];
+			if ( (point[0] != ship.getPoint(p).m_fixX) || (point[1] != ship.getPoint(p).m_fixY) ) bSame = false;
+		}
+		if ( !bSame ) numDiffer++;
+	}
+
+	// the same again
+	double *again = new double[pointsSize];
+	memset(again, 0, pointsSize*sizeof(double));
+	double againClosestDist[count];
+	out.points = again;
+	out.closest_dist = againClosestDist;
+	traj_propagate_batch(ctx, &in, &out);
+	bool bAgainSame = (memcmp(again, points, pointsSize*sizeof(double)) == 0) &&
+		(memcmp(againClosestDist, closestDist, sizeof(closestDist)) == 0);
+
+	// two points on the same step is bad input, for that scenario only
+	accelStep[1] = 0;
+	int numOKWithBad = traj_propagate_batch(ctx, &in, &out);
+	bool bBadCaught = (numOKWithBad == count-1) && (status[0] == TRAJ_STATUS_BAD_INPUT) && (status[1] == TRAJ_STATUS_OK);
+	accelStep[1] = 20;
+	traj_destroy(ctx);
+
+	// threads, all at once
+	double *threadPoints[SELFTEST_TRAJ_THREADS];
+	double threadClosestDist[SELFTEST_TRAJ_THREADS][count];
+	std::thread threads[SELFTEST_TRAJ_THREADS];
+	for ( int t=0 ; t<SELFTEST_TRAJ_THREADS ; t++ )
+	{
+		threadPoints[t] = new double[pointsSize];
+		memset(threadPoints[t], 0, pointsSize*sizeof(double));
+		threads[t] = std::thread(runTrajThread, &in, threadPoints[t], threadClosestDist[t]);
+	}
+	int numThreadsDiffer = 0;
+	for ( int t=0 ; t<SELFTEST_TRAJ_THREADS ; t++ )
+	{
+		threads[t].join();
+		if ( (memcmp(threadPoints[t], points, pointsSize*sizeof(double)) != 0) ||
+			(memcmp(threadClosestDist[t], closestDist, sizeof(closestDist)) != 0) ) numThreadsDiffer++;
+		delete[] threadPoints[t];
+	}
+
+	for ( AccelerationPointIter iter = ship.m_accelerationPoints.begin() ; iter != ship.m_accelerationPoints.end() ; iter++ ) delete *iter;
+	ship.m_accelerationPoints.clear();
+	delete[] points;
+	delete[] again;
+	delete scenario;
+
+	note("%d of %d ok, %d differ from the app, again %s, bad input %s, %d threads differ", numOK, count, numDiffer,
+		bAgainSame ? "same" : "DIFFERENT", bBadCaught ? "caught" : "MISSED", numThreadsDiffer);
+	return (numOK == count) && (numDiffer == 0) && bAgainSame && bBadCaught && (numThreadsDiffer == 0);
+}
+
+// CompactPath on the earth, the ship with its burns, and a random walk a long
+// way out, at a few quanta. Every point is within half a quantum on each axis,
+// decoding a run gives the same as getting the points one by one, and a
+// quantum that isn't positive is turned down.
+bool OBSelfTest::checkCompactPath()
+{
+	OBScenario *scenario = makeScenario();
+	addTestBurns(scenario->m_ship);
+	scenario->m_ship.calcPoints();
+
+	double *x = new double[PATH_NUM_POINTS];
+	double *y = new double[PATH_NUM_POINTS];
+	double *decodedX = new double[PATH_NUM_POINTS];
+	double *decodedY = new double[PATH_NUM_POINTS];
+	double quanta[3] = { COMPACTPATH_DEFAULT_QUANTUM, 0.01, 37.5 };
+
+	int numBad = 0;
+	double worstRatio = 0.0;
+	int totalBytes = 0;
+	int totalPoints = 0;
+	for ( int source=0 ; source<3 ; source++ )
+	{
+		int count = PATH_NUM_POINTS;
+		if ( source < 2 )
+		{
+			Path &path = (source == 0) ? scenario->m_earthPath : scenario->m_ship;
+			count = path.getStopPoint()+1;
+			for ( int i=0 ; i<count ; i++ )
+			{
+				x[i] = path.getPoint(i).m_fixX;
+				y[i] = path.getPoint(i).m_fixY;
+			}
+		}
+		else
+		{
+			x[0] = 4.0e9;
+			y[0] = -4.0e9;
+			for ( int i=1 ; i<count ; i++ )
+			{
+				x[i] = x[i-1] + randomDouble(-5.0e5, 5.0e5);
+				y[i] = y[i-1] + randomDouble(-5.0e5, 5.0e5);
+			}
+		}
+
+		for ( int q=0 ; q<3 ; q++ )
+		{
+			CompactPath compact;
+			if ( !compact.encode(x, y, count, quanta[q]) || (compact.getNumPoints() != count) )
+			{
+				numBad++;
+				continue;
+			}
+			totalBytes += compact.getMemorySize();
+			totalPoints += count;
+
+			compact.decode(0, count, decodedX, decodedY);
+			for ( int i=0 ; i<count ; i++ )
+			{
+				double px, py;
+				compact.getPoint(i, px, py);
+				if ( (px != decodedX[i]) || (py != decodedY[i]) ) numBad++;
+
+				double ratio = fmax(fabs(px - x[i]), fabs(py - y[i]))/quanta[q];
+				if ( ratio > worstRatio ) worstRatio = ratio;
+			}
+
+			// a run from part way through a block
+			int first = randomInt(count);
+			int runCount = randomInt(count - first) + 1;
+			compact.decode(first, runCount, decodedX, decodedY);
+			for ( int i=0 ; i<runCount ; i++ )
+			{
+				double px, py;
+				compact.getPoint(first + i, px, py);
+				if ( (px != decodedX[i]) || (py != decodedY[i]) ) numBad++;
+			}
+		}
+	}
+
+	// no quantum, a negative one, and not a number
+	double badQuanta[3] = { 0.0, -1.0, sqrt(-1.0) };
+	for ( int q=0 ; q<3 ; q++ )
+	{
+		CompactPath compact;
+		if ( compact.encode(x, y, PATH_NUM_POINTS, badQuanta[q]) || (compact.getNumPoints() != 0) ) numBad++;
+	}
+
+	delete[] x;
+	delete[] y;
+	delete[] decodedX;
+	delete[] decodedY;
+	delete scenario;
+
+	note("%d bad, worst axis off by %.6f of a quantum, %.2f bytes a point", numBad, worstRatio,
+		(double)totalBytes/(double)totalPoints);
+	return (numBad == 0) && (worstRatio <= 0.5);
+}
+
+void OBSelfTest::copyAccelerationPoints(Path &path, MissionPath &mission)
+{
+	for ( AccelerationPointIter iter = path.m_accelerationPoints.begin() ; iter != path.m_accelerationPoints.end() ; iter++ )
+	{
+		mission.m_accelerationPoints.push_back(new AccelerationPoint(**iter));
+	}
+}
+
+// count random points where the mission paths don't all agree
+int OBSelfTest::countMissionMismatches(MissionPath **paths, int numPaths, int numSamples)
+{
+	int numMismatched = 0;
+	for ( int k=0 ; k<numSamples ; k++ )
+	{
+		int pointIdx = randomInt(paths[0]->getNumPoints());
+		double x0, y0;
+		paths[0]->getPoint(pointIdx, x0, y0);
+		for ( int p=1 ; p<numPaths ; p++ )
+		{
+			double x, y;
+			paths[p]->getPoint(pointIdx, x, y);
+			if ( (x != x0) || (y != y0) )
+			{
+				numMismatched++;
+				break;
+			}
+		}
+	}
+	return numMismatched;
+}
+
+// MissionPath against Path over the first 900 points, bit for bit, velocities
+// and all. Then 30 years of it three ways: all in memory, only a couple of
+// blocks in memory and the rest dropped, and a couple in memory and the rest
+// spilled to the scratch directory. Points picked at random have to agree,
+// and still agree after a burn is put in part way along.
+bool OBSelfTest::checkMissionPath()
+{
+	OBScenario *scenario = makeScenario();
+	Path &ship = scenario->m_ship;
+	addTestBurns(ship);
+	ship.calcPoints();
+
+	// a Path's worth
+	MissionPath *mission = new MissionPath();
+	mission->init(ship.m_orbitee, ship.m_startPos, ship.m_startVel, PATH_NUM_POINTS);
+	copyAccelerationPoints(ship, *mission);
+	mission->invalidateFrom(0);
+	int numDiffer = 0;
+	for ( int i=0 ; i<PATH_NUM_POINTS ; i++ )
+	{
+		double x, y, vx, vy;
+		mission->getPoint(i, x, y);
+		mission->getVel(i, vx, vy);
+		if ( (x != ship.m_points[i].m_fixX) || (y != ship.m_points[i].m_fixY) ||
+			(vx != ship.m_vels[i].m_fixX) || (vy != ship.m_vels[i].m_fixY) ) numDiffer++;
+	}
+	if ( mission->m_haltIdx != ship.m_haltIdx ) numDiffer++;
+	delete mission;
+
+	// 30 years, three ways
+	char spillFilename[1100];
+	snprintf(spillFilename, sizeof(spillFilename), "%s/mission_spill.dat", m_scratchDir);
+	MissionPath *paths[3];
+	for ( int p=0 ; p<3 ; p++ )
+	{
+		paths[p] = new MissionPath();
+		paths[p]->init(ship.m_orbitee, ship.m_startPos, ship.m_startVel, SELFTEST_MISSION_POINTS);
+		copyAccelerationPoints(ship, *paths[p]);
+		paths[p]->invalidateFrom(0);
+		paths[p]->setMaxResidentBlocks((p == 0) ? SELFTEST_MISSION_POINTS/MISSIONPATH_BLOCK_POINTS + 1 : SELFTEST_MISSION_RESIDENT);
+	}
+	bool bSpilled = paths[2]->setSpillFile(spillFilename);
+#ifdef _WIN32
+	bool bSpillOK = true; // there's no spilling on windows, so the third one drops too
+#else
+	bool bSpillOK = bSpilled;
+#endif
+	for ( int p=0 ; p<3 ; p++ )
+	{
+		paths[p]->ensurePoints(SELFTEST_MISSION_POINTS-1);
+	}
+	int maxResident = (paths[1]->getNumResidentBlocks() > paths[2]->getNumResidentBlocks()) ?
+		paths[1]->getNumResidentBlocks() : paths[2]->getNumResidentBlocks();
+
+	int numMismatched = countMissionMismatches(paths, 3, 20000);
+
+	// a burn part way along, on all of them
+	for ( int p=0 ; p<3 ; p++ )
+	{
+		AccelerationPoint *ap = new AccelerationPoint();
+		ap->m_pointIdx = 3000;
+		ap->setAccel(2.0, PATH_ACCELERATION);
+		paths[p]->m_accelerationPoints.push_back(ap);
+		ap = new AccelerationPoint();
+		ap->m_pointIdx = 3100;
+		ap->setAccel(0.0, 0.0);
+		paths[p]->m_accelerationPoints.push_back(ap);
+		paths[p]->invalidateFrom(3000);
+	}
+	int numEditMismatched = countMissionMismatches(paths, 3, 20000);
+
+	for ( int p=0 ; p<3 ; p++ )
+	{
+		delete paths[p];
+	}
+	delete scenario;
+
+	note("%d of 900 differ from Path, %d and %d of 20000 differ in %d years (%d resident, %s)", numDiffer,
+		numMismatched, numEditMismatched, SELFTEST_MISSION_POINTS/365, maxResident, bSpilled ? "spilled" : "no spill file");
+	return (numDiffer == 0) && (numMismatched == 0) && (numEditMismatched == 0) && bSpillOK &&
+		(maxResident <= SELFTEST_MISSION_RESIDENT);
+}
+
+#ifndef _WIN32
+// the whole of a file, or nothing if it can't be read
+static void readWholeFile(const char *filename, std::vector<unsigned char> &out)
+{
+	out.clear();
+	FILE *f = fopen(filename, "rb");
+	if ( f == NULL ) return;
+
+	unsigned char buffer[4096];
+	size_t numRead;
+	while ( (numRead = fread(buffer, 1, sizeof(buffer), f)) > 0 )
+	{
+		out.insert(out.end(), buffer, buffer + numRead);
+	}
+	fclose(f);
+}
+
+// A small sweep in the scratch directory, run as 1, 3 and 7 shards. The merged
+// files have to be the same byte for byte. Then a shard is cut off part way
+// through a record, the way a killed run leaves it, and running it again has
+// to pick up and finish with the same merged file.
+bool OBSelfTest::checkSweep()
+{
+	char dir[1024];
+	char filename[1100];
+	snprintf(dir, sizeof(dir), "%s/sweep", m_scratchDir);
+	mkdir(dir, 0777);
+
+	snprintf(filename, sizeof(filename), "%s/spec.txt", dir);
+	FILE *f = fopen(filename, "w");
+	if ( f == NULL )
+	{
+		note("couldn't write %s", filename);
+		return false;
+	}
+	fputs(SELFTEST_SWEEP_SPEC, f);
+	fclose(f);
+
+	Sweep *sweep = new Sweep();
+	if ( !sweep->init(filename) )
+	{
+		delete sweep;
+		note("couldn't read %s", filename);
+		return false;
+	}
+
+	// a shard from an earlier run would just be picked up, so clear them out first
+	int shardCounts[3] = { 1, 3, 7 };
+	std::vector<unsigned char> merged[3];
+	bool bRan = true;
+	for ( int n=0 ; n<3 ; n++ )
+	{
+		int numShards = shardCounts[n];
+		for ( int k=0 ; k<numShards ; k++ )
+		{
+			snprintf(filename, sizeof(filename), "%s/shard_%d_of_%d.dat", dir, k, numShards);
+			remove(filename);
+			if ( !sweep->runShard(dir, k, numShards, 2) ) bRan = false;
+		}
+		snprintf(filename, sizeof(filename), "%s/merged_%d.dat", dir, numShards);
+		if ( !sweep->merge(dir, numShards, filename) ) bRan = false;
+		readWholeFile(filename, merged[n]);
+	}
+	bool bSame = !merged[0].empty() && (merged[1] == merged[0]) && (merged[2] == merged[0]);
+
+	// cut the middle of the 3 shards off part way through its 41st record
+	snprintf(filename, sizeof(filename), "%s/shard_1_of_3.dat", dir);
+	if ( truncate(filename, SWEEP_HEADER_SIZE + 40*SWEEP_RECORD_SIZE + SWEEP_RECORD_SIZE/2) != 0 ) bRan = false;
+	if ( !sweep->runShard(dir, 1, 3, 1) ) bRan = false;
+	snprintf(filename, sizeof(filename), "%s/merged_resumed.dat", dir);
+	if ( !sweep->merge(dir, 3, filename) ) bRan = false;
+	std::vector<unsigned char> resumed;
+	readWholeFile(filename, resumed);
+	bool bResumedSame = (resumed == merged[0]);
+
+	long long numAllCells = (long long)(merged[0].size() - SWEEP_HEADER_SIZE)/SWEEP_RECORD_SIZE;
+	delete sweep;
+
+	note("%lld cells, %s, shards %s, resumed %s", numAllCells, bRan ? "ran" : "DIDN'T RUN",
+		bSame ? "same" : "DIFFERENT", bResumedSame ? "same" : "DIFFERENT");
+	return bRan && bSame && bResumedSame;
+}
+#endif
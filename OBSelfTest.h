@@ -0,0 +1,91 @@
+
+#ifndef __OBSELFTEST__
+#define __OBSELFTEST__
+
+class OBSelfTest;
+class OBScenario;
+class Path;
+class PathEvent;
+class MissionPath;
+
+// a check is a member that says whether it passed
+typedef bool (OBSelfTest::*SelfTestFunc)();
+
+class SelfTestCheck
+{
+public:
+	const char *m_name;
+	SelfTestFunc m_run;
+};
+
+// Checks that the core still does what it says it does: results that should
+// match bit for bit do, round trips come back, fast paths agree with slow ones.
+// Random inputs come from a fixed seed, so every run is the same. Each check
+// prints one line, and any of them can be run on their own by name.
+class OBSelfTest
+{
+public:
+	OBSelfTest();
+	~OBSelfTest();
+
+	// run the checks whose names start with filter (all of them if it's NULL),
+	// with scratchDir for any files they need. Returns how many failed.
+	int run(const char *filter, const char *scratchDir);
+
+private:
+	static SelfTestCheck s_checks[];
+
+	// the checks
+	bool checkPointGrid();
+	bool checkKernelOutputs();
+	bool checkEvents();
+	bool checkLambert();
+	bool checkEdits();
+	bool checkSTM();
+	bool checkHarness();
+	bool checkSchedule();
+	bool checkTrajectoryAPI();
+#ifndef _WIN32
+	bool checkSweep();
+#endif
+	bool checkCompactPath();
+	bool checkMissionPath();
+
+	// the app's starting scenario, ready to go. The caller deletes it.
+	OBScenario *makeScenario();
+
+	// give a path a burn, a cutoff, a redirect and another cutoff, so
+	// every kind of step gets run
+	void addTestBurns(Path &path);
+
+	// whether path's points and event are exactly what a new path given the
+	// same inputs works out from scratch
+	bool matchesFresh(Path &path, PathEvent *event);
+
+	// give a mission path copies of a path's acceleration points
+	void copyAccelerationPoints(Path &path, MissionPath &mission);
+
+	// how many of numSamples random points aren't the same on all the paths
+	int countMissionMismatches(MissionPath **paths, int numPaths, int numSamples);
+
+	// walk the straight lines between points 0 and lastIdx in small steps, the
+	// slow way of finding what an event should. Distances are from target's
+	// points, or from 0,0 if it's NULL. Gives the closest approach, and when the
+	// path first comes within radius (-1 if it never does).
+	void sampleSegments(Path &path, Path *target, int lastIdx, double radius,
+		double &outMinDist, double &outMinTime, double &outEntryTime);
+
+	// a small generator of our own, so the inputs are the same everywhere
+	void seed(unsigned int seed) { m_random = seed; }
+	int randomInt(int n); // 0 to n-1
+	double randomDouble(double lo, double hi);
+
+	// what the current check found, printed after its result
+	void note(const char *format, ...);
+
+	const char *m_scratchDir;
+	unsigned int m_random;
+	char m_note[256];
+};
+
+#endif
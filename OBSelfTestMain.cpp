@@ -0,0 +1,18 @@
+
+#include "OBSelfTest.h"
+#include <stdio.h>
+
+// usage: ob-selftest [check name, or the start of some] [scratch directory]
+// Exits with 1 if anything failed.
+int main(int argc, char **argv)
+{
+	const char *filter = NULL;
+	if ( argc > 1 ) filter = argv[1];
+
+	const char *scratchDir = ".";
+	if ( argc > 2 ) scratchDir = argv[2];
+
+	OBSelfTest selfTest;
+	int numFailed = selfTest.run(filter, scratchDir);
+	return (numFailed == 0) ? 0 : 1;
+}
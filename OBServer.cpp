@@ -0,0 +1,550 @@
+
+#ifndef _WIN32
+
+#include "OBServer.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <signal.h>
+#include <chrono>
+
+// a client hanging up mustn't kill the server with SIGPIPE. Linux has a send flag
+// for that, mac and the BSDs a socket option, and anywhere else start() ignores the signal.
+#ifdef MSG_NOSIGNAL
+#define OBSERVER_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define OBSERVER_SEND_FLAGS 0
+#endif
+
+static long long steadyMS()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+OBServer::OBServer()
+{
+	m_listenFD = -1;
+	m_wakePipe[0] = -1;
+	m_wakePipe[1] = -1;
+	m_bRunning = false;
+	m_acceptRetryTime = 0;
+	m_bInRun = false;
+}
+
+OBServer::~OBServer()
+{
+	stop();
+}
+
+bool OBServer::start(const char *socketPath, int numThreads)
+{
+	struct sockaddr_un addr;
+	if ( strlen(socketPath) >= sizeof(addr.sun_path) ) return false;
+
+	m_listenFD = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ( m_listenFD == -1 ) return false;
+
+	// clear out a socket left over from an earlier run
+	unlink(socketPath);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socketPath);
+	if ( (bind(m_listenFD, (struct sockaddr *)&addr, sizeof(addr)) == -1) ||
+		(listen(m_listenFD, OBSERVER_LISTEN_BACKLOG) == -1) )
+	{
+		close(m_listenFD);
+		m_listenFD = -1;
+		return false;
+	}
+
+	// the workers and stop() wake run() with this. Neither end blocks: if it's
+	// full, run() is going to wake anyway.
+	if ( pipe(m_wakePipe) == -1 )
+	{
+		m_wakePipe[0] = -1;
+		m_wakePipe[1] = -1;
+		close(m_listenFD);
+		m_listenFD = -1;
+		return false;
+	}
+	fcntl(m_wakePipe[0], F_SETFL, fcntl(m_wakePipe[0], F_GETFL) | O_NONBLOCK);
+	fcntl(m_wakePipe[1], F_SETFL, fcntl(m_wakePipe[1], F_GETFL) | O_NONBLOCK);
+
+#if !defined(MSG_NOSIGNAL) && !defined(SO_NOSIGPIPE)
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	// start the workers
+	if ( numThreads < 1 ) numThreads = 1;
+	m_bRunning = true;
+	m_acceptRetryTime = 0;
+	for ( int i=0 ; i<numThreads ; i++ )
+	{
+		m_workers.push_back(std::thread(&OBServer::workerMain, this));
+	}
+	return true;
+}
+
+void OBServer::run()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if ( !m_bRunning ) return;
+		m_bInRun = true;
+	}
+
+	std::vector<struct pollfd> fds;
+	while ( m_bRunning )
+	{
+		// the wake pipe, then the listening socket (unless we're backing off), then the idle connections
+		fds.clear();
+		struct pollfd pfd;
+		pfd.fd = m_wakePipe[0];
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		fds.push_back(pfd);
+
+		int timeout = -1;
+		bool bListening = true;
+		if ( m_acceptRetryTime != 0 )
+		{
+			long long wait = m_acceptRetryTime - steadyMS();
+			if ( wait > 0 )
+			{
+				bListening = false;
+				timeout = (int)wait;
+			}
+			else
+			{
+				m_acceptRetryTime = 0;
+			}
+		}
+		if ( bListening )
+		{
+			pfd.fd = m_listenFD;
+			fds.push_back(pfd);
+		}
+		int firstIdle = (int)fds.size();
+		for ( int i=0 ; i<(int)m_idleConnections.size() ; i++ )
+		{
+			pfd.fd = m_idleConnections[i];
+			fds.push_back(pfd);
+		}
+
+		if ( poll(&fds[0], fds.size(), timeout) == -1 )
+		{
+			if ( errno == EINTR ) continue;
+			break;
+		}
+		if ( !m_bRunning ) break;
+
+		// connections with a request (or a hangup) waiting go to the workers
+		bool bHandedOut = false;
+		int numKept = 0;
+		for ( int i=0 ; i<(int)m_idleConnections.size() ; i++ )
+		{
+			if ( fds[firstIdle+i].revents != 0 )
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_readyConnections.push_back(m_idleConnections[i]);
+				bHandedOut = true;
+			}
+			else
+			{
+				m_idleConnections[numKept++] = m_idleConnections[i];
+			}
+		}
+		m_idleConnections.resize(numKept);
+		if ( bHandedOut ) m_wake.notify_all();
+
+		// take back the connections the workers are done with
+		if ( fds[0].revents != 0 )
+		{
+			char drain[64];
+			while ( read(m_wakePipe[0], drain, sizeof(drain)) > 0 )
+			{
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for ( std::list<int>::iterator iter = m_returnedConnections.begin() ; iter != m_returnedConnections.end() ; iter++ )
+			{
+				m_idleConnections.push_back(*iter);
+			}
+			m_returnedConnections.clear();
+		}
+
+		if ( bListening && (fds[1].revents != 0) )
+		{
+			if ( !acceptConnection() ) break;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_bInRun = false;
+	m_runDone.notify_all();
+}
+
+bool OBServer::acceptConnection()
+{
+	int fd = accept(m_listenFD, NULL, NULL);
+	if ( fd == -1 )
+	{
+		switch ( errno )
+		{
+			case EINTR:
+			case EAGAIN:
+			case ECONNABORTED:
+				return true;
+
+			// out of fds or memory. Leave it a while, something may close.
+			case EMFILE:
+			case ENFILE:
+			case ENOBUFS:
+			case ENOMEM:
+				m_acceptRetryTime = steadyMS() + OBSERVER_ACCEPT_BACKOFF_MS;
+				return true;
+
+			// the listening socket has gone (or stop() shut it down)
+			default:
+				return false;
+		}
+	}
+
+	struct timeval tv;
+	tv.tv_sec = OBSERVER_READ_TIMEOUT_SECONDS;
+	tv.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if ( !m_bRunning )
+	{
+		close(fd);
+		return true;
+	}
+	m_liveConnections.insert(fd);
+	m_idleConnections.push_back(fd);
+	return true;
+}
+
+void OBServer::wakePoller()
+{
+	if ( m_wakePipe[1] == -1 ) return;
+	char c = 0;
+	if ( write(m_wakePipe[1], &c, 1) == -1 )
+	{
+		// full, so it's waking up anyway
+	}
+}
+
+void OBServer::closeConnection(int fd)
+{
+	// under the lock, so stop() can't shut down an fd that has been closed and reused
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_liveConnections.erase(fd);
+	close(fd);
+}
+
+void OBServer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bRunning = false;
+		m_wake.notify_all();
+
+		// hang up on everyone, so any worker waiting on a client gets out
+		for ( std::set<int>::iterator iter = m_liveConnections.begin() ; iter != m_liveConnections.end() ; iter++ )
+		{
+			shutdown(*iter, SHUT_RDWR);
+		}
+	}
+
+	// get run() out of poll, and wait for it to finish with the fds
+	if ( m_listenFD != -1 ) shutdown(m_listenFD, SHUT_RDWR);
+	wakePoller();
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while ( m_bInRun )
+		{
+			m_runDone.wait(lock);
+		}
+	}
+
+	for ( int i=0 ; i<(int)m_workers.size() ; i++ )
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+
+	// nobody else is using anything now
+	for ( std::set<int>::iterator iter = m_liveConnections.begin() ; iter != m_liveConnections.end() ; iter++ )
+	{
+		close(*iter);
+	}
+	m_liveConnections.clear();
+	m_idleConnections.clear();
+	m_readyConnections.clear();
+	m_returnedConnections.clear();
+
+	if ( m_listenFD != -1 )
+	{
+		close(m_listenFD);
+		m_listenFD = -1;
+	}
+	for ( int i=0 ; i<2 ; i++ )
+	{
+		if ( m_wakePipe[i] != -1 )
+		{
+			close(m_wakePipe[i]);
+			m_wakePipe[i] = -1;
+		}
+	}
+}
+
+void OBServer::workerMain()
+{
+	// every worker has its own bodies, paths and caches
+	OBScenario scenario;
+	scenario.init();
+
+	std::vector<unsigned char> request;
+	std::vector<unsigned char> response;
+	while ( true )
+	{
+		int fd;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while ( m_bRunning && m_readyConnections.empty() )
+			{
+				m_wake.wait(lock);
+			}
+			if ( !m_bRunning ) return;
+
+			fd = m_readyConnections.front();
+			m_readyConnections.pop_front();
+		}
+
+		// one request, then it goes back to run() to wait for the next
+		if ( !serveRequest(fd, scenario, request, response) )
+		{
+			closeConnection(fd);
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if ( !m_bRunning ) return; // stop() closes it
+			m_returnedConnections.push_back(fd);
+		}
+		wakePoller();
+	}
+}
+
+bool OBServer::serveRequest(int fd, OBScenario &scenario, std::vector<unsigned char> &request, std::vector<unsigned char> &response)
+{
+	// read the size, then the request
+	unsigned char sizeBytes[4];
+	if ( !readBytes(fd, sizeBytes, 4) ) return false;
+	int pos = 0;
+	int size;
+	readInt(sizeBytes, 4, pos, size);
+	if ( (size < 0) || (size > OBSERVER_MAX_REQUEST) ) return false;
+
+	request.resize(size);
+	if ( (size > 0) && !readBytes(fd, &request[0], size) ) return false;
+
+	// work it out
+	response.clear();
+	writeInt(response, 0); // room for the size
+	if ( !evaluate(scenario, request, response) )
+	{
+		response.clear();
+		writeInt(response, 0);
+		writeInt(response, OBSERVER_STATUS_BAD_REQUEST);
+	}
+
+	// fill in the size and send it
+	int responseSize = (int)response.size() - 4;
+	for ( int i=0 ; i<4 ; i++ )
+	{
+		response[i] = (unsigned char)((responseSize >> (i*8)) & 0xff);
+	}
+	return writeBytes(fd, &response[0], (int)response.size());
+}
+
+bool OBServer::evaluate(OBScenario &scenario, std::vector<unsigned char> &request, std::vector<unsigned char> &response)
+{
+	const unsigned char *data = request.empty() ? NULL : &request[0];
+	int size = (int)request.size();
+	int pos = 0;
+
+	// same order the app saves in
+	if ( !readPath(data, size, pos, scenario.m_earthPath) ) return false;
+	if ( !readPath(data, size, pos, scenario.m_marsPath) ) return false;
+	if ( !readPath(data, size, pos, scenario.m_ship) ) return false;
+	if ( pos != size ) return false;
+
+	scenario.m_earthPath.calcPoints();
+	scenario.m_marsPath.calcPoints();
+	scenario.m_ship.calcPoints();
+
+	Path &ship = scenario.m_ship;
+	PathEvent *soi = scenario.m_marsSOIEvent;
+	PathEvent *closest = scenario.m_marsClosestEvent;
+
+	int numPoints = ship.getStopPoint()+1;
+	writeInt(response, OBSERVER_STATUS_OK);
+	writeInt(response, numPoints);
+	writeInt(response, ship.m_haltIdx);
+	writeInt(response, soi->m_bFired ? 1 : 0);
+	writeDouble(response, soi->m_time);
+	writeDouble(response, closest->m_dist);
+	writeDouble(response, closest->m_time);
+	for ( int i=0 ; i<numPoints ; i++ )
+	{
+		writeDouble(response, ship.m_points[i].m_fixX);
+		writeDouble(response, ship.m_points[i].m_fixY);
+	}
+	return true;
+}
+
+bool OBServer::readPath(const unsigned char *data, int size, int &pos, Path &path)
+{
+	// this mirrors Path::load
+	double startX, startY, velX, velY;
+	if ( !readDouble(data, size, pos, startX) ) return false;
+	if ( !readDouble(data, size, pos, startY) ) return false;
+	if ( !readDouble(data, size, pos, velX) ) return false;
+	if ( !readDouble(data, size, pos, velY) ) return false;
+
+	int count;
+	if ( !readInt(data, size, pos, count) ) return false;
+	if ( (count < 0) || (count > PATH_NUM_POINTS) ) return false;
+
+	// check it all before touching the path
+	int start = pos;
+	int lastIdx = -1;
+	for ( int i=0 ; i<count ; i++ )
+	{
+		int pointIdx, type;
+		double angle, mag;
+		if ( !readInt(data, size, pos, pointIdx) ) return false;
+		if ( !readInt(data, size, pos, type) ) return false;
+		if ( !readDouble(data, size, pos, angle) ) return false;
+		if ( !readDouble(data, size, pos, mag) ) return false;
+
+		// the propagation needs them in order, and in range
+		if ( (pointIdx < 0) || (pointIdx >= PATH_NUM_POINTS) || (pointIdx <= lastIdx) ) return false;
+		if ( (type < ACCTYPE_NORMAL) || (type > ACCTYPE_STOPTRACE) ) return false;
+		lastIdx = pointIdx;
+	}
+
+	// good. Now fill it in.
+	path.m_startPos.setXY(startX, startY);
+	path.m_startVel.setXY(velX, velY);
+	for ( AccelerationPointIter iter = path.m_accelerationPoints.begin() ; iter != path.m_accelerationPoints.end() ; iter++ )
+	{
+		delete *iter;
+	}
+	path.m_accelerationPoints.clear();
+
+	pos = start;
+	for ( int i=0 ; i<count ; i++ )
+	{
+		AccelerationPoint *ap = new AccelerationPoint();
+		readInt(data, size, pos, ap->m_pointIdx);
+		readInt(data, size, pos, ap->m_type);
+		double angle = 0.0;
+		double mag = 0.0;
+		readDouble(data, size, pos, angle);
+		readDouble(data, size, pos, mag);
+		ap->setAccel(angle, mag);
+		path.m_accelerationPoints.push_back(ap);
+	}
+	return true;
+}
+
+bool OBServer::readBytes(int fd, unsigned char *buf, int count)
+{
+	int done = 0;
+	while ( done < count )
+	{
+		// a timeout (SO_RCVTIMEO) or a hangup ends the connection
+		int got = (int)recv(fd, buf+done, count-done, 0);
+		if ( (got == -1) && (errno == EINTR) ) continue;
+		if ( got <= 0 ) return false;
+		done += got;
+	}
+	return true;
+}
+
+bool OBServer::writeBytes(int fd, const unsigned char *buf, int count)
+{
+	int done = 0;
+	while ( done < count )
+	{
+		int sent = (int)send(fd, buf+done, count-done, OBSERVER_SEND_FLAGS);
+		if ( sent <= 0 ) return false;
+		done += sent;
+	}
+	return true;
+}
+
+bool OBServer::readInt(const unsigned char *data, int size, int &pos, int &out)
+{
+	if ( pos+4 > size ) return false;
+
+	unsigned int value = 0;
+	for ( int i=0 ; i<4 ; i++ )
+	{
+		value |= ((unsigned int)data[pos+i]) << (i*8);
+	}
+	out = (int)value;
+	pos += 4;
+	return true;
+}
+
+bool OBServer::readDouble(const unsigned char *data, int size, int &pos, double &out)
+{
+	if ( pos+8 > size ) return false;
+
+	unsigned long long bits = 0;
+	for ( int i=0 ; i<8 ; i++ )
+	{
+		bits |= ((unsigned long long)data[pos+i]) << (i*8);
+	}
+	memcpy(&out, &bits, 8);
+	pos += 8;
+	return true;
+}
+
+void OBServer::writeInt(std::vector<unsigned char> &out, int value)
+{
+	unsigned int bits = (unsigned int)value;
+	for ( int i=0 ; i<4 ; i++ )
+	{
+		out.push_back((unsigned char)((bits >> (i*8)) & 0xff));
+	}
+}
+
+void OBServer::writeDouble(std::vector<unsigned char> &out, double value)
+{
+	unsigned long long bits;
+	memcpy(&bits, &value, 8);
+	for ( int i=0 ; i<8 ; i++ )
+	{
+		out.push_back((unsigned char)((bits >> (i*8)) & 0xff));
+	}
+}
+
+#endif
@@ -0,0 +1,117 @@
+
+#ifndef __OBSERVER__
+#define __OBSERVER__
+
+// the server talks over a Unix domain socket, so it's not built on windows
+#ifndef _WIN32
+
+#include "OBScenario.h"
+#include <list>
+#include <set>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// the biggest request we'll accept, in bytes
+#define OBSERVER_MAX_REQUEST (1024*1024)
+
+// how many connections can wait to be accepted
+#define OBSERVER_LISTEN_BACKLOG 64
+
+// how long a worker waits on a request that has started arriving, so a client
+// that stalls half way through can't hold a worker forever
+#define OBSERVER_READ_TIMEOUT_SECONDS 10
+
+// how long we leave the listening socket alone after accept fails for lack of
+// resources (like running out of fds), rather than spinning on it
+#define OBSERVER_ACCEPT_BACKOFF_MS 100
+
+// response status codes
+#define OBSERVER_STATUS_OK 0
+#define OBSERVER_STATUS_BAD_REQUEST 1
+
+// A long-lived local server that propagates trajectories for scripts, so they
+// don't have to link the app or start a process per run.
+//
+// Each message, both ways, is a 32 bit byte count followed by that many bytes.
+// Ints are 32 bit and doubles are 64 bit, little endian and unpadded, the same
+// way FGDataWriter writes them.
+//
+// A request is a save file: the earth path, the mars path and the ship, each in
+// the Path::save layout. The response is:
+//   int    status (an OBSERVER_STATUS_XXXX constant. Nothing follows if it isn't OK)
+//   int    number of points
+//   int    halt point, or -1
+//   int    1 if the ship reached mars's sphere of influence, otherwise 0
+//   double time it entered mars's sphere of influence, in seconds
+//   double closest distance to mars, in km
+//   double time of the closest approach, in seconds
+//   then x, y as doubles for each point
+//
+// A connection can send any number of requests. run() polls every idle
+// connection, and each request that arrives is handed to a pool of worker
+// threads, each with its own scenario and caches, so workers never share state
+// and stay warm across requests. A worker only holds a connection for one request,
+// so any number of clients can share the workers.
+class OBServer
+{
+public:
+	OBServer();
+	~OBServer();
+
+	// start listening on socketPath with numThreads workers. Returns false on failure.
+	bool start(const char *socketPath, int numThreads);
+
+	// accept connections and hand out their requests until stop() is called
+	void run();
+
+	// can be called from another thread while run() is going. Any clients still
+	// connected are hung up on.
+	void stop();
+
+private:
+	void workerMain();
+	void wakePoller();
+	void closeConnection(int fd);
+	bool acceptConnection(); // false if the listening socket is no good any more
+
+	// read one request from fd and answer it. Returns false if the connection is done.
+	bool serveRequest(int fd, OBScenario &scenario, std::vector<unsigned char> &request, std::vector<unsigned char> &response);
+
+	// evaluate one request in to response. Returns false if the request was bad.
+	bool evaluate(OBScenario &scenario, std::vector<unsigned char> &request, std::vector<unsigned char> &response);
+	bool readPath(const unsigned char *data, int size, int &pos, Path &path);
+
+	// byte helpers
+	static bool readBytes(int fd, unsigned char *buf, int count);
+	static bool writeBytes(int fd, const unsigned char *buf, int count);
+	static bool readInt(const unsigned char *data, int size, int &pos, int &out);
+	static bool readDouble(const unsigned char *data, int size, int &pos, double &out);
+	static void writeInt(std::vector<unsigned char> &out, int value);
+	static void writeDouble(std::vector<unsigned char> &out, double value);
+
+	int m_listenFD;
+	int m_wakePipe[2]; // a byte down here gets run() out of poll
+	std::atomic<bool> m_bRunning;
+
+	// connections waiting for their next request. Only run() touches these.
+	std::vector<int> m_idleConnections;
+	long long m_acceptRetryTime; // ms on the steady clock. Don't accept before this.
+
+	// workers, the connections with a request waiting for one, and the connections
+	// they're done with, waiting to go back to run()
+	std::vector<std::thread> m_workers;
+	std::list<int> m_readyConnections;
+	std::list<int> m_returnedConnections;
+	std::set<int> m_liveConnections; // every open client fd, so stop() can hang up on them
+	bool m_bInRun;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_runDone;
+};
+
+#endif
+
+#endif
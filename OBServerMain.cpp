@@ -0,0 +1,33 @@
+
+#ifndef _WIN32
+
+#include "OBServer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+#define DEFAULT_SOCKET_PATH "/tmp/trajectory.sock"
+
+// usage: trajectory-server [socket path] [number of threads]
+int main(int argc, char **argv)
+{
+	const char *socketPath = DEFAULT_SOCKET_PATH;
+	if ( argc > 1 ) socketPath = argv[1];
+
+	int numThreads = (int)std::thread::hardware_concurrency();
+	if ( argc > 2 ) numThreads = atoi(argv[2]);
+	if ( numThreads < 1 ) numThreads = 1;
+
+	OBServer server;
+	if ( !server.start(socketPath, numThreads) )
+	{
+		fprintf(stderr, "Couldn't listen on %s\n", socketPath);
+		return 1;
+	}
+
+	printf("Listening on %s with %d threads\n", socketPath, numThreads);
+	server.run();
+	return 0;
+}
+
+#endif
@@ -0,0 +1,40 @@
+
+#include "OBView.h"
+#include <math.h>
+
+OBView::OBView()
+{
+	m_center.setXY(0.0, 0.0);
+	m_kmPerPixel = 1.0;
+	m_viewOriginX = 0;
+	m_viewOriginY = 0;
+	m_screenW = 0;
+	m_screenH = 0;
+}
+
+int OBView::modelToLevelX(double modelX)
+{
+	return (int)floor(modelX/m_kmPerPixel);
+}
+
+int OBView::modelToLevelY(double modelY)
+{
+	return (int)floor(modelY/m_kmPerPixel);
+}
+
+int OBView::modelToViewX(double modelX)
+{
+	return modelToLevelX(modelX) - m_viewOriginX;
+}
+
+int OBView::modelToViewY(double modelY)
+{
+	return modelToLevelY(modelY) - m_viewOriginY;
+}
+
+void OBView::updateViewOrigin()
+{
+	// the center goes in the middle of the screen
+	m_viewOriginX = modelToLevelX(m_center.m_fixX) - m_screenW/2;
+	m_viewOriginY = modelToLevelY(m_center.m_fixY) - m_screenH/2;
+}
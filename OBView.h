@@ -0,0 +1,39 @@
+
+#ifndef __OBVIEW__
+#define __OBVIEW__
+
+#include "FGDoubleVector.h"
+
+// Where model space lands on the screen: the scale and the pan. The engine is one.
+// Things that draw or hit test are handed one, so the math doesn't need the engine,
+// and builds without it.
+class OBView
+{
+public:
+	OBView();
+
+	int modelToViewX(double modelX);
+	int modelToViewY(double modelY);
+
+	// model space in pixels at the current zoom, before the pan. Things that are
+	// drawn a lot cache these, since panning only moves them by the view origin.
+	int modelToLevelX(double modelX);
+	int modelToLevelY(double modelY);
+	int getViewOriginX() { return m_viewOriginX; } // the level pixel at the top left of the screen
+	int getViewOriginY() { return m_viewOriginY; }
+
+	// call after changing the center, scale or screen size
+	void updateViewOrigin();
+
+	// scale and translation
+	FGDoubleVector m_center; // this x,y location will be centered on screen
+	double m_kmPerPixel;
+	int m_viewOriginX;
+	int m_viewOriginY;
+
+	// cached for perf
+	int m_screenW;
+	int m_screenH;
+};
+
+#endif
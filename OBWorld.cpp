@@ -0,0 +1,159 @@
+
+#include "OBWorld.h"
+#include "OBGlobals.h"
+#include <math.h>
+
+// a small fixed generator for belts, so they come out the same on every platform
+static double beltRandom(unsigned int &seed)
+{
+	seed = seed*1664525u + 1013904223u;
+	return (double)(seed >> 8)/(double)(1 << 24);
+}
+
+OBWorld::OBWorld()
+{
+}
+
+OBWorld::~OBWorld()
+{
+}
+
+void OBWorld::clear()
+{
+	m_posX.clear();
+	m_posY.clear();
+	m_velX.clear();
+	m_velY.clear();
+	m_sgp.clear();
+	m_orbitee.clear();
+	m_color.clear();
+	m_size.clear();
+}
+
+void OBWorld::reserve(int count)
+{
+	m_posX.reserve(count);
+	m_posY.reserve(count);
+	m_velX.reserve(count);
+	m_velY.reserve(count);
+	m_sgp.reserve(count);
+	m_orbitee.reserve(count);
+	m_color.reserve(count);
+	m_size.reserve(count);
+}
+
+int OBWorld::addBody(int orbiteeIdx, double sgp, double px, double py, double vx, double vy, int color, int size)
+{
+	int idx = getNumBodies();
+	if ( (orbiteeIdx < 0) || (orbiteeIdx >= idx) )
+	{
+		// nothing to orbit, so it stays where it is
+		orbiteeIdx = -1;
+		vx = 0.0;
+		vy = 0.0;
+	}
+
+	m_posX.push_back(px);
+	m_posY.push_back(py);
+	m_velX.push_back(vx);
+	m_velY.push_back(vy);
+	m_sgp.push_back(sgp);
+	m_orbitee.push_back(orbiteeIdx);
+	m_color.push_back(color);
+	m_size.push_back(size);
+	return idx;
+}
+
+int OBWorld::addObject(OBObject &obj, int orbiteeIdx)
+{
+	return addBody(orbiteeIdx, obj.m_sgp, obj.m_pos.m_fixX, obj.m_pos.m_fixY, obj.m_vel.m_fixX, obj.m_vel.m_fixY, obj.m_color, obj.m_size);
+}
+
+void OBWorld::addBelt(int orbiteeIdx, int count, double minDist, double maxDist, int color)
+{
+	if ( (orbiteeIdx < 0) || (orbiteeIdx >= getNumBodies()) ) return;
+
+	double cx = m_posX[orbiteeIdx];
+	double cy = m_posY[orbiteeIdx];
+	double cvx = m_velX[orbiteeIdx];
+	double cvy = m_velY[orbiteeIdx];
+	double sgp = m_sgp[orbiteeIdx];
+
+	reserve(getNumBodies() + count);
+	unsigned int seed = 12345;
+	for ( int i=0 ; i<count ; i++ )
+	{
+		double dist = minDist + (maxDist - minDist)*beltRandom(seed);
+		double angle = TWOPI*beltRandom(seed);
+		double x = cos(angle);
+		double y = sin(angle);
+
+		// clockwise, like everything else: the velocity is the position rotated by -PI/2
+		double speed = sqrt(sgp/dist);
+		addBody(orbiteeIdx, 0.0, cx + x*dist, cy + y*dist, cvx + y*speed, cvy - x*speed, color, 1);
+	}
+}
+
+void OBWorld::tick(double seconds)
+{
+	int count = getNumBodies();
+	if ( count == 0 ) return;
+
+	// gather where everyone's orbitee is. Bodies with nothing to orbit get no pull,
+	// and a center off to the side so the step below doesn't divide by zero.
+	m_centerX.resize(count);
+	m_centerY.resize(count);
+	m_centerSGP.resize(count);
+	for ( int i=0 ; i<count ; i++ )
+	{
+		int orbitee = m_orbitee[i];
+		if ( orbitee == -1 )
+		{
+			m_centerX[i] = m_posX[i] + 1.0;
+			m_centerY[i] = m_posY[i];
+			m_centerSGP[i] = 0.0;
+		}
+		else
+		{
+			m_centerX[i] = m_posX[orbitee];
+			m_centerY[i] = m_posY[orbitee];
+			m_centerSGP[i] = m_sgp[orbitee];
+		}
+	}
+
+	// now the step, straight through the arrays with no branches, so the compiler
+	// can vectorise it. Same math as the kernel's EulerIntegrator with no thrust.
+	const double *cx = &m_centerX[0];
+	const double *cy = &m_centerY[0];
+	const double *cs = &m_centerSGP[0];
+	double *px = &m_posX[0];
+	double *py = &m_posY[0];
+	double *vx = &m_velX[0];
+	double *vy = &m_velY[0];
+	for ( int i=0 ; i<count ; i++ )
+	{
+		double dx = cx[i] - px[i];
+		double dy = cy[i] - py[i];
+		double distSq = dx*dx + dy*dy;
+		double g = cs[i]/(distSq*sqrt(distSq));
+		vx[i] += dx*g*seconds;
+		vy[i] += dy*g*seconds;
+		px[i] += vx[i]*seconds;
+		py[i] += vy[i]*seconds;
+	}
+}
+
+void OBWorld::drawSelf(FGGraphics &g, OBView &view)
+{
+	int count = getNumBodies();
+	for ( int i=0 ; i<count ; i++ )
+	{
+		// note the location, offset by half the size
+		int size = m_size[i];
+		int x = view.modelToViewX(m_posX[i]) - size/2;
+		int y = view.modelToViewY(m_posY[i]) - size/2;
+
+		g.setColor(m_color[i]);
+		g.fillRect(x, y, size, size);
+	}
+}
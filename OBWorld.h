@@ -0,0 +1,62 @@
+
+#ifndef __OBWORLD__
+#define __OBWORLD__
+
+#include "FGGraphics.h"
+#include "OBObject.h"
+#include "OBView.h"
+#include <vector>
+
+// Every body we simulate live, stored as structure of arrays so one tight loop
+// steps them all. OBObject is fine for a handful of planets, but its members are
+// scattered and it steps one body per call. This is for hundreds of asteroids,
+// probes and bits of debris under time warp.
+//
+// Each body is pulled by one other body, its orbitee, same as OBObject. A body
+// with no orbitee stays put. All bodies see their orbitees where they were at the
+// start of the tick, so the order they were added in doesn't matter.
+class OBWorld
+{
+public:
+	OBWorld();
+	~OBWorld();
+
+	void clear();
+	void reserve(int count);
+	int getNumBodies() { return (int)m_posX.size(); }
+
+	// add a body and return its index. orbiteeIdx is -1 for one that doesn't move,
+	// otherwise it must be a body added earlier.
+	int addBody(int orbiteeIdx, double sgp, double px, double py, double vx, double vy, int color, int size);
+
+	// add a body at an OBObject's current position and velocity
+	int addObject(OBObject &obj, int orbiteeIdx);
+
+	// scatter count small bodies on circular orbits around orbiteeIdx, between
+	// minDist and maxDist. The scatter is the same every time.
+	void addBelt(int orbiteeIdx, int count, double minDist, double maxDist, int color);
+
+	// step every body. This is the same step as OBObject::tick.
+	void tick(double seconds);
+
+	void drawSelf(FGGraphics &g, OBView &view);
+
+	// the bodies
+	std::vector<double> m_posX;
+	std::vector<double> m_posY;
+	std::vector<double> m_velX;
+	std::vector<double> m_velY;
+	std::vector<double> m_sgp;
+	std::vector<int> m_orbitee; // index, or -1
+	std::vector<int> m_color;
+	std::vector<int> m_size;
+
+private:
+	// each body's orbitee as of the start of the tick, gathered so the step
+	// loop runs straight through the arrays
+	std::vector<double> m_centerX;
+	std::vector<double> m_centerY;
+	std::vector<double> m_centerSGP;
+};
+
+#endif
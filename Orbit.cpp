@@ -1,27 +1,28 @@
 #include <math.h>
 #include "Orbit.h"
-#include "OBEngine.h"
+#include "OBView.h"
 #include "OBGlobals.h"
 #include "FGDoubleGeometry.h"
 
 Orbit::Orbit()
 {
-	m_drawPoints = NULL;
-	m_numDrawPoints = 0;
+	m_bDrawPointsDirty = true;
 	m_color = 0x7f7f7f;
 	m_bValid = false;
+	m_p = 0.0;
+	m_velScale = 0.0;
+	m_cosW = 1.0;
+	m_sinW = 0.0;
 }
 
 Orbit::~Orbit()
 {
-	delete[] m_drawPoints;
 }
 
 void Orbit::set(Orbit &other)
 {
 	// display
 	m_color = other.m_color;
-	m_engine = other.m_engine;
 
 	m_f1.set(other.m_f1);
 	m_f2.set(other.m_f2);
@@ -36,25 +37,14 @@ void Orbit::set(Orbit &other)
 	m_apogee = other.m_apogee;
 	m_perigee = other.m_perigee;
 	m_orbitArea = other.m_orbitArea;
+	m_p = other.m_p;
+	m_velScale = other.m_velScale;
+	m_cosW = other.m_cosW;
+	m_sinW = other.m_sinW;
 	m_bValid = other.m_bValid;
 
-	if ( other.m_drawPoints == NULL )
-	{
-		delete[] m_drawPoints;
-		m_drawPoints = NULL;
-		m_numDrawPoints = 0;
-	}
-	else
-	{
-		// deal with draw points
-		m_numDrawPoints = other.m_numDrawPoints;
-		delete[] m_drawPoints;
-		m_drawPoints = new DrawPoint[m_numDrawPoints];
-		for ( int i=0 ; i<m_numDrawPoints ; i++ )
-		{
-			m_drawPoints[i] = other.m_drawPoints[i];
-		}
-	}
+	m_drawLine.setPoints(other.m_drawLine);
+	m_bDrawPointsDirty = other.m_bDrawPointsDirty;
 }
 
 void Orbit::setColorFromObjectColor(int objectColor)
@@ -78,8 +68,6 @@ void Orbit::setColor(int color)
 
 void Orbit::init(double sgp, double e, double a, double w)
 {
-	m_engine = (OBEngine *)FGEngine::getEngine();
-
 	m_bValid = true;
 	if ( e > 1.0 ) 
 	{
@@ -125,8 +113,14 @@ void Orbit::init(double sgp, double e, double a, double w)
 	// note the area
 	m_orbitArea = PI*m_a*m_b;
 
-	// precalculate the draw points
-	calcDrawPoints();
+	// for getPos and getVel
+	m_p = m_a*(1.0 - m_e*m_e);
+	m_velScale = (m_p > 0.0) ? sqrt(m_u/m_p) : 0.0;
+	m_cosW = cos(m_w);
+	m_sinW = sin(m_w);
+
+	// the draw points are worked out when we're next drawn
+	m_bDrawPointsDirty = true;
 }
 
 void Orbit::initPV(double sgp, FGDoubleVector &orbiterPos, FGDoubleVector &orbiterVel)
@@ -237,134 +231,37 @@ void Orbit::calcDrawPoints()
 {
 	if ( !m_bValid ) return; 
 
-	// working vector
-	FGDoubleVector work;
-
-	// note how far to walk along the ellipse per step
-	// we'll shoot for a number of pixels
-	double xStep = 2.0*m_engine->m_kmPerPixel; // 2 pixels per step
-
-	// prep the points array. 
-	int numPoints = int((2.0*m_a)/xStep) + 2; // the +2 is for rounding safety
-	int maxDrawPoints = numPoints*2;
-
-	// set up the drawpoints array (trashing any old one that may have been there)
-	delete[] m_drawPoints;
-	m_drawPoints = new DrawPoint[maxDrawPoints];
-
-	// working arrays
-	DrawPoint *firstHalf = new DrawPoint[numPoints];
-	DrawPoint *secondHalf = new DrawPoint[numPoints];
-	int halfPos = 0;
-
-	// work out the points to connect to draw the ellipse
-	// The relevant thing here is the definition of an ellipse.
-	// from this we can calculate that y = sqrt(b^2*(1-x^2/a^2))
-	// so we start x at perihelion, stroll along to aphelion, and 
-	// note the y values. This gives us half the ellipse
-
-	// the total width of the ellipse will be the semi-major axis times 2
-	double x = -m_a;
-	while ( true )
-	{
-		// calculate the y for this x
-		double alpha = 1.0-(x*x)/(m_a*m_a);
-		double y = sqrt(m_b*m_b*alpha);
-
-		if ( halfPos >= numPoints )
-		{
-			FGEngine::fatal("Draw point overflow");
-		}
-
-		// make a vector
-		work.setXY(x, y);
-
-		// rotate by the orbital angle
-		work.rotate(m_w);
-
-		// the x,y values are deltas from the ellipse center
-		// so we have to offset to the center of this ellipse
-		work.addVector(m_center);
-
-		// what we just worked out was the first half
-		firstHalf[halfPos].m_viewX = m_engine->modelToViewX(work.m_fixX);
-		firstHalf[halfPos].m_viewY = m_engine->modelToViewY(work.m_fixY);
-
-		// now work out the other half's location. Same process as documented
-		// above, but we negate the y value before translating and rotating it.
-		work.setXY(x, -y);
-		work.rotate(m_w);
-		work.addVector(m_center);
-		secondHalf[halfPos].m_viewX = m_engine->modelToViewX(work.m_fixX);
-		secondHalf[halfPos].m_viewY = m_engine->modelToViewY(work.m_fixY);
-
-		// advance the half pos
-		halfPos++;
-
-		if ( x == m_a )
-		{
-			// finished the last point
-			break;
-		}
-
-		// advance x
-		x += xStep;
-		if ( x > m_a ) 
-		{
-			x = m_a;
-		}
-	}
-
-	// assemble all the points in to a single sequence.
-	// we run the first half in order, and the second half in reverse
-	// so the line draws are always in one direction around the arc.
-	m_numDrawPoints = 0;
-	for ( int i=0 ; i<halfPos ; i++ )
-	{
-		if ( m_numDrawPoints >= maxDrawPoints )
-		{
-			FGEngine::fatal("draw point overflow");
-		}
-
-		m_drawPoints[m_numDrawPoints] = firstHalf[i];
-		m_numDrawPoints++;
-	}
-
-	for ( int i=halfPos-1 ; i>=0 ; i-- )
+	// walk around the ellipse by eccentric anomaly. These are in model space,
+	// so they're good for any zoom or pan.
+	int count = ORBIT_NUM_DRAW_POINTS + 1; // the last one closes the loop
+	double *modelX = new double[count];
+	double *modelY = new double[count];
+	double cosW = cos(m_w);
+	double sinW = sin(m_w);
+	for ( int i=0 ; i<count ; i++ )
 	{
-		if ( m_numDrawPoints >= maxDrawPoints )
-		{
-			FGEngine::fatal("draw point overflow");
-		}
+		double ecc = (TWOPI*(double)i)/(double)ORBIT_NUM_DRAW_POINTS;
+		double x = m_a*cos(ecc);
+		double y = m_b*sin(ecc);
 
-		m_drawPoints[m_numDrawPoints] = secondHalf[i];
-		m_numDrawPoints++;
+		// rotate by the orbital angle, and offset to the center of the ellipse
+		modelX[i] = x*cosW - y*sinW + m_center.m_fixX;
+		modelY[i] = x*sinW + y*cosW + m_center.m_fixY;
 	}
+	m_drawLine.setPoints(modelX, modelY, count);
+	m_bDrawPointsDirty = false;
 
-	// done with the working arrays
-	delete[] firstHalf;
-	delete[] secondHalf;
+	delete[] modelX;
+	delete[] modelY;
 }
 
-void Orbit::drawSelf(FGGraphics &g)
+void Orbit::drawSelf(FGGraphics &g, OBView &view)
 {
 	if ( !m_bValid ) return; 
-	if ( m_drawPoints == NULL ) return; 
-	if ( m_numDrawPoints < 2 ) return; 
+	if ( m_bDrawPointsDirty ) calcDrawPoints();
 
 	g.setColor(m_color);
-
-	int lastX = m_drawPoints[0].m_viewX;
-	int lastY = m_drawPoints[0].m_viewY;
-	for ( int i=1 ; i<m_numDrawPoints ; i++ )
-	{
-		int thisX = m_drawPoints[i].m_viewX;
-		int thisY = m_drawPoints[i].m_viewY;
-		g.drawLine(lastX, lastY, thisX, thisY);
-
-		lastX = thisX;
-		lastY = thisY;
-	}
+	m_drawLine.drawSelf(g, view);
 }
 
 double Orbit::getR(double theta)
@@ -379,58 +276,79 @@ double Orbit::getR(double theta)
 	return r;
 }
 
+// The position and velocity from theta's direction, closed form. The true anomaly nu
+// is measured from perigee, which is opposite w, and the orbits here go clockwise,
+// so nu = w+PI-theta. Then
+//   r = p/(1+e cos(nu))
+//   v = sqrt(u/p)*(e sin(nu) along r, 1+e cos(nu) along the clockwise tangent)
+// and cos(nu) and sin(nu) come from theta's and w's without any more trig.
+inline void Orbit::calcPosVel(double cosTheta, double sinTheta, double &outX, double &outY, double &outVX, double &outVY)
+{
+	double cosNu = -(cosTheta*m_cosW + sinTheta*m_sinW);
+	double sinNu = sinTheta*m_cosW - cosTheta*m_sinW;
+	double r = m_p/(1.0 + m_e*cosNu);
+	outX = r*cosTheta;
+	outY = r*sinTheta;
+
+	double radial = m_velScale*m_e*sinNu;
+	double tangent = m_velScale*(1.0 + m_e*cosNu);
+	outVX = radial*cosTheta + tangent*sinTheta;
+	outVY = radial*sinTheta - tangent*cosTheta;
+}
+
 void Orbit::getVel(double theta, FGDoubleVector &outVel)
 {
-	// we'll need the position for this theta
 	FGDoubleVector pos;
-	getPos(theta, pos);
-
-	// how far is this from F1? F1 is 0,0, so
-	// it's just the length of the vector
-	double r = pos.getLength();
-
-	// e = v^2/2 - u/r
-	// solve that for v and we get: v=sqrt(2(e+u/r));
-	double vSquared= 2.0*(m_energy+m_u/r);
-	double v = sqrt(vSquared);
-
-	// we now have the velocity, but we need to work out the 
-	// vector angle. A body in orbit will always travel perpendicular to
-	// a line that bisects the lines from the object to the two
-	// foci of the ellipse. 
-	// yeah, it's complicated to write, but easy to understand when you
-	// draw it out. 
-
-	// note the angle from the object to f1. That's PI + theta
-	double angleToF1 = PI+theta;
-
-	// now the angle from the object to F2. 
-	FGDoubleVector lookAtF2;
-	lookAtF2.set(m_f2);
-	lookAtF2.subtractVector(pos);
-	double angleToF2 = lookAtF2.getAngle();
-
-	// bisect those angles. Careful now, we can't just take the average.
-	// one might be negative and the other positive. So we'll use angleDiff.
-	// anglediff is the angle required to go FROM angle1 TO angle2. 
-	double angleDiff = FGDoubleGeometry::angleDiff(angleToF1, angleToF2);
-	double angle = angleToF1 + angleDiff/2.0; // go half-way to angle 2 and you're at the bisection point.
-
-	// the "angle" we have now is the bisection angle. We need to be PI/2 off from that to have the 
-	// tangent.
-	double velAngle = angle + (PI/2.0);
-
-	// now we have the velocity and angle
-	outVel.setRTheta(v, velAngle);
+	getPosVel(theta, pos, outVel);
 }
 
 void Orbit::getPos(double theta, FGDoubleVector &outPos)
 {
-	// get the R for that theta
-	double r = getR(theta);
+	if ( !m_bValid )
+	{
+		outPos.setXY(0.0, 0.0);
+		return;
+	}
+
+	double cosTheta = cos(theta);
+	double sinTheta = sin(theta);
+	double r = m_p/(1.0 - m_e*(cosTheta*m_cosW + sinTheta*m_sinW));
+	outPos.setXY(r*cosTheta, r*sinTheta);
+}
+
+void Orbit::getPosVel(double theta, FGDoubleVector &outPos, FGDoubleVector &outVel)
+{
+	if ( !m_bValid )
+	{
+		outPos.setXY(0.0, 0.0);
+		outVel.setXY(0.0, 0.0);
+		return;
+	}
+
+	double x, y, vx, vy;
+	calcPosVel(cos(theta), sin(theta), x, y, vx, vy);
+	outPos.setXY(x, y);
+	outVel.setXY(vx, vy);
+}
 
-	// make the vector
-	outPos.setRTheta(r, theta);
+void Orbit::getPosVel(const double *thetas, int count, double *outPosX, double *outPosY, double *outVelX, double *outVelY)
+{
+	if ( !m_bValid )
+	{
+		for ( int i=0 ; i<count ; i++ )
+		{
+			outPosX[i] = 0.0;
+			outPosY[i] = 0.0;
+			outVelX[i] = 0.0;
+			outVelY[i] = 0.0;
+		}
+		return;
+	}
+
+	for ( int i=0 ; i<count ; i++ )
+	{
+		calcPosVel(cos(thetas[i]), sin(thetas[i]), outPosX[i], outPosY[i], outVelX[i], outVelY[i]);
+	}
 }
 
 double Orbit::calcDeviance(Orbit &other)
@@ -3,15 +3,12 @@
 
 #include "FGDoubleVector.h"
 #include "FGGraphics.h"
+#include "ProjectionCache.h"
 
-class OBEngine;
+class OBView;
 
-class DrawPoint
-{
-public:
-	int m_viewX;
-	int m_viewY;
-};
+// how many points we draw around an orbit
+#define ORBIT_NUM_DRAW_POINTS 2048
 
 // note: the gravitic body is presumed to be at 0,0. This means that the f1 point
 // will *always* be at (0.0, 0.0).
@@ -45,13 +42,17 @@ public:
 	double calcDeviance(Orbit &other); // very time consuming. Gives the total area of the two orbits that does *not* overlap.
 	void getVel(double theta, FGDoubleVector &outVel); // get the velocity vector for the body when its at angle theta.
 	void getPos(double theta, FGDoubleVector &outPos); // get the position vector for the body when its at angle theta.
+	void getPosVel(double theta, FGDoubleVector &outPos, FGDoubleVector &outVel); // both, for the price of one
+
+	// the same for lots of angles at once, in to arrays of count each
+	void getPosVel(const double *thetas, int count, double *outPosX, double *outPosY, double *outVelX, double *outVelY);
 
 	// display settings
 	void setColorFromObjectColor(int objectColor); // work out a color based on the orbiter's color
 	void setColor(int color); // set the color directly
 
 	// draw
-	void drawSelf(FGGraphics &g);
+	void drawSelf(FGGraphics &g, OBView &view);
 
 
 	// helpers
@@ -59,9 +60,8 @@ public:
 
 	// display
 	int m_color;
-	OBEngine *m_engine;
-	DrawPoint *m_drawPoints;
-	int m_numDrawPoints;
+	ProjectionCache m_drawLine; // the ellipse, in model space
+	bool m_bDrawPointsDirty; // the ellipse is only worked out when it's drawn, so headless orbits never do it
 
 	// relevant orbit data. However the orbit is initted, all
 	// these values will be calculated and stored. 
@@ -78,11 +78,18 @@ public:
 	double m_apogee; // distance from the gravitic body at apogee
 	double m_perigee; // distance from the gravitic body at perigee
 	double m_orbitArea; // the total area of this orbit (area of the ellipse)
+	double m_p; // semi-latus rectum, a(1-e^2)
+	double m_velScale; // sqrt(u/p), the speed scale in getVel
+	double m_cosW; // cos and sin of w, so getPos and getVel only need theta's
+	double m_sinW;
 
 	// if this is false, it means it's not an orbit. Usually this means it's an escape,
 	// but it can also mean the path comes too close to the gravity object for calculation. 
 	// If this is true, you should consider all functions inoperative.
 	bool m_bValid;
+
+private:
+	inline void calcPosVel(double cosTheta, double sinTheta, double &outX, double &outY, double &outVX, double &outVY);
 };
 
 
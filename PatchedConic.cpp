@@ -0,0 +1,522 @@
+
+#include <math.h>
+#include "PatchedConic.h"
+#include "Kepler.h"
+#include "Path.h"
+#include "OBObject.h"
+#include "OBGlobals.h"
+
+void PatchedConicBody::getState(double t, double &outPX, double &outPY, double &outVX, double &outVY)
+{
+	if ( m_sunSgp == 0.0 )
+	{
+		// the sun doesn't go anywhere
+		outPX = 0.0;
+		outPY = 0.0;
+		outVX = 0.0;
+		outVY = 0.0;
+		return;
+	}
+
+	Kepler::propagate(m_sunSgp, m_startPX, m_startPY, m_startVX, m_startVY, t, outPX, outPY, outVX, outVY);
+}
+
+PatchedConic::PatchedConic()
+{
+	m_ship = NULL;
+	m_sunX = 0.0;
+	m_sunY = 0.0;
+	m_fatalDist = FATAL_SUN_APPROACH;
+	m_numKeplerCalls = 0;
+	m_ephemeris = NULL;
+}
+
+PatchedConic::~PatchedConic()
+{
+	delete[] m_ephemeris;
+}
+
+// set a body up. Returns true if that changed anything.
+static bool setBody(PatchedConicBody &body, double sgp, double soiRadius, double sunSgp, double px, double py, double vx, double vy)
+{
+	bool bChanged = (body.m_sgp != sgp) || (body.m_soiRadius != soiRadius) || (body.m_sunSgp != sunSgp) ||
+		(body.m_startPX != px) || (body.m_startPY != py) || (body.m_startVX != vx) || (body.m_startVY != vy);
+
+	body.m_sgp = sgp;
+	body.m_soiRadius = soiRadius;
+	body.m_sunSgp = sunSgp;
+	body.m_startPX = px;
+	body.m_startPY = py;
+	body.m_startVX = vx;
+	body.m_startVY = vy;
+	return bChanged;
+}
+
+void PatchedConic::init(Path *ship, Path *earthPath, Path *marsPath)
+{
+	m_ship = ship;
+
+	// the sun is whatever the ship is orbiting
+	OBObject *sun = ship->m_orbitee;
+	m_sunX = sun->m_pos.m_fixX;
+	m_sunY = sun->m_pos.m_fixY;
+	bool bChanged = (m_ephemeris == NULL);
+	bChanged |= setBody(m_bodies[PCBODY_SUN], sun->m_sgp, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+
+	// the planets start where their paths do
+	Path *planetPaths[PCBODY_COUNT] = { NULL, earthPath, marsPath };
+	double planetSgps[PCBODY_COUNT] = { 0.0, EARTH_SGP, MARS_SGP };
+	double planetSOIs[PCBODY_COUNT] = { 0.0, EARTH_SOI_RADIUS, MARS_SOI_RADIUS };
+	for ( int b=PCBODY_EARTH ; b<PCBODY_COUNT ; b++ )
+	{
+		bChanged |= setBody(m_bodies[b], planetSgps[b], planetSOIs[b], sun->m_sgp,
+			planetPaths[b]->m_startPos.m_fixX - m_sunX, planetPaths[b]->m_startPos.m_fixY - m_sunY,
+			planetPaths[b]->m_startVel.m_fixX, planetPaths[b]->m_startVel.m_fixY);
+	}
+
+	// tabulate every body at every whole day. That's a conic solve each, so only
+	// when a planet has moved since last time.
+	if ( !bChanged ) return;
+	if ( m_ephemeris == NULL )
+	{
+		m_ephemeris = new double[PCBODY_COUNT*PATH_NUM_POINTS*4];
+	}
+	for ( int b=0 ; b<PCBODY_COUNT ; b++ )
+	{
+		for ( int i=0 ; i<PATH_NUM_POINTS ; i++ )
+		{
+			double *entry = &m_ephemeris[(b*PATH_NUM_POINTS + i)*4];
+			m_bodies[b].getState(i*POINTS_TIME, entry[0], entry[1], entry[2], entry[3]);
+		}
+	}
+}
+
+void PatchedConic::getBodyState(int body, double t, double &outPX, double &outPY, double &outVX, double &outVY)
+{
+	// whole days come out of the table
+	double day = t/POINTS_TIME;
+	int dayIdx = (int)day;
+	if ( (day == (double)dayIdx) && (dayIdx >= 0) && (dayIdx < PATH_NUM_POINTS) )
+	{
+		double *entry = &m_ephemeris[(body*PATH_NUM_POINTS + dayIdx)*4];
+		outPX = entry[0];
+		outPY = entry[1];
+		outVX = entry[2];
+		outVY = entry[3];
+		return;
+	}
+
+	m_bodies[body].getState(t, outPX, outPY, outVX, outVY);
+	if ( body != PCBODY_SUN ) m_numKeplerCalls++;
+}
+
+void PatchedConic::getHelio(PatchedConicState &s, double &outPX, double &outPY, double &outVX, double &outVY)
+{
+	double bpx, bpy, bvx, bvy;
+	getBodyState(s.m_body, s.m_t, bpx, bpy, bvx, bvy);
+
+	outPX = bpx + s.m_rx;
+	outPY = bpy + s.m_ry;
+	outVX = bvx + s.m_vx;
+	outVY = bvy + s.m_vy;
+}
+
+void PatchedConic::switchBody(PatchedConicState &s, int newBody)
+{
+	double px, py, vx, vy;
+	getHelio(s, px, py, vx, vy);
+
+	double bpx, bpy, bvx, bvy;
+	getBodyState(newBody, s.m_t, bpx, bpy, bvx, bvy);
+
+	s.m_body = newBody;
+	s.m_rx = px - bpx;
+	s.m_ry = py - bpy;
+	s.m_vx = vx - bvx;
+	s.m_vy = vy - bvy;
+}
+
+void PatchedConic::coastBy(PatchedConicState &s, double dt)
+{
+	if ( dt <= 0.0 ) return;
+
+	double rx, ry, vx, vy;
+	Kepler::propagate(m_bodies[s.m_body].m_sgp, s.m_rx, s.m_ry, s.m_vx, s.m_vy, dt, rx, ry, vx, vy);
+	m_numKeplerCalls++;
+
+	s.m_rx = rx;
+	s.m_ry = ry;
+	s.m_vx = vx;
+	s.m_vy = vy;
+	s.m_t += dt;
+}
+
+void PatchedConic::thrustStep(PatchedConicState &s, double rotX, double rotY, bool bRedirect)
+{
+	// the thrust angle is relative to the direction to the sun, whatever we're centred on
+	double px, py, vx, vy;
+	getHelio(s, px, py, vx, vy);
+	PathKernelDefault::Vec sun(0.0, 0.0);
+	PathKernelDefault::Vec thrust = PathKernelDefault::thrustRot(sun, PathKernelDefault::Vec(px, py), rotX, rotY);
+
+	// step it in the frame of the body we're centred on
+	PathKernelDefault::State state;
+	state.m_pos = PathKernelDefault::Vec(s.m_rx, s.m_ry);
+	state.m_vel = PathKernelDefault::Vec(s.m_vx, s.m_vy);
+	PathKernelDefault::Vec center(0.0, 0.0);
+	PathKernelDefault::step(state, center, m_bodies[s.m_body].m_sgp, thrust, POINTS_TIME, bRedirect);
+
+	s.m_rx = state.m_pos.x();
+	s.m_ry = state.m_pos.y();
+	s.m_vx = state.m_vel.x();
+	s.m_vy = state.m_vel.y();
+	s.m_t += POINTS_TIME;
+}
+
+double PatchedConic::getDistToBody(PatchedConicState &s, int body)
+{
+	if ( s.m_body == body )
+	{
+		return sqrt(s.m_rx*s.m_rx + s.m_ry*s.m_ry);
+	}
+
+	double px, py, vx, vy;
+	getHelio(s, px, py, vx, vy);
+
+	double bpx, bpy, bvx, bvy;
+	getBodyState(body, s.m_t, bpx, bpy, bvx, bvy);
+
+	double dx = px - bpx;
+	double dy = py - bpy;
+	return sqrt(dx*dx + dy*dy);
+}
+
+int PatchedConic::limitStride(PatchedConicState &s, int stride)
+{
+	if ( stride <= 1 ) return stride;
+
+	double px, py, vx, vy;
+	getHelio(s, px, py, vx, vy);
+
+	// work out how long until we could possibly reach each boundary we care about,
+	// and don't jump past it
+	for ( int b=0 ; b<PCBODY_COUNT ; b++ )
+	{
+		double gap;
+		double speed;
+		if ( b == PCBODY_SUN )
+		{
+			// the fatal approach distance
+			gap = sqrt(px*px + py*py) - m_fatalDist;
+			speed = sqrt(vx*vx + vy*vy);
+		}
+		else if ( s.m_body == b )
+		{
+			// leaving this planet's SOI
+			gap = m_bodies[b].m_soiRadius - sqrt(s.m_rx*s.m_rx + s.m_ry*s.m_ry);
+			speed = sqrt(s.m_vx*s.m_vx + s.m_vy*s.m_vy);
+		}
+		else
+		{
+			// entering this planet's SOI. If we're already inside, we don't care.
+			if ( m_bInside[b] ) continue;
+
+			double bpx, bpy, bvx, bvy;
+			getBodyState(b, s.m_t, bpx, bpy, bvx, bvy);
+			double dx = px - bpx;
+			double dy = py - bpy;
+			double dvx = vx - bvx;
+			double dvy = vy - bvy;
+			gap = sqrt(dx*dx + dy*dy) - m_bodies[b].m_soiRadius;
+			speed = sqrt(dvx*dvx + dvy*dvy);
+		}
+
+		double reachPerDay = (speed + PATCHEDCONIC_GUARD_SPEED)*POINTS_TIME;
+		int maxStride = (int)(gap/reachPerDay);
+		if ( maxStride < 1 ) maxStride = 1;
+		if ( maxStride < stride ) stride = maxStride;
+	}
+
+	return stride;
+}
+
+double PatchedConic::findCrossing(PatchedConicState &from, double dt, int body)
+{
+	// bisect on being inside the body's SOI. We know it changed over dt.
+	double radius = m_bodies[body].m_soiRadius;
+	bool bStartInside = getDistToBody(from, body) < radius;
+
+	double lo = 0.0;
+	double hi = dt;
+	for ( int i=0 ; i<PATCHEDCONIC_BISECT_STEPS ; i++ )
+	{
+		double mid = (lo+hi)*0.5;
+		PatchedConicState test = from;
+		coastBy(test, mid);
+		bool bInside = getDistToBody(test, body) < radius;
+		if ( bInside != bStartInside )
+		{
+			hi = mid;
+		}
+		else
+		{
+			lo = mid;
+		}
+	}
+	return hi;
+}
+
+double PatchedConic::findPeriapsis(PatchedConicState &from, double dt)
+{
+	// bisect on the radial velocity. We know it went from closing to opening over dt.
+	double lo = 0.0;
+	double hi = dt;
+	for ( int i=0 ; i<PATCHEDCONIC_BISECT_STEPS ; i++ )
+	{
+		double mid = (lo+hi)*0.5;
+		PatchedConicState test = from;
+		coastBy(test, mid);
+		if ( test.m_rx*test.m_vx + test.m_ry*test.m_vy < 0.0 )
+		{
+			lo = mid;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return (lo+hi)*0.5;
+}
+
+void PatchedConic::noteTransition(PatchedConicResult &result, int fromBody, int toBody, double time)
+{
+	if ( result.m_numTransitions >= PATCHEDCONIC_MAX_TRANSITIONS ) return;
+
+	PatchedConicTransition &trans = result.m_transitions[result.m_numTransitions];
+	trans.m_fromBody = fromBody;
+	trans.m_toBody = toBody;
+	trans.m_time = time;
+	result.m_numTransitions++;
+}
+
+void PatchedConic::checkTransitions(PatchedConicState &from, double dt, bool bCoasting, PatchedConicResult &result)
+{
+	if ( m_state.m_body == PCBODY_SUN )
+	{
+		// did we enter a planet's SOI?
+		for ( int b=PCBODY_EARTH ; b<PCBODY_COUNT ; b++ )
+		{
+			bool bInside = getDistToBody(m_state, b) < m_bodies[b].m_soiRadius;
+			if ( bInside && !m_bInside[b] )
+			{
+				double crossTime = dt;
+				if ( bCoasting )
+				{
+					// find where we crossed, switch there, and finish the jump on the planet's conic
+					crossTime = findCrossing(from, dt, b);
+					m_state = from;
+					coastBy(m_state, crossTime);
+					switchBody(m_state, b);
+					coastBy(m_state, dt - crossTime);
+				}
+				else
+				{
+					// we were thrusting. Just switch where we ended up.
+					switchBody(m_state, b);
+				}
+
+				m_bInside[b] = true;
+				noteTransition(result, PCBODY_SUN, b, from.m_t + crossTime);
+				return;
+			}
+			m_bInside[b] = bInside;
+		}
+		return;
+	}
+
+	// did we leave the planet's SOI?
+	int body = m_state.m_body;
+	if ( getDistToBody(m_state, body) < m_bodies[body].m_soiRadius ) return;
+
+	double crossTime = dt;
+	if ( bCoasting && (from.m_body == body) )
+	{
+		crossTime = findCrossing(from, dt, body);
+		m_state = from;
+		coastBy(m_state, crossTime);
+		switchBody(m_state, PCBODY_SUN);
+		coastBy(m_state, dt - crossTime);
+	}
+	else
+	{
+		switchBody(m_state, PCBODY_SUN);
+	}
+
+	m_bInside[body] = false;
+	noteTransition(result, body, PCBODY_SUN, from.m_t + crossTime);
+}
+
+void PatchedConic::checkApproaches(PatchedConicState &from, double dt, PatchedConicResult &result)
+{
+	// closest approach to mars. If we're on a conic around mars, we can catch
+	// periapsis between samples.
+	double marsDist = getDistToBody(m_state, PCBODY_MARS);
+	double marsTime = m_state.m_t;
+	if ( (from.m_body == PCBODY_MARS) && (m_state.m_body == PCBODY_MARS) &&
+		(from.m_rx*from.m_vx + from.m_ry*from.m_vy < 0.0) &&
+		(m_state.m_rx*m_state.m_vx + m_state.m_ry*m_state.m_vy >= 0.0) )
+	{
+		double periTime = findPeriapsis(from, dt);
+		PatchedConicState peri = from;
+		coastBy(peri, periTime);
+		double periDist = sqrt(peri.m_rx*peri.m_rx + peri.m_ry*peri.m_ry);
+		if ( periDist < marsDist )
+		{
+			marsDist = periDist;
+			marsTime = peri.m_t;
+		}
+	}
+	if ( marsDist < result.m_marsClosestDist )
+	{
+		result.m_marsClosestDist = marsDist;
+		result.m_marsClosestTime = marsTime;
+	}
+
+	// the fatal sun approach. Same deal, we can catch perihelion between samples.
+	if ( m_state.m_body != PCBODY_SUN ) return;
+
+	double sunDistSq = m_state.m_rx*m_state.m_rx + m_state.m_ry*m_state.m_ry;
+	if ( sunDistSq < m_fatalDist*m_fatalDist )
+	{
+		result.m_bHalted = true;
+		return;
+	}
+
+	if ( (from.m_body == PCBODY_SUN) &&
+		(from.m_rx*from.m_vx + from.m_ry*from.m_vy < 0.0) &&
+		(m_state.m_rx*m_state.m_vx + m_state.m_ry*m_state.m_vy >= 0.0) )
+	{
+		PatchedConicState peri = from;
+		coastBy(peri, findPeriapsis(from, dt));
+		if ( peri.m_rx*peri.m_rx + peri.m_ry*peri.m_ry < m_fatalDist*m_fatalDist )
+		{
+			result.m_bHalted = true;
+		}
+	}
+}
+
+void PatchedConic::recordPoint(FGDoubleVector *outPoints, int idx)
+{
+	if ( outPoints == NULL ) return;
+
+	double px, py, vx, vy;
+	getHelio(m_state, px, py, vx, vy);
+	outPoints[idx].setXY(px + m_sunX, py + m_sunY);
+}
+
+void PatchedConic::evaluate(PatchedConicResult &result, FGDoubleVector *outPoints)
+{
+	result.m_lastIdx = 0;
+	result.m_bHalted = false;
+	result.m_finalBody = PCBODY_SUN;
+	result.m_numTransitions = 0;
+	result.m_numThrustSteps = 0;
+	m_numKeplerCalls = 0;
+
+	// start off heliocentric, at the start of the path
+	m_state.m_body = PCBODY_SUN;
+	m_state.m_t = 0.0;
+	m_state.m_rx = m_ship->m_startPos.m_fixX - m_sunX;
+	m_state.m_ry = m_ship->m_startPos.m_fixY - m_sunY;
+	m_state.m_vx = m_ship->m_startVel.m_fixX;
+	m_state.m_vy = m_ship->m_startVel.m_fixY;
+
+	// note which SOIs we start inside (usually earth's). We don't switch
+	// to those until we've left and come back.
+	m_bInside[PCBODY_SUN] = false;
+	for ( int b=PCBODY_EARTH ; b<PCBODY_COUNT ; b++ )
+	{
+		m_bInside[b] = getDistToBody(m_state, b) < m_bodies[b].m_soiRadius;
+	}
+
+	result.m_marsClosestDist = getDistToBody(m_state, PCBODY_MARS);
+	result.m_marsClosestTime = 0.0;
+	recordPoint(outPoints, 0);
+
+	// walk the acceleration points along with the days
+	int stopIdx = m_ship->getStopPoint();
+	AccelerationPointIter apIter = m_ship->m_accelerationPoints.begin();
+	AccelerationPoint *ap = NULL;
+
+	int lastIdx = 0;
+	int i = 1;
+	while ( (i <= stopIdx) && !result.m_bHalted )
+	{
+		// find the acceleration point that governs this step
+		while ( (apIter != m_ship->m_accelerationPoints.end()) && ((*apIter)->m_pointIdx <= i) )
+		{
+			ap = *apIter;
+			apIter++;
+		}
+
+		bool bRedirect = (ap != NULL) && (ap->m_pointIdx == i) && (ap->m_type == ACCTYPE_REDIRECT);
+		if ( (ap != NULL) && ((ap->m_mag != 0.0) || bRedirect) )
+		{
+			// thrusting. Step it a day, the same as Path does.
+			PatchedConicState from = m_state;
+			thrustStep(m_state, ap->m_rotX, ap->m_rotY, bRedirect);
+			result.m_numThrustSteps++;
+			checkTransitions(from, POINTS_TIME, false, result);
+			checkApproaches(from, POINTS_TIME, result);
+
+			lastIdx = i;
+			recordPoint(outPoints, lastIdx);
+			i++;
+			continue;
+		}
+
+		// coasting, until the next acceleration point or the stop point
+		int endIdx = stopIdx;
+		if ( (apIter != m_ship->m_accelerationPoints.end()) && ((*apIter)->m_pointIdx-1 < endIdx) )
+		{
+			endIdx = (*apIter)->m_pointIdx-1;
+		}
+
+		while ( (i <= endIdx) && !result.m_bHalted )
+		{
+			// jump as far as we safely can
+			int stride = endIdx - i + 1;
+			if ( stride > PATCHEDCONIC_COAST_STRIDE ) stride = PATCHEDCONIC_COAST_STRIDE;
+			if ( outPoints != NULL ) stride = 1;
+			stride = limitStride(m_state, stride);
+
+			PatchedConicState from = m_state;
+			double dt = stride*POINTS_TIME;
+			coastBy(m_state, dt);
+			checkTransitions(from, dt, true, result);
+			checkApproaches(from, dt, result);
+
+			i += stride;
+			lastIdx = i-1;
+			recordPoint(outPoints, lastIdx);
+		}
+	}
+
+	// if we halted, the rest of the points just sit there
+	if ( outPoints != NULL )
+	{
+		for ( int j=lastIdx+1 ; j<=stopIdx ; j++ )
+		{
+			outPoints[j].set(outPoints[lastIdx]);
+		}
+	}
+
+	// note where we ended up
+	double px, py, vx, vy;
+	getHelio(m_state, px, py, vx, vy);
+	result.m_lastIdx = lastIdx;
+	result.m_finalBody = m_state.m_body;
+	result.m_finalPos.setXY(px + m_sunX, py + m_sunY);
+	result.m_finalVel.setXY(vx, vy);
+	result.m_numKeplerCalls = m_numKeplerCalls;
+}
@@ -0,0 +1,134 @@
+
+#ifndef __PATCHEDCONIC__
+#define __PATCHEDCONIC__
+
+#include "FGDoubleVector.h"
+
+class Path;
+
+// the bodies a patched conic path can be centred on
+#define PCBODY_SUN 0
+#define PCBODY_EARTH 1
+#define PCBODY_MARS 2
+#define PCBODY_COUNT 3
+
+// how many days we jump at a time on a coast arc, when we're well clear of every SOI
+#define PATCHEDCONIC_COAST_STRIDE 64
+
+// extra closing speed (km/s) we allow for when deciding whether an SOI
+// boundary could be crossed within a jump
+#define PATCHEDCONIC_GUARD_SPEED (5.0)
+
+// bisection steps used to find SOI crossings and periapsis passages
+#define PATCHEDCONIC_BISECT_STEPS 24
+
+#define PATCHEDCONIC_MAX_TRANSITIONS 16
+
+// a body the ship can be centred on. Planets follow their conic around the
+// sun from the start state of their path.
+class PatchedConicBody
+{
+public:
+	// get the body's position and velocity (relative to the sun) t seconds from the start
+	void getState(double t, double &outPX, double &outPY, double &outVX, double &outVY);
+
+	double m_sgp;
+	double m_soiRadius; // 0 for the sun
+	double m_sunSgp;    // what the body itself orbits. 0 for the sun.
+	double m_startPX, m_startPY; // relative to the sun at t=0
+	double m_startVX, m_startVY;
+};
+
+// where the ship is, relative to the body it's centred on
+class PatchedConicState
+{
+public:
+	int m_body; // a PCBODY_XXX constant
+	double m_t; // seconds from the start of the path
+	double m_rx, m_ry;
+	double m_vx, m_vy;
+};
+
+// the ship changed which body it's centred on
+class PatchedConicTransition
+{
+public:
+	int m_fromBody;
+	int m_toBody;
+	double m_time; // seconds from the start of the path
+};
+
+class PatchedConicResult
+{
+public:
+	int m_lastIdx;   // the last point covered. The stop point, unless we halted.
+	bool m_bHalted;  // came too close to the sun
+	int m_finalBody;
+	FGDoubleVector m_finalPos; // in model coordinates
+	FGDoubleVector m_finalVel;
+
+	// closest approach to mars
+	double m_marsClosestDist;
+	double m_marsClosestTime;
+
+	int m_numTransitions;
+	PatchedConicTransition m_transitions[PATCHEDCONIC_MAX_TRANSITIONS];
+
+	// what it cost us
+	int m_numKeplerCalls;
+	int m_numThrustSteps;
+};
+
+// A cheap first-pass evaluator for a ship path. Coast arcs are propagated
+// analytically on conics in jumps of several days, and the ship switches its
+// central body when it enters or leaves Earth's or Mars' sphere of influence.
+// Thrust arcs are still stepped a day at a time, the same way Path does it.
+//
+// Just like the real world, it's an approximation: within an SOI only the
+// planet pulls on the ship.
+class PatchedConic
+{
+public:
+	PatchedConic();
+	~PatchedConic();
+
+	// the ship's start state and acceleration points come from ship. The
+	// planets follow conics from the start states of their paths.
+	void init(Path *ship, Path *earthPath, Path *marsPath);
+
+	// run the ship's path. If outPoints isn't NULL, every day's position is
+	// written there (up to the stop point). That means a conic solve per day,
+	// so it's best left NULL when all you want is the result.
+	void evaluate(PatchedConicResult &result, FGDoubleVector *outPoints);
+
+private:
+	void getBodyState(int body, double t, double &outPX, double &outPY, double &outVX, double &outVY);
+	void getHelio(PatchedConicState &s, double &outPX, double &outPY, double &outVX, double &outVY);
+	void switchBody(PatchedConicState &s, int newBody);
+	void coastBy(PatchedConicState &s, double dt);
+	void thrustStep(PatchedConicState &s, double rotX, double rotY, bool bRedirect);
+	int limitStride(PatchedConicState &s, int stride);
+	double getDistToBody(PatchedConicState &s, int body);
+	double findCrossing(PatchedConicState &from, double dt, int body);
+	double findPeriapsis(PatchedConicState &from, double dt);
+	void noteTransition(PatchedConicResult &result, int fromBody, int toBody, double time);
+	void checkTransitions(PatchedConicState &from, double dt, bool bCoasting, PatchedConicResult &result);
+	void checkApproaches(PatchedConicState &from, double dt, PatchedConicResult &result);
+	void recordPoint(FGDoubleVector *outPoints, int idx);
+
+	Path *m_ship;
+	PatchedConicBody m_bodies[PCBODY_COUNT];
+	double m_sunX, m_sunY; // the sun's position in model coordinates
+	double m_fatalDist;
+
+	// the planets' states at each whole day, so most lookups don't need a conic solve.
+	// Four doubles (px, py, vx, vy) per body per day.
+	double *m_ephemeris;
+
+	// working state
+	PatchedConicState m_state;
+	bool m_bInside[PCBODY_COUNT]; // which SOIs the ship is inside. We only switch on the way in.
+	int m_numKeplerCalls;
+};
+
+#endif
@@ -1,5 +1,10 @@
 #include "Path.h"
-#include "OBEngine.h"
+#include "PathCache.h"
+#include "DriftMonitor.h"
+#include "StateTransition.h"
+#include "OBObject.h"
+#include "OBGlobals.h"
+#include "OBView.h"
 #include "FGDoubleGeometry.h"
 #include "FGDataWriter.h"
 #include "FGDataReader.h"
@@ -7,13 +12,88 @@
 Path::Path()
 {
 	m_orbitee = NULL;
-	m_engine = NULL;
+	m_view = NULL;
+	m_cache = NULL;
+	m_driftMonitor = NULL;
+	m_substeps = 1;
+	m_frontier = -1;
+	m_stm = NULL;
+	m_stmFrontier = -1;
 	m_color = 0;
 	m_size = 2; 
+	m_bHitGridsDirty = true;
+	m_bDrawLineDirty = true;
+	m_gridKmPerPixel = 0.0;
+	m_gridCenterX = 0.0;
+	m_gridCenterY = 0.0;
+
+	// if the pos gets closer than a certain distance from the sun, we just stop
+	m_haltIdx = -1;
+	m_bPadAfterHalt = true;
+	addEvent(PATHEVENT_SUN_APPROACH, NULL, FATAL_SUN_APPROACH, true);
 }
 
 Path::~Path()
 {
+	delete[] m_stm;
+
+	for ( PathEventIter iter = m_events.begin() ; iter != m_events.end() ; iter++ )
+	{
+		delete *iter;
+	}
+	m_events.clear();
+}
+
+PathEvent *Path::addEvent(int type, Path *target, double radius, bool bTerminal)
+{
+	PathEvent *ev = new PathEvent();
+	ev->m_type = type;
+	ev->m_target = target;
+	ev->m_radius = radius;
+	ev->m_bTerminal = bTerminal;
+	m_events.push_back(ev);
+	return ev;
+}
+
+void Path::removeEvent(PathEvent *ev)
+{
+	m_events.remove(ev);
+	delete ev;
+}
+
+void Path::scanEvents(int lastIdx, bool bIncludeTerminal)
+{
+	double orbiteeX = m_orbitee->m_pos.m_fixX;
+	double orbiteeY = m_orbitee->m_pos.m_fixY;
+	for ( PathEventIter iter = m_events.begin() ; iter != m_events.end() ; iter++ )
+	{
+		PathEvent *ev = *iter;
+		if ( ev->m_bTerminal && !bIncludeTerminal ) continue;
+
+		ev->reset();
+		for ( int i=1 ; i<=lastIdx ; i++ )
+		{
+			ev->checkStep(i, m_points[i-1].m_fixX, m_points[i-1].m_fixY, m_points[i].m_fixX, m_points[i].m_fixY, orbiteeX, orbiteeY);
+		}
+	}
+}
+
+void Path::rescanEvents()
+{
+	// terminal events shaped the points, so they stay as they are. The rest we
+	// can just run again over the points we already have.
+	int lastIdx = getStopPoint();
+	ensurePoints(lastIdx);
+	if ( m_haltIdx != -1 )
+	{
+		lastIdx = m_haltIdx;
+	}
+
+	scanEvents(lastIdx, false);
+	for ( PathEventIter iter = m_events.begin() ; iter != m_events.end() ; iter++ )
+	{
+		if ( !(*iter)->m_bTerminal ) (*iter)->finish();
+	}
 }
 
 void Path::init(OBObject *orbitee, FGDoubleVector &pos, FGDoubleVector &vel, int color, int size)
@@ -24,8 +104,7 @@ void Path::init(OBObject *orbitee, FGDoubleVector &pos, FGDoubleVector &vel, int
 	AccelerationPoint *newPoint = createAccelerationPoint(0);
 	newPoint->m_pointIdx = 0;
 	newPoint->m_type = ACCTYPE_NORMAL;
-	newPoint->m_angle = PI/2.0;
-	newPoint->m_mag = PATH_ACCELERATION;
+	newPoint->setAccel(PI/2.0, PATH_ACCELERATION);
 
 	calcPoints();
 }
@@ -33,7 +112,6 @@ void Path::init(OBObject *orbitee, FGDoubleVector &pos, FGDoubleVector &vel, int
 void Path::initNoAcc(OBObject *orbitee, FGDoubleVector &pos, FGDoubleVector &vel, int color, int size)
 {
 	// set up the basics
-	m_engine = (OBEngine *)FGEngine::getEngine();
 	m_orbitee = orbitee;
 	m_startPos.set(pos);
 	m_startVel.set(vel);
@@ -55,9 +133,8 @@ void Path::initNoAcc(OBObject *orbiter, double angle)
 
 	// work out the position and velocity from the angle
 	FGDoubleVector pos;
-	orbiter->m_orbit.getPos(angle, pos);
 	FGDoubleVector vel;
-	orbiter->m_orbit.getVel(angle, vel);
+	orbiter->m_orbit.getPosVel(angle, pos, vel);
 
 	// init with these values
 	initNoAcc(orbitee, pos, vel, color, size);
@@ -85,6 +162,12 @@ void Path::save(FGDataWriter &out)
 }
 
 void Path::load(FGDataReader &in)
+{
+	loadNoCalc(in);
+	calcPoints();
+}
+
+void Path::loadNoCalc(FGDataReader &in)
 {
 	// start and end points
 	m_startPos.readIn(&in);
@@ -106,12 +189,13 @@ void Path::load(FGDataReader &in)
 		AccelerationPoint *ap = new AccelerationPoint();
 		ap->m_pointIdx = in.readInt();
 		ap->m_type = in.readInt();
-		ap->m_angle = in.readDouble();
-		ap->m_mag = in.readDouble();
+		double angle = in.readDouble();
+		double mag = in.readDouble();
+		ap->setAccel(angle, mag);
 		m_accelerationPoints.push_back(ap);
 	}
 
-	calcPoints();
+	invalidateFrom(0);
 }
 
 void Path::removeAccelerationPoint(AccelerationPoint *ap)
@@ -119,16 +203,18 @@ void Path::removeAccelerationPoint(AccelerationPoint *ap)
 	// you can not remove the initial acceleration point
 	if ( ap->m_pointIdx == 0 ) return;
 
+	int pointIdx = ap->m_pointIdx;
 	m_accelerationPoints.remove(ap);
 	delete ap;
+	invalidateFrom(pointIdx);
 }
 
 void Path::adjustAccelerationPoint(AccelerationPoint *ap, int mx, int my, double newMag)
 {
 	// work out the view x,y for this acceleration point
 	int pointIdx = ap->m_pointIdx;
-	int apX = m_engine->modelToViewX(m_points[pointIdx].m_fixX);
-	int apY = m_engine->modelToViewY(m_points[pointIdx].m_fixY);
+	int apX = m_view->modelToViewX(getPoint(pointIdx).m_fixX);
+	int apY = m_view->modelToViewY(getPoint(pointIdx).m_fixY);
 
 	// make a vector that goes from the ap to mx, my
 	FGDoubleVector newLine;
@@ -139,29 +225,19 @@ void Path::adjustAccelerationPoint(AccelerationPoint *ap, int mx, int my, double
 	double unadjustedAng = newLine.getAngle();
 
 	// get the angle from that point to the orbitee
-	FGDoubleVector gravDir;
-	getGravForPoint(pointIdx, gravDir);
-	double gravAng = gravDir.getAngle();
+	double gravAng = getGravForPoint(pointIdx).angle();
 	
 	// set the specifics
-	ap->m_angle = FGDoubleGeometry::angleDiff(gravAng, unadjustedAng);
-	ap->m_mag = newMag;
+	ap->setAccel(FGDoubleGeometry::angleDiff(gravAng, unadjustedAng), newMag);
+	invalidateFrom(pointIdx);
 }
 
-void Path::getGravForPoint(int pointIdx, FGDoubleVector &result)
+Vec2d Path::getGravForPoint(int pointIdx)
 {
-	result.set(m_orbitee->m_pos);
-
 	// we can't trust the location of the current point. We need to
 	// calculate from the location of the previous point. 
-	if ( pointIdx == 0 )
-	{
-		result.subtractVector(m_startPos);
-	}
-	else
-	{
-		result.subtractVector(m_points[pointIdx-1]);
-	}
+	FGDoubleVector &from = (pointIdx == 0) ? m_startPos : getPoint(pointIdx-1);
+	return Vec2d(m_orbitee->m_pos.m_fixX, m_orbitee->m_pos.m_fixY) - Vec2d(from.m_fixX, from.m_fixY);
 }
 
 AccelerationPoint *Path::createAccelerationPoint(int pointIdx)
@@ -197,19 +273,14 @@ AccelerationPoint *Path::createAccelerationPoint(int pointIdx)
 	{
 		// set it up to be the current value for that point
 		// note the apparent thrust for that location.
-		FGDoubleVector thrust;
-		getThrustForPoint(pointIdx, thrust);
-
-		// note the magnitude of thrust
-		newPoint->m_mag = thrust.getLength();
+		Vec2d thrust = getThrustForPoint(pointIdx);
 
 		// work out the angle to the orbitee at that point, using the same
 		// method the thrust method uses.
-		FGDoubleVector gravDir;
-		getGravForPoint(pointIdx, gravDir);
+		Vec2d gravDir = getGravForPoint(pointIdx);
 
-		// note the angle difference
-		newPoint->m_angle = FGDoubleGeometry::angleDiff(gravDir.getAngle(), thrust.getAngle());
+		// note the angle difference, and the magnitude of thrust
+		newPoint->setAccel(FGDoubleGeometry::angleDiff(gravDir.angle(), thrust.angle()), thrust.length());
 	}
 
 	// presume a normal point
@@ -217,6 +288,7 @@ AccelerationPoint *Path::createAccelerationPoint(int pointIdx)
 
 	// ready to turn it loose.
 	m_accelerationPoints.insert(insertIter, newPoint);
+	invalidateFrom(pointIdx);
 	return newPoint;
 }
 
@@ -229,23 +301,24 @@ void Path::drawProgressivePath(FGGraphics &g, int pointIdx)
 		stopIdx = pointIdx;
 	}
 
+	// we only need the path as far as we've got
+	ensurePoints(stopIdx);
+
 	// run through the points and draw the path
 	int lastX;
 	int lastY;
 	g.setColor(m_color);
 	for ( int i=0 ; i<=stopIdx ; i++ )
 	{
-		int x = m_engine->modelToViewX(m_points[i].m_fixX);
-		int y = m_engine->modelToViewY(m_points[i].m_fixY);
+		int x = m_view->modelToViewX(m_points[i].m_fixX);
+		int y = m_view->modelToViewY(m_points[i].m_fixY);
 
 		bool bDraw = false;
 		if ( i != 0 )
 		{
 			// if we aren't thrusting, don't draw this segment
 			// but DO draw it if we're past day 170
-			FGDoubleVector thrust;
-			getThrustForPoint(i, thrust);
-			if ( thrust.getLength() != 0.0 )
+			if ( getThrustForPoint(i).lengthSq() != 0.0 )
 			{
 				bDraw = true;
 			}
@@ -267,25 +340,24 @@ void Path::drawSelf(FGGraphics &g, AccelerationPoint *sel)
 {
 	// find the first stop point
 	int stopIdx = getStopPoint();
+	ensurePoints(stopIdx);
 
-	// run through the points and draw the path
-	int lastX;
-	int lastY;
-	g.setColor(m_color);
-	for ( int i=0 ; i<=stopIdx ; i++ )
+	// the line through the points. It only needs the points again when the path
+	// changes. Zooming and panning are handled by the line.
+	if ( m_bDrawLineDirty )
 	{
-		int x = m_engine->modelToViewX(m_points[i].m_fixX);
-		int y = m_engine->modelToViewY(m_points[i].m_fixY);
-
-		if ( i != 0 )
+		double modelX[PATH_NUM_POINTS];
+		double modelY[PATH_NUM_POINTS];
+		for ( int i=0 ; i<=stopIdx ; i++ )
 		{
-			// draw
-			g.drawLine(lastX, lastY, x, y);
+			modelX[i] = m_points[i].m_fixX;
+			modelY[i] = m_points[i].m_fixY;
 		}
-
-		lastX = x;
-		lastY = y;
+		m_drawLine.setPoints(modelX, modelY, stopIdx+1);
+		m_bDrawLineDirty = false;
 	}
+	g.setColor(m_color);
+	m_drawLine.drawSelf(g, *m_view);
 
 	// run through the acceleration points and draw them
 	for ( AccelerationPointIter iter = m_accelerationPoints.begin() ; iter != m_accelerationPoints.end() ; iter++ )
@@ -295,8 +367,8 @@ void Path::drawSelf(FGGraphics &g, AccelerationPoint *sel)
 
 		// draw a box around the point
 		int pointIdx = ap->m_pointIdx;
-		int x = m_engine->modelToViewX(m_points[pointIdx].m_fixX);
-		int y = m_engine->modelToViewY(m_points[pointIdx].m_fixY);
+		int x = m_view->modelToViewX(m_points[pointIdx].m_fixX);
+		int y = m_view->modelToViewY(m_points[pointIdx].m_fixY);
 
 		// draw the box
 		if ( ap == sel )
@@ -344,93 +416,101 @@ void Path::drawThrustLine(FGGraphics &g, int pointIDX)
 	if ( pointIDX == -1 ) return;
 
 	// show the thrust vector at this point
-	FGDoubleVector thrust;
-	getThrustForPoint(pointIDX, thrust);
-
-	if ( thrust.getLength() == 0.0 ) return;
+	Vec2d thrust = getThrustForPoint(pointIDX);
+	double length = thrust.length();
+	if ( length == 0.0 ) return;
 
-	thrust.setLength(DISPLAY_THRUSTLINE_LENGTH);
-	int x1 = m_engine->modelToViewX(m_points[pointIDX].m_fixX);
-	int y1 = m_engine->modelToViewY(m_points[pointIDX].m_fixY);
-	int x2 = x1 + (int)thrust.m_fixX;
-	int y2 = y1 + (int)thrust.m_fixY;
+	thrust = thrust*(DISPLAY_THRUSTLINE_LENGTH/length);
+	int x1 = m_view->modelToViewX(getPoint(pointIDX).m_fixX);
+	int y1 = m_view->modelToViewY(getPoint(pointIDX).m_fixY);
+	int x2 = x1 + (int)thrust.x();
+	int y2 = y1 + (int)thrust.y();
 
 	g.drawLine(x1, y1, x2, y2);
 }
 
-AccelerationPoint *Path::getNearestAccelPoint(int viewX, int viewY)
+void Path::updateHitGrids()
 {
-	// see what point idx is closest to this point
+	// the grids cover the whole path
+	ensurePoints(getStopPoint());
+
+	// if neither the path nor the view has moved, the grids are still good
+	if ( !m_bHitGridsDirty &&
+		(m_gridKmPerPixel == m_view->m_kmPerPixel) &&
+		(m_gridCenterX == m_view->m_center.m_fixX) &&
+		(m_gridCenterY == m_view->m_center.m_fixY) )
+	{
+		return;
+	}
+
 	int MAX_DIST = DISPLAY_THRUSTLINE_LENGTH + DISPLAY_THRUSTLINE_LENGTH/10;
-	int MAX_DIST_SQ = MAX_DIST*MAX_DIST;
 
-	AccelerationPoint *closestAP = NULL;
-	int closestDistSq = 0;
+	// project the path points
+	int viewX[PATH_NUM_POINTS];
+	int viewY[PATH_NUM_POINTS];
+	int stopIdx = getStopPoint();
+	for ( int i=0 ; i<=stopIdx ; i++ )
+	{
+		viewX[i] = m_view->modelToViewX(m_points[i].m_fixX);
+		viewY[i] = m_view->modelToViewY(m_points[i].m_fixY);
+	}
+	m_pointGrid.build(viewX, viewY, stopIdx+1, MAX_DIST);
 
+	// and the acceleration points, up to and including the first stopper
+	m_accelGridPoints.clear();
 	for ( AccelerationPointIter iter = m_accelerationPoints.begin() ; iter != m_accelerationPoints.end() ; iter++ )
 	{
 		AccelerationPoint *ap= *iter;
-		int accelPointIdx = ap->m_pointIdx;
+		int count = (int)m_accelGridPoints.size();
+		if ( count >= PATH_NUM_POINTS ) break;
 
-		int dx = viewX - m_engine->modelToViewX(m_points[accelPointIdx].m_fixX);
-		int dy = viewY - m_engine->modelToViewY(m_points[accelPointIdx].m_fixY);
-		int distSq = dx*dx + dy*dy;
-		if ( distSq < MAX_DIST_SQ )
-		{
-			if ( (closestAP == NULL) || (distSq < closestDistSq) )
-			{
-				closestDistSq = distSq;
-				closestAP = ap;
-			}
-		}
+		viewX[count] = m_view->modelToViewX(m_points[ap->m_pointIdx].m_fixX);
+		viewY[count] = m_view->modelToViewY(m_points[ap->m_pointIdx].m_fixY);
+		m_accelGridPoints.push_back(ap);
 
 		// if this was a stopper, we stop
 		if ( ap->m_type == ACCTYPE_STOPTRACE ) break;
 	}
+	m_accelGrid.build(viewX, viewY, (int)m_accelGridPoints.size(), MAX_DIST);
 
-	return closestAP;
+	// note the view these were built for
+	m_gridKmPerPixel = m_view->m_kmPerPixel;
+	m_gridCenterX = m_view->m_center.m_fixX;
+	m_gridCenterY = m_view->m_center.m_fixY;
+	m_bHitGridsDirty = false;
 }
 
-int Path::getNearestPointIdx(int viewX, int viewY)
+AccelerationPoint *Path::getNearestAccelPoint(int viewX, int viewY)
 {
-	// see what point idx is closest to this point
+	// see what acceleration point is closest to this point
 	int MAX_DIST = DISPLAY_THRUSTLINE_LENGTH + DISPLAY_THRUSTLINE_LENGTH/10;
-	int MAX_DIST_SQ = MAX_DIST*MAX_DIST;
 
-	int stopIdx = getStopPoint();
-	int closestIdx = -1;
-	int closestDistSq = 0;
+	updateHitGrids();
+	int closestId = m_accelGrid.findNearest(viewX, viewY, MAX_DIST);
+	if ( closestId == -1 ) return NULL;
 
-	for ( int i=0 ; i<=stopIdx ; i++ )
-	{
-		int dx = viewX - m_engine->modelToViewX(m_points[i].m_fixX);
-		int dy = viewY - m_engine->modelToViewY(m_points[i].m_fixY);
-		int distSq = dx*dx + dy*dy;
-		if ( distSq < MAX_DIST_SQ )
-		{
-			if ( (closestIdx == -1) || (distSq < closestDistSq) )
-			{
-				closestDistSq = distSq;
-				closestIdx = i;
-			}
-		}
-	}
+	return m_accelGridPoints[closestId];
+}
+
+int Path::getNearestPointIdx(int viewX, int viewY)
+{
+	// see what point idx is closest to this point. The grid ids are the point indices.
+	int MAX_DIST = DISPLAY_THRUSTLINE_LENGTH + DISPLAY_THRUSTLINE_LENGTH/10;
 
-	return closestIdx;
+	updateHitGrids();
+	return m_pointGrid.findNearest(viewX, viewY, MAX_DIST);
 }
 
-void Path::getThrustForPoint(int pointIdx, FGDoubleVector &result)
+Vec2d Path::getThrustForPoint(int pointIdx)
 {
 	if ( m_accelerationPoints.size() == 0 )
 	{
 		// no points at all
-		result.setXY(0,0);
-		return;
+		return Vec2d(0.0, 0.0);
 	}
 
 	// note the vector to the orbitee. 
-	FGDoubleVector gravDir;
-	getGravForPoint(pointIdx, gravDir);
+	Vec2d gravDir = getGravForPoint(pointIdx);
 
 	// find out which acceleration point we're affected by
 	AccelerationPoint *ap = NULL;
@@ -455,95 +535,480 @@ void Path::getThrustForPoint(int pointIdx, FGDoubleVector &result)
 		ap = *iter;
 	}
 
-	// create a relative acceleration vector based on the deflection angle and magnitude
-	FGDoubleVector acc;
-	acc.set(gravDir);
-	acc.rotate(ap->m_angle);
-	acc.setLength(ap->m_mag);
+	// create a relative acceleration vector based on the deflection angle and magnitude.
+	// It's the same thrust the kernel applies.
+	return PathKernelDefault::thrustRot(gravDir, Vec2d(0.0, 0.0), ap->m_rotX, ap->m_rotY);
+}
 
-	// done
-	result.set(acc);
+// store a kernel vector in to a point array
+template <typename V>
+static inline void kernelStore(FGDoubleVector &out, const V &v)
+{
+	out.setXY((double)v.x(), (double)v.y());
+}
+
+template <typename V>
+static inline void kernelStore(PathPoint &out, const V &v)
+{
+	out.m_x = (double)v.x();
+	out.m_y = (double)v.y();
+}
+
+template <typename V>
+static inline void kernelStore(V &out, const V &v)
+{
+	out = v;
 }
 
 void Path::calcPoints()
 {
-	// note the vel and pos. 
-	FGDoubleVector pos;
-	FGDoubleVector vel;
-	pos.set(m_startPos);
-	vel.set(m_startVel);
+	invalidateFrom(0);
+	ensurePoints(getStopPoint());
+}
 
-	// start off at the start pos
+void Path::invalidateFrom(int pointIdx)
+{
+	// the points are about to move, so the hit grids and draw line are stale
+	m_bHitGridsDirty = true;
+	m_bDrawLineDirty = true;
+	if ( m_stmFrontier > pointIdx-1 )
+	{
+		m_stmFrontier = (pointIdx > 0) ? pointIdx-1 : -1;
+	}
+
+	if ( pointIdx <= 0 )
+	{
+		// start from scratch next time
+		m_frontier = -1;
+		m_haltIdx = -1;
+		return;
+	}
+
+	// if we halted before the change, the change makes no difference
+	if ( (m_haltIdx != -1) && (m_haltIdx < pointIdx) ) return;
+
+	// and if we never got that far, there's nothing to throw away
+	if ( m_frontier < pointIdx ) return;
+
+	// back up to the point before, and put the events back the way they were there
+	m_frontier = pointIdx-1;
+	m_haltIdx = -1;
+	scanEvents(m_frontier, true);
+}
+
+void Path::ensurePoints(int pointIdx)
+{
 	int stopIdx = getStopPoint();
-	m_points[0].set(pos);
+	if ( pointIdx > stopIdx ) pointIdx = stopIdx;
+	if ( pointIdx <= m_frontier ) return;
 
-	bool bHalt = false;
+	// a terminal event stopped us short. There's no more to work out, but the stop
+	// point may have moved out since we padded, and then the padding has to reach it.
+	if ( (m_frontier != -1) && (m_haltIdx != -1) )
+	{
+		if ( m_bPadAfterHalt )
+		{
+			m_bHitGridsDirty = true;
+			m_bDrawLineDirty = true;
+			for ( int j=m_frontier+1 ; j<=pointIdx ; j++ )
+			{
+				m_points[j].set(m_points[m_haltIdx]);
+				m_vels[j].setXY(0.0, 0.0);
+			}
+			m_frontier = pointIdx;
+		}
+		return;
+	}
 
-	for ( int i=1 ; i<=stopIdx ; i++ )
+	// if the whole path is wanted, we may have done it before
+	if ( (pointIdx == stopIdx) && (m_cache != NULL) && m_cache->lookup(this) ) return;
+
+	m_bHitGridsDirty = true;
+	m_bDrawLineDirty = true;
+	if ( m_frontier == -1 )
 	{
-		if ( bHalt )
+		// starting from the start pos and vel
+		m_haltIdx = -1;
+		for ( PathEventIter iter = m_events.begin() ; iter != m_events.end() ; iter++ )
+		{
+			(*iter)->reset();
+		}
+		if ( m_driftMonitor != NULL )
+		{
+			m_driftMonitor->reset();
+		}
+		m_points[0].set(m_startPos);
+		m_vels[0].set(m_startVel);
+		m_frontier = 0;
+	}
+
+	// pick up where we left off
+	PathKernelDefault::State state;
+	state.m_pos = PathKernelDefault::Vec(m_points[m_frontier].m_fixX, m_points[m_frontier].m_fixY);
+	state.m_vel = PathKernelDefault::Vec(m_vels[m_frontier].m_fixX, m_vels[m_frontier].m_fixY);
+	int haltIdx = propagateSteps<PathKernelDefault>(state, m_points, m_vels, m_frontier+1, pointIdx, stopIdx);
+
+	if ( haltIdx != -1 )
+	{
+		m_frontier = m_bPadAfterHalt ? stopIdx : haltIdx;
+	}
+	else
+	{
+		m_frontier = pointIdx;
+	}
+
+	// if that's the whole path, we're done
+	if ( (haltIdx != -1) || (m_frontier == stopIdx) )
+	{
+		for ( PathEventIter iter = m_events.begin() ; iter != m_events.end() ; iter++ )
 		{
-			m_points[i].set(m_points[i-1]);
-			continue;
+			(*iter)->finish();
 		}
 
-		// first, accelerate based on the thing we're orbiting
-		// start with a vector pointed at the orbitee
-		FGDoubleVector gravAcc;
-		gravAcc.set(m_orbitee->m_pos);
-		gravAcc.subtractVector(pos);
+		if ( m_cache != NULL )
+		{
+			m_cache->store(this);
+		}
+	}
+}
+
+void Path::setSubsteps(int substeps)
+{
+	if ( substeps < 1 ) substeps = 1;
+	if ( substeps == m_substeps ) return;
+	m_substeps = substeps;
+	invalidateFrom(0);
+}
 
-		// work out the strength of the acceleration. 
-		// It'll be u/d^2 where u = SGP, and d = distance to the object
-		// this is a good time to include the seconds value
-		double gravAccLen = (POINTS_TIME * m_orbitee->m_sgp)/gravAcc.getLengthSq();
-	
-		// set the new length
-		gravAcc.setLength(gravAccLen);
+void Path::getNodeVel(int pointIdx, FGDoubleVector &outVel)
+{
+	int lastIdx = getStopPoint();
+	if ( m_haltIdx != -1 )
+	{
+		lastIdx = m_haltIdx;
+	}
+
+	if ( (pointIdx <= 0) || (pointIdx >= lastIdx) )
+	{
+		// nothing either side, so take what we have
+		ensurePoints(pointIdx);
+		outVel.set(m_vels[pointIdx]);
+		return;
+	}
+
+	// each m_vels is the velocity we drifted with during the step that got us there
+	ensurePoints(pointIdx+1);
+	outVel.setXY((m_vels[pointIdx].m_fixX + m_vels[pointIdx+1].m_fixX)*0.5,
+		(m_vels[pointIdx].m_fixY + m_vels[pointIdx+1].m_fixY)*0.5);
+}
+
+bool Path::getStateAtTime(double t, FGDoubleVector &outPos, FGDoubleVector &outVel)
+{
+	double dt = POINTS_TIME;
 
-		// apply the acceleration
-		vel.addVector(gravAcc);
+	int stopIdx = getStopPoint();
+	if ( (t < 0.0) || (t > (double)stopIdx*dt) ) return false;
+
+	// which step. Only that much of the path has to be worked out; if it halts
+	// before then, the propagation stops there and we find out below.
+	int i = (int)(t/dt);
+	if ( i >= stopIdx ) i = stopIdx-1;
+	ensurePoints((i+1 < stopIdx) ? i+1 : stopIdx);
+
+	// the last point we can trust
+	int lastIdx = stopIdx;
+	if ( m_haltIdx != -1 )
+	{
+		lastIdx = m_haltIdx;
+	}
+
+	if ( t > (double)lastIdx*dt ) return false;
+	if ( lastIdx == 0 )
+	{
+		outPos.set(m_points[0]);
+		outVel.set(m_vels[0]);
+		return true;
+	}
+
+	// and how far through it
+	if ( i >= lastIdx ) i = lastIdx-1;
+	double s = (t - (double)i*dt)/dt;
+
+	FGDoubleVector &p0 = m_points[i];
+	FGDoubleVector &p1 = m_points[i+1];
+	FGDoubleVector v0;
+	FGDoubleVector v1;
+	getNodeVel(i, v0);
+	getNodeVel(i+1, v1);
+
+	// the Hermite basis functions, and their derivatives
+	double s2 = s*s;
+	double s3 = s2*s;
+	double h00 = 2.0*s3 - 3.0*s2 + 1.0;
+	double h10 = s3 - 2.0*s2 + s;
+	double h01 = -2.0*s3 + 3.0*s2;
+	double h11 = s3 - s2;
+	double d00 = 6.0*s2 - 6.0*s;
+	double d10 = 3.0*s2 - 4.0*s + 1.0;
+	double d01 = -6.0*s2 + 6.0*s;
+	double d11 = 3.0*s2 - 2.0*s;
+
+	outPos.setXY(h00*p0.m_fixX + h10*dt*v0.m_fixX + h01*p1.m_fixX + h11*dt*v1.m_fixX,
+		h00*p0.m_fixY + h10*dt*v0.m_fixY + h01*p1.m_fixY + h11*dt*v1.m_fixY);
+	outVel.setXY((d00*p0.m_fixX + d01*p1.m_fixX)/dt + d10*v0.m_fixX + d11*v1.m_fixX,
+		(d00*p0.m_fixY + d01*p1.m_fixY)/dt + d10*v0.m_fixY + d11*v1.m_fixY);
+	return true;
+}
+
+void Path::onPointsReplaced()
+{
+	m_bHitGridsDirty = true;
+	m_bDrawLineDirty = true;
+	m_stmFrontier = -1;
+}
+
+void Path::setTrackSTM(bool bTrack)
+{
+	if ( bTrack && (m_stm == NULL) )
+	{
+		m_stm = new double[PATH_NUM_POINTS*16];
+		m_stmFrontier = -1;
+	}
+	else if ( !bTrack )
+	{
+		delete[] m_stm;
+		m_stm = NULL;
+		m_stmFrontier = -1;
+	}
+}
 
-		FGDoubleVector thrustAcc;
-		getThrustForPoint(i, thrustAcc);
+bool Path::ensureSTM(int pointIdx)
+{
+	// the jacobians are for whole day steps
+	if ( (m_stm == NULL) || (m_substeps != 1) ) return false;
 
-		// we now know the acceleration vector. Apply it to the vel
-		// first we'll have to multiply by the number of seconds in a step
-		thrustAcc.scalarMultiply(POINTS_TIME);
-		vel.addVector(thrustAcc);
+	// nothing past the stop point or a halt
+	int lastIdx = getStopPoint();
+	if ( pointIdx > lastIdx ) pointIdx = lastIdx;
+	ensurePoints(pointIdx);
+	if ( (m_haltIdx != -1) && (pointIdx > m_haltIdx) ) pointIdx = m_haltIdx;
+	if ( pointIdx <= m_stmFrontier ) return true;
 
-		// run through the acceleration points to see if this point is a redirect
-		for ( AccelerationPointIter iter = m_accelerationPoints.begin() ; iter != m_accelerationPoints.end() ; iter++ )
+	if ( m_stmFrontier == -1 )
+	{
+		StateTransition::identity(&m_stm[0]);
+		m_stmFrontier = 0;
+	}
+
+	// the same walk through the thrust runs as the propagation
+	int firstStep = m_stmFrontier+1;
+	m_schedule.build(m_accelerationPoints, lastIdx);
+	int arcIdx = m_schedule.findArc(firstStep);
+	ThrustArc *arc = &m_schedule.getArc(arcIdx);
+
+	double cx = m_orbitee->m_pos.m_fixX;
+	double cy = m_orbitee->m_pos.m_fixY;
+	double stepJ[16];
+	for ( int i=firstStep ; i<=pointIdx ; i++ )
+	{
+		if ( i > arc->m_end )
 		{
-			// if we have *passed* the current idx, then we know our location
-			AccelerationPoint *ap = *iter;
-			if ( ap->m_pointIdx != i ) continue;
+			arcIdx++;
+			arc = &m_schedule.getArc(arcIdx);
+		}
 
-			// the current point
-			if ( ap->m_type == ACCTYPE_REDIRECT )
+		bool bThrust = (arc->m_type != THRUSTARC_COAST);
+		bool bRedirect = arc->m_bRedirect && (arc->m_start == i);
+		StateTransition::eulerStepJacobian(m_points[i-1].m_fixX, m_points[i-1].m_fixY, m_vels[i-1].m_fixX, m_vels[i-1].m_fixY,
+			cx, cy, m_orbitee->m_sgp, bThrust, arc->m_rotX, arc->m_rotY, bRedirect,
+			POINTS_TIME, stepJ);
+		StateTransition::multiply(stepJ, &m_stm[(i-1)*16], &m_stm[i*16]);
+	}
+	m_stmFrontier = pointIdx;
+	return true;
+}
+
+bool Path::getSTM(int fromIdx, int toIdx, double *out)
+{
+	if ( (fromIdx < 0) || (toIdx < fromIdx) ) return false;
+	if ( !ensureSTM(toIdx) ) return false;
+	if ( toIdx > m_stmFrontier ) return false;
+
+	// from -> to is (start -> to) * (start -> from)^-1
+	double inv[16];
+	if ( !StateTransition::invert(&m_stm[fromIdx*16], inv) ) return false;
+	StateTransition::multiply(&m_stm[toIdx*16], inv, out);
+	return true;
+}
+
+bool Path::getArrivalShift(int burnIdx, int arriveIdx, double dvX, double dvY, double &outDX, double &outDY)
+{
+	double phi[16];
+	if ( !getSTM(burnIdx, arriveIdx, phi) ) return false;
+
+	// only the velocity columns matter
+	outDX = phi[2]*dvX + phi[3]*dvY;
+	outDY = phi[6]*dvX + phi[7]*dvY;
+	return true;
+}
+
+bool Path::getDeltaVForShift(int burnIdx, int arriveIdx, double dx, double dy, double &outDVX, double &outDVY)
+{
+	double phi[16];
+	if ( !getSTM(burnIdx, arriveIdx, phi) ) return false;
+
+	// solve the 2x2 position-from-velocity block
+	double det = phi[2]*phi[7] - phi[3]*phi[6];
+	if ( det == 0.0 ) return false;
+
+	outDVX = ( phi[7]*dx - phi[3]*dy)/det;
+	outDVY = (-phi[6]*dx + phi[2]*dy)/det;
+	return true;
+}
+
+template <typename Kernel, typename OutVec>
+int Path::propagate(OutVec *outPoints)
+{
+	typedef typename Kernel::Scalar T;
+	typedef typename Kernel::Vec Vec;
+
+	// note the vel and pos. 
+	typename Kernel::State state;
+	state.m_pos = Vec((T)m_startPos.m_fixX, (T)m_startPos.m_fixY);
+	state.m_vel = Vec((T)m_startVel.m_fixX, (T)m_startVel.m_fixY);
+
+	// start off at the start pos
+	int stopIdx = getStopPoint();
+	kernelStore(outPoints[0], state.m_pos);
+
+	// get the events ready
+	for ( PathEventIter iter = m_events.begin() ; iter != m_events.end() ; iter++ )
+	{
+		(*iter)->reset();
+	}
+	m_haltIdx = -1;
+	if ( m_driftMonitor != NULL )
+	{
+		m_driftMonitor->reset();
+	}
+
+	int numPoints = stopIdx+1;
+	int haltIdx = propagateSteps<Kernel>(state, outPoints, (FGDoubleVector *)NULL, 1, stopIdx, stopIdx);
+	if ( (haltIdx != -1) && !m_bPadAfterHalt )
+	{
+		numPoints = haltIdx+1;
+	}
+
+	for ( PathEventIter iter = m_events.begin() ; iter != m_events.end() ; iter++ )
+	{
+		(*iter)->finish();
+	}
+
+	// the events are for this run now, not for m_points
+	m_frontier = -1;
+	m_bHitGridsDirty = true;
+	m_bDrawLineDirty = true;
+
+	return numPoints;
+}
+
+template <typename Kernel, typename OutVec>
+int Path::propagateSteps(typename Kernel::State &state, OutVec *outPoints, FGDoubleVector *outVels, int firstStep, int lastStep, int stopIdx)
+{
+	typedef typename Kernel::Scalar T;
+	typedef typename Kernel::Vec Vec;
+
+	// the thing we're orbiting
+	Vec center((T)m_orbitee->m_pos.m_fixX, (T)m_orbitee->m_pos.m_fixY);
+	T sgp = (T)m_orbitee->m_sgp;
+
+	double lastX = (double)state.m_pos.x();
+	double lastY = (double)state.m_pos.y();
+
+	// compile the acceleration points in to runs of steps, and walk them along
+	// with the steps
+	m_schedule.build(m_accelerationPoints, stopIdx);
+	ScheduleStepper<Kernel> stepper(m_schedule, center, sgp, m_substeps, POINTS_TIME, firstStep);
+
+	for ( int i=firstStep ; i<=lastStep ; i++ )
+	{
+		stepper.stepDay(state, i);
+		ThrustArc *arc = &stepper.getArc();
+
+		// only gravity acts on a coast, so energy and angular momentum should hold
+		if ( m_driftMonitor != NULL )
+		{
+			if ( arc->m_mag != 0.0 )
 			{
-				// it's a redirect. Change the angle of the velocity
-				// vector to the angle of the thrust vector
-				vel.setRTheta(vel.getLength(), thrustAcc.getAngle());
+				m_driftMonitor->endArc();
+			}
+			else
+			{
+				double relX = (double)state.m_pos.x() - (double)center.x();
+				double relY = (double)state.m_pos.y() - (double)center.y();
+				// a lazy resume part way through a coast carries on against the
+				// reference it already has. Only a fresh run (or a reset) starts one there.
+				if ( (i == arc->m_start) || !m_driftMonitor->isInArc() )
+				{
+					m_driftMonitor->beginArc((double)sgp, relX, relY, (double)state.m_vel.x(), (double)state.m_vel.y());
+				}
+				else
+				{
+					m_driftMonitor->check(i, relX, relY, (double)state.m_vel.x(), (double)state.m_vel.y());
+				}
 			}
-			break;
 		}
 
-		// now apply the vel to the pos. But we don't want to ruin the value we have
-		// for vel, so we use an intermediate vector for the mult
-		FGDoubleVector work;
-		work.set(vel);
-		work.scalarMultiply(POINTS_TIME);
-		pos.addVector(work);
-
 		// note the point
-		m_points[i].set(pos);
+		kernelStore(outPoints[i], state.m_pos);
+		if ( outVels != NULL )
+		{
+			outVels[i].setXY((double)state.m_vel.x(), (double)state.m_vel.y());
+		}
 
-		// if the pos gets closer than a certain distance from the sun, we just stop
-		if ( FGDoubleGeometry::getDistance(m_points[i], m_orbitee->m_pos) < FATAL_SUN_APPROACH )
+		// check the events for this step
+		double x = (double)state.m_pos.x();
+		double y = (double)state.m_pos.y();
+		bool bHalt = false;
+		for ( PathEventIter iter = m_events.begin() ; iter != m_events.end() ; iter++ )
 		{
-			bHalt = true;
+			PathEvent *ev = *iter;
+			if ( ev->checkStep(i, lastX, lastY, x, y, (double)center.x(), (double)center.y()) && ev->m_bTerminal )
+			{
+				bHalt = true;
+			}
+		}
+		lastX = x;
+		lastY = y;
+
+		if ( bHalt )
+		{
+			// a terminal event. We stop here.
+			m_haltIdx = i;
+			if ( m_bPadAfterHalt )
+			{
+				// the rest of the path just sits at the halt point
+				for ( int j=i+1 ; j<=stopIdx ; j++ )
+				{
+					kernelStore(outPoints[j], state.m_pos);
+					if ( outVels != NULL )
+					{
+						outVels[j].setXY(0.0, 0.0);
+					}
+				}
+			}
+			return i;
 		}
 	}
+
+	return -1;
 }
 
+// the configurations we build
+template int Path::propagate<PathKernelDefault, FGDoubleVector>(FGDoubleVector *outPoints);
+template int Path::propagate<PathKernelDefault, PathKernelDefault::Vec>(PathKernelDefault::Vec *outPoints);
+template int Path::propagate<PathKernelDefault, PathPoint>(PathPoint *outPoints);
+template int Path::propagate<PathKernelFast, PathKernelFast::Vec>(PathKernelFast::Vec *outPoints);
+template int Path::propagate<PathKernelPrecise, PathKernelPrecise::Vec>(PathKernelPrecise::Vec *outPoints);
+template int Path::propagate<PathKernelLeapfrog, PathKernelLeapfrog::Vec>(PathKernelLeapfrog::Vec *outPoints);
+template int Path::propagate<PathKernelRK4, PathKernelRK4::Vec>(PathKernelRK4::Vec *outPoints);
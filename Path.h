@@ -3,10 +3,18 @@
 
 #include "FGDoubleVector.h"
 #include "FGGraphics.h"
+#include "PointGrid.h"
+#include "ProjectionCache.h"
+#include "PathKernel.h"
+#include "PathEvent.h"
+#include "ThrustSchedule.h"
 #include <list>
+#include <vector>
 
 class OBObject;
-class OBEngine;
+class OBView;
+class PathCache;
+class DriftMonitor;
 
 // how long each point represents, and how many points there are
 #define POINTS_TIME (86400.0) 
@@ -25,16 +33,36 @@ class OBEngine;
 
 #define FATAL_SUN_APPROACH (35000000.0)
 
+// a bare x, y pair, so a propagation can write straight in to someone else's buffer
+class PathPoint
+{
+public:
+	double m_x;
+	double m_y;
+};
+
 // an acceleration point
 class AccelerationPoint
 {
 public:
+	AccelerationPoint() : m_pointIdx(0), m_type(ACCTYPE_NORMAL), m_angle(0.0), m_mag(0.0), m_rotX(0.0), m_rotY(0.0) {}
+
+	// change the acceleration. Always go through these, so the rotation below keeps up.
+	void setAccel(double angle, double mag) { m_angle = angle; m_mag = mag; m_rotX = cos(angle)*mag; m_rotY = sin(angle)*mag; }
+	void setAngle(double angle) { setAccel(angle, m_mag); }
+	void setMag(double mag) { setAccel(m_angle, mag); }
+
 	int m_pointIdx; // the point index that this acceleration takes effect
 
 	// the acceleration, relative to the vector from the object to the thing its orbiting
 	int m_type;
 	double m_angle;
 	double m_mag;
+
+	// the angle as a rotation, scaled by the magnitude: (cos, sin)*mag. The thrust for
+	// a step is then the direction to the orbitee times this, with no trig.
+	double m_rotX;
+	double m_rotY;
 };
 
 typedef std::list<AccelerationPoint *> AccelerationPointList;
@@ -52,17 +80,74 @@ public:
 	// takes angle in J200 coordinate system
 	void initNoAcc(OBObject *orbiter, double angle);
 
+	// draw and hit test through this view. Headless paths don't need one.
+	void setView(OBView *view) { m_view = view; m_bHitGridsDirty = true; }
+
 	void drawSelf(FGGraphics &g, AccelerationPoint *sel);
 	void drawThrustLine(FGGraphics &g, int pointIDX);
 	void drawProgressivePath(FGGraphics &g, int pointIdx);
 
 	int getNearestPointIdx(int viewX, int viewY);
 	AccelerationPoint *getNearestAccelPoint(int viewX, int viewY);
+	void invalidateHitGrids() { m_bHitGridsDirty = true; m_bDrawLineDirty = true; }
+	void updateHitGrids(); // rebuilds the hit grids if the path or the view has changed
 
-	void getThrustForPoint(int pointIdx, FGDoubleVector &result);
-	void getGravForPoint(int pointIdx, FGDoubleVector &result);
+	Vec2d getThrustForPoint(int pointIdx);
+	Vec2d getGravForPoint(int pointIdx); // from the point before to the orbitee
 	int getStopPoint();
-	void calcPoints();
+
+	// the points are worked out lazily. m_points is good up to m_frontier, and
+	// asking for a point beyond that propagates up to it and no further.
+	// The events are only complete once the frontier reaches the stop point.
+	FGDoubleVector &getPoint(int pointIdx) { if ( pointIdx > m_frontier ) ensurePoints(pointIdx); return m_points[pointIdx]; }
+	void ensurePoints(int pointIdx);    // propagate up to pointIdx (capped at the stop point)
+	void invalidateFrom(int pointIdx);  // the points from pointIdx on are no longer right
+	void calcPoints();                  // start again from scratch and propagate the whole path
+
+	// The position and velocity at any time between the points, in seconds from the start of
+	// the path. This is a cubic Hermite fit between the neighbouring points, using the velocities
+	// noted while propagating, so it costs no extra integration. Returns false if the time
+	// is off either end of the path.
+	bool getStateAtTime(double t, FGDoubleVector &outPos, FGDoubleVector &outVel);
+
+	// the velocity at a point. The integrator's velocities are for the step either side,
+	// so this is the average of the two.
+	void getNodeVel(int pointIdx, FGDoubleVector &outVel);
+
+	// State transition matrices (see StateTransition.h). Off by default. When on, the
+	// matrix from the start to each point is worked out from the propagated points as
+	// it's needed, and kept, so the queries below don't propagate anything.
+	void setTrackSTM(bool bTrack);
+	bool ensureSTM(int pointIdx); // returns false if we aren't tracking
+
+	// the matrix taking a change in the state at fromIdx to the change it makes at toIdx
+	bool getSTM(int fromIdx, int toIdx, double *out);
+
+	// how far a small delta-v (km/s) at burnIdx moves the path at arriveIdx, and the
+	// other way: the delta-v at burnIdx that would move it by dx, dy (km).
+	bool getArrivalShift(int burnIdx, int arriveIdx, double dvX, double dvY, double &outDX, double &outDY);
+	bool getDeltaVForShift(int burnIdx, int arriveIdx, double dx, double dy, double &outDVX, double &outDVY);
+
+	// split each day's step in to this many, for paths that swing too close for whole days.
+	// Throws away the points if it changes. Tracking STMs only works with 1.
+	void setSubsteps(int substeps);
+	int getSubsteps() { return m_substeps; }
+
+	// call after replacing the points from somewhere other than a propagation
+	void onPointsReplaced();
+
+	// propagate from the start pos and vel with the given kernel (see PathKernel.h),
+	// writing points 0 to getStopPoint() in to outPoints. Returns the number of points written.
+	// If a terminal event fires and m_bPadAfterHalt is off, that will be short of the stop point.
+	// This fills in the events for that run, so m_points will be worked out again when next needed.
+	// Explicitly instantiated in Path.cpp for each kernel configuration.
+	template <typename Kernel, typename OutVec>
+	int propagate(OutVec *outPoints);
+
+	// events. The path owns them. Results are filled in by every propagation.
+	PathEvent *addEvent(int type, Path *target, double radius, bool bTerminal);
+	void removeEvent(PathEvent *ev);
+	void rescanEvents(); // re-run the non-terminal events over the current points, without propagating
 
 	AccelerationPoint *createAccelerationPoint(int pointIdx);
 	void removeAccelerationPoint(AccelerationPoint *ap);
@@ -71,20 +156,65 @@ public:
 	// persistance
 	void save(FGDataWriter &out);
 	void load(FGDataReader &in);
+	void loadNoCalc(FGDataReader &in); // the points are left stale, for whoever recomputes them
 
 	// data
 	FGDoubleVector m_startPos;
 	FGDoubleVector m_startVel;
-	FGDoubleVector m_points[PATH_NUM_POINTS]; // in model coordinates
+	FGDoubleVector m_points[PATH_NUM_POINTS]; // in model coordinates. Only good up to m_frontier.
+	FGDoubleVector m_vels[PATH_NUM_POINTS];   // the velocity at each point, so we can pick up where we left off
+	int m_frontier; // the last point that has been worked out, or -1
+	double *m_stm;    // 16 per point, the matrix from the start to that point. NULL unless tracking.
+	int m_stmFrontier; // the last point with a good matrix, or -1
 	OBObject *m_orbitee;
-	OBEngine *m_engine;
+	OBView *m_view; // where we're drawn, or NULL. Not owned.
+	PathCache *m_cache; // if set, calcPoints looks here before propagating. Not owned.
+
+	// if set, propagations note the drift over coast arcs in it, starting over with each
+	// propagation from the start. A cache hit propagates nothing, so notes nothing. Not owned.
+	DriftMonitor *m_driftMonitor;
 
 	// acceleration points
 	AccelerationPointList m_accelerationPoints;
+	ThrustSchedule m_schedule; // the points compiled for the integrator. Rebuilt for each propagation.
+
+	// events. By default there is just the terminal sun approach.
+	PathEventList m_events;
+	int m_haltIdx; // the point where a terminal event stopped the propagation, or -1
+	bool m_bPadAfterHalt; // fill the points after a halt with the halt point. Batch runs can turn this off.
 
 	// display stuff
 	int m_color;
 	int m_size; 
+
+	// hit-testing grids over the projected points and acceleration points.
+	// These are in view coordinates, so we note the view they were built for.
+	PointGrid m_pointGrid;
+	PointGrid m_accelGrid;
+	std::vector<AccelerationPoint *> m_accelGridPoints; // accel grid id -> acceleration point
+	bool m_bHitGridsDirty;
+	double m_gridKmPerPixel;
+	double m_gridCenterX;
+	double m_gridCenterY;
+
+	// the line we draw through the points, in model space. It handles the view itself.
+	ProjectionCache m_drawLine;
+	bool m_bDrawLineDirty;
+
+private:
+	// not copyable. It owns its events, grids and lines, and a copy would free them twice.
+	Path(const Path &other);
+	Path &operator=(const Path &other);
+
+	// run steps firstStep to lastStep from state, checking the events as we go.
+	// Returns the point a terminal event halted us at, or -1.
+	template <typename Kernel, typename OutVec>
+	int propagateSteps(typename Kernel::State &state, OutVec *outPoints, FGDoubleVector *outVels, int firstStep, int lastStep, int stopIdx);
+
+	int m_substeps; // see setSubsteps
+
+	// reset the events and run them over the points up to lastIdx, without finishing them
+	void scanEvents(int lastIdx, bool bIncludeTerminal);
 };
 
 #endif
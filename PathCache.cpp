@@ -0,0 +1,354 @@
+
+#include "PathCache.h"
+#include "Path.h"
+#include "OBObject.h"
+#include "FGEngine.h"
+#include "FGDataWriter.h"
+#include "FGDataReader.h"
+#include <stdio.h>
+
+// 64 bit FNV-1a
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+PathCacheEntry::PathCacheEntry()
+{
+	m_hash = 0;
+	m_points = NULL;
+	m_vels = NULL;
+	m_numPoints = 0;
+	m_haltIdx = -1;
+}
+
+PathCacheEntry::~PathCacheEntry()
+{
+	delete[] m_points;
+	delete[] m_vels;
+}
+
+PathCache::PathCache()
+{
+	m_maxEntries = PATHCACHE_DEFAULT_MAX_ENTRIES;
+	m_fileSystem = NULL;
+	m_numHits = 0;
+	m_numMisses = 0;
+}
+
+PathCache::~PathCache()
+{
+	clear();
+}
+
+void PathCache::clear()
+{
+	for ( PathCacheEntryIter iter = m_entries.begin() ; iter != m_entries.end() ; iter++ )
+	{
+		delete *iter;
+	}
+	m_entries.clear();
+	m_lookup.clear();
+}
+
+void PathCache::setMaxEntries(int maxEntries)
+{
+	if ( maxEntries < 1 ) maxEntries = 1;
+	m_maxEntries = maxEntries;
+
+	while ( (int)m_entries.size() > m_maxEntries )
+	{
+		PathCacheEntry *oldest = m_entries.back();
+		m_lookup.erase(oldest->m_hash);
+		m_entries.pop_back();
+		delete oldest;
+	}
+}
+
+bool PathCache::getInputs(Path *path, std::vector<double> &outInputs)
+{
+	outInputs.clear();
+
+	// the same things Path::save writes, in the same order
+	outInputs.push_back(path->m_startPos.m_fixX);
+	outInputs.push_back(path->m_startPos.m_fixY);
+	outInputs.push_back(path->m_startVel.m_fixX);
+	outInputs.push_back(path->m_startVel.m_fixY);
+	outInputs.push_back((double)path->m_accelerationPoints.size());
+	for ( AccelerationPointIter iter = path->m_accelerationPoints.begin() ; iter != path->m_accelerationPoints.end() ; iter++ )
+	{
+		AccelerationPoint *ap = *iter;
+		outInputs.push_back((double)ap->m_pointIdx);
+		outInputs.push_back((double)ap->m_type);
+		outInputs.push_back(ap->m_angle);
+		outInputs.push_back(ap->m_mag);
+	}
+
+	// the thing we're orbiting
+	outInputs.push_back(path->m_orbitee->m_sgp);
+	outInputs.push_back(path->m_orbitee->m_pos.m_fixX);
+	outInputs.push_back(path->m_orbitee->m_pos.m_fixY);
+
+	// how finely it's stepped
+	outInputs.push_back((double)path->getSubsteps());
+
+	// the terminal events shape the points. The others are rescanned on a hit.
+	outInputs.push_back(path->m_bPadAfterHalt ? 1.0 : 0.0);
+	for ( PathEventIter iter = path->m_events.begin() ; iter != path->m_events.end() ; iter++ )
+	{
+		PathEvent *ev = *iter;
+		if ( !ev->m_bTerminal ) continue;
+
+		// we can't tell if another path has moved, so don't try
+		if ( ev->m_target != NULL ) return false;
+
+		outInputs.push_back((double)ev->m_type);
+		outInputs.push_back(ev->m_radius);
+	}
+
+	return true;
+}
+
+unsigned long long PathCache::hashInputs(std::vector<double> &inputs)
+{
+	unsigned long long hash = FNV_OFFSET_BASIS;
+	const unsigned char *bytes = (const unsigned char *)&inputs[0];
+	int numBytes = (int)(inputs.size()*sizeof(double));
+	for ( int i=0 ; i<numBytes ; i++ )
+	{
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+void PathCache::applyEntry(PathCacheEntry *entry, Path *path)
+{
+	for ( int i=0 ; i<entry->m_numPoints ; i++ )
+	{
+		path->m_points[i].set(entry->m_points[i]);
+		path->m_vels[i].set(entry->m_vels[i]);
+	}
+	path->m_haltIdx = entry->m_haltIdx;
+	path->m_frontier = entry->m_numPoints-1;
+	if ( (entry->m_haltIdx != -1) && !path->m_bPadAfterHalt )
+	{
+		path->m_frontier = entry->m_haltIdx;
+	}
+
+	// the terminal event results
+	int termIdx = 0;
+	for ( PathEventIter iter = path->m_events.begin() ; iter != path->m_events.end() ; iter++ )
+	{
+		PathEvent *ev = *iter;
+		if ( !ev->m_bTerminal ) continue;
+
+		ev->reset();
+		ev->m_bFired = (entry->m_eventFired[termIdx] != 0);
+		ev->m_pointIdx = entry->m_eventPointIdx[termIdx];
+		ev->m_time = entry->m_eventTime[termIdx];
+		ev->m_dist = entry->m_eventDist[termIdx];
+		termIdx++;
+	}
+
+	// the rest depend on other paths, so run them again
+	path->rescanEvents();
+	path->onPointsReplaced();
+}
+
+void PathCache::addEntry(PathCacheEntry *entry)
+{
+	// a hash collision replaces the old entry
+	std::map<unsigned long long, PathCacheEntryIter>::iterator found = m_lookup.find(entry->m_hash);
+	if ( found != m_lookup.end() )
+	{
+		delete *found->second;
+		m_entries.erase(found->second);
+		m_lookup.erase(found);
+	}
+
+	m_entries.push_front(entry);
+	m_lookup[entry->m_hash] = m_entries.begin();
+
+	// drop the least recently used
+	if ( (int)m_entries.size() > m_maxEntries )
+	{
+		PathCacheEntry *oldest = m_entries.back();
+		m_lookup.erase(oldest->m_hash);
+		m_entries.pop_back();
+		delete oldest;
+	}
+}
+
+bool PathCache::lookup(Path *path)
+{
+	if ( !getInputs(path, m_inputs) ) return false;
+	unsigned long long hash = hashInputs(m_inputs);
+
+	std::map<unsigned long long, PathCacheEntryIter>::iterator found = m_lookup.find(hash);
+	if ( found != m_lookup.end() )
+	{
+		PathCacheEntry *entry = *found->second;
+		if ( entry->m_inputs == m_inputs )
+		{
+			// a hit. Move it to the front.
+			m_entries.splice(m_entries.begin(), m_entries, found->second);
+			found->second = m_entries.begin();
+
+			applyEntry(entry, path);
+			m_numHits++;
+			return true;
+		}
+	}
+
+	if ( m_fileSystem != NULL )
+	{
+		PathCacheEntry *entry = loadFromDisk(hash, m_inputs);
+		if ( entry != NULL )
+		{
+			addEntry(entry);
+			applyEntry(entry, path);
+			m_numHits++;
+			return true;
+		}
+	}
+
+	m_numMisses++;
+	return false;
+}
+
+void PathCache::store(Path *path)
+{
+	PathCacheEntry *entry = new PathCacheEntry();
+	if ( !getInputs(path, entry->m_inputs) )
+	{
+		delete entry;
+		return;
+	}
+	entry->m_hash = hashInputs(entry->m_inputs);
+
+	entry->m_numPoints = path->getStopPoint()+1;
+	entry->m_points = new FGDoubleVector[entry->m_numPoints];
+	entry->m_vels = new FGDoubleVector[entry->m_numPoints];
+	for ( int i=0 ; i<entry->m_numPoints ; i++ )
+	{
+		entry->m_points[i].set(path->m_points[i]);
+		entry->m_vels[i].set(path->m_vels[i]);
+	}
+	entry->m_haltIdx = path->m_haltIdx;
+
+	for ( PathEventIter iter = path->m_events.begin() ; iter != path->m_events.end() ; iter++ )
+	{
+		PathEvent *ev = *iter;
+		if ( !ev->m_bTerminal ) continue;
+
+		entry->m_eventFired.push_back(ev->m_bFired ? 1 : 0);
+		entry->m_eventPointIdx.push_back(ev->m_pointIdx);
+		entry->m_eventTime.push_back(ev->m_time);
+		entry->m_eventDist.push_back(ev->m_dist);
+	}
+
+	addEntry(entry);
+
+	if ( m_fileSystem != NULL )
+	{
+		saveToDisk(entry);
+	}
+}
+
+void PathCache::getDiskFilename(unsigned long long hash, char *outName)
+{
+	sprintf(outName, "pathcache_%08x%08x.dat", (unsigned int)(hash >> 32), (unsigned int)(hash & 0xffffffff));
+}
+
+void PathCache::saveToDisk(PathCacheEntry *entry)
+{
+	FGDataWriter out;
+	out.init();
+
+	// the inputs go first, so a load can check it's got the right thing
+	out.writeInt(PATHCACHE_FILE_VERSION);
+	out.writeInt((int)entry->m_inputs.size());
+	for ( int i=0 ; i<(int)entry->m_inputs.size() ; i++ )
+	{
+		out.writeDouble(entry->m_inputs[i]);
+	}
+
+	out.writeInt(entry->m_numPoints);
+	for ( int i=0 ; i<entry->m_numPoints ; i++ )
+	{
+		out.writeDouble(entry->m_points[i].m_fixX);
+		out.writeDouble(entry->m_points[i].m_fixY);
+		out.writeDouble(entry->m_vels[i].m_fixX);
+		out.writeDouble(entry->m_vels[i].m_fixY);
+	}
+	out.writeInt(entry->m_haltIdx);
+
+	out.writeInt((int)entry->m_eventFired.size());
+	for ( int i=0 ; i<(int)entry->m_eventFired.size() ; i++ )
+	{
+		out.writeInt(entry->m_eventFired[i]);
+		out.writeInt(entry->m_eventPointIdx[i]);
+		out.writeDouble(entry->m_eventTime[i]);
+		out.writeDouble(entry->m_eventDist[i]);
+	}
+
+	char filename[64];
+	getDiskFilename(entry->m_hash, filename);
+	FGData *toSave = out.getData();
+	m_fileSystem->putFile(filename, toSave);
+	delete toSave;
+}
+
+PathCacheEntry *PathCache::loadFromDisk(unsigned long long hash, std::vector<double> &inputs)
+{
+	char filename[64];
+	getDiskFilename(hash, filename);
+	FGData *inData = m_fileSystem->getFile(filename);
+	if ( inData == NULL ) return NULL;
+
+	FGDataReader in;
+	in.init(inData);
+
+	// make sure it's really ours
+	int version = in.readInt();
+	int numInputs = (version == PATHCACHE_FILE_VERSION) ? in.readInt() : -1;
+	bool bMatch = (numInputs == (int)inputs.size());
+	for ( int i=0 ; bMatch && (i<numInputs) ; i++ )
+	{
+		if ( in.readDouble() != inputs[i] ) bMatch = false;
+	}
+	if ( !bMatch )
+	{
+		delete inData;
+		return NULL;
+	}
+
+	PathCacheEntry *entry = new PathCacheEntry();
+	entry->m_hash = hash;
+	entry->m_inputs = inputs;
+
+	entry->m_numPoints = in.readInt();
+	entry->m_points = new FGDoubleVector[entry->m_numPoints];
+	entry->m_vels = new FGDoubleVector[entry->m_numPoints];
+	for ( int i=0 ; i<entry->m_numPoints ; i++ )
+	{
+		double x = in.readDouble();
+		double y = in.readDouble();
+		entry->m_points[i].setXY(x, y);
+		x = in.readDouble();
+		y = in.readDouble();
+		entry->m_vels[i].setXY(x, y);
+	}
+	entry->m_haltIdx = in.readInt();
+
+	int numEvents = in.readInt();
+	for ( int i=0 ; i<numEvents ; i++ )
+	{
+		entry->m_eventFired.push_back(in.readInt());
+		entry->m_eventPointIdx.push_back(in.readInt());
+		entry->m_eventTime.push_back(in.readDouble());
+		entry->m_eventDist.push_back(in.readDouble());
+	}
+	delete inData;
+
+	return entry;
+}
@@ -0,0 +1,92 @@
+
+#ifndef __PATHCACHE__
+#define __PATHCACHE__
+
+#include "FGDoubleVector.h"
+#include <list>
+#include <map>
+#include <vector>
+
+class Path;
+class FGFileSystem;
+
+// how many propagated paths we keep in memory by default
+#define PATHCACHE_DEFAULT_MAX_ENTRIES 64
+
+// bump this when the disk layout changes, so old files are ignored
+#define PATHCACHE_FILE_VERSION 3
+
+// a propagated path, and the inputs that made it
+class PathCacheEntry
+{
+public:
+	PathCacheEntry();
+	~PathCacheEntry();
+
+	unsigned long long m_hash;
+	std::vector<double> m_inputs; // see PathCache::getInputs
+
+	FGDoubleVector *m_points;
+	FGDoubleVector *m_vels;
+	int m_numPoints;
+	int m_haltIdx;
+
+	// the results of the terminal events, in the path's order
+	std::vector<int> m_eventFired;
+	std::vector<int> m_eventPointIdx;
+	std::vector<double> m_eventTime;
+	std::vector<double> m_eventDist;
+};
+
+typedef std::list<PathCacheEntry *> PathCacheEntryList;
+typedef PathCacheEntryList::iterator PathCacheEntryIter;
+
+// Memoizes Path propagation. Entries are keyed on a hash of everything the
+// propagation depends on: the same values Path::save writes, plus the orbitee
+// and the terminal events. The least recently used entry is dropped when the
+// cache is full. Entries can also be kept on disk, so they survive a restart.
+class PathCache
+{
+public:
+	PathCache();
+	~PathCache();
+
+	void setMaxEntries(int maxEntries);
+	void setFileSystem(FGFileSystem *fileSystem) { m_fileSystem = fileSystem; } // keep entries on disk through this too, or NULL for memory only
+	void clear();
+
+	// if we've propagated these inputs before, fill in the path's points and
+	// event results and return true
+	bool lookup(Path *path);
+
+	// note the path's freshly propagated points
+	void store(Path *path);
+
+	// stats
+	int m_numHits;
+	int m_numMisses;
+
+private:
+	// the inputs, flattened to doubles. Returns false if the path can't be cached,
+	// which is when a terminal event watches another path.
+	bool getInputs(Path *path, std::vector<double> &outInputs);
+	unsigned long long hashInputs(std::vector<double> &inputs);
+
+	void applyEntry(PathCacheEntry *entry, Path *path);
+	void addEntry(PathCacheEntry *entry);
+
+	void getDiskFilename(unsigned long long hash, char *outName);
+	PathCacheEntry *loadFromDisk(unsigned long long hash, std::vector<double> &inputs);
+	void saveToDisk(PathCacheEntry *entry);
+
+	// most recently used at the front
+	PathCacheEntryList m_entries;
+	std::map<unsigned long long, PathCacheEntryIter> m_lookup;
+	int m_maxEntries;
+	FGFileSystem *m_fileSystem; // not owned
+
+	// scratch, so lookups don't allocate
+	std::vector<double> m_inputs;
+};
+
+#endif
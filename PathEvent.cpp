@@ -0,0 +1,211 @@
+
+#include <math.h>
+#include "PathEvent.h"
+#include "Path.h"
+
+PathEvent::PathEvent()
+{
+	m_type = PATHEVENT_THRESHOLD;
+	m_target = NULL;
+	m_radius = 0.0;
+	m_bTerminal = false;
+	reset();
+}
+
+void PathEvent::reset()
+{
+	m_bFired = false;
+	m_pointIdx = -1;
+	m_time = 0.0;
+	m_dist = 0.0;
+
+	m_bestDistSq = -1.0;
+	m_bHavePrev = false;
+	m_bHaveNext = false;
+}
+
+void PathEvent::getTargetPos(int pointIdx, double orbiteeX, double orbiteeY, double &outX, double &outY)
+{
+	if ( m_target == NULL )
+	{
+		outX = orbiteeX;
+		outY = orbiteeY;
+		return;
+	}
+
+	FGDoubleVector &targetPos = m_target->getPoint(pointIdx);
+	outX = targetPos.m_fixX;
+	outY = targetPos.m_fixY;
+}
+
+bool PathEvent::checkStep(int pointIdx, double x0, double y0, double x1, double y1, double orbiteeX, double orbiteeY)
+{
+	// work out where we are relative to the target at both ends of the step.
+	// Between points we treat the relative motion as a straight line.
+	double tx0, ty0;
+	double tx1, ty1;
+	getTargetPos(pointIdx-1, orbiteeX, orbiteeY, tx0, ty0);
+	getTargetPos(pointIdx, orbiteeX, orbiteeY, tx1, ty1);
+	double rx0 = x0 - tx0;
+	double ry0 = y0 - ty0;
+	double rx1 = x1 - tx1;
+	double ry1 = y1 - ty1;
+	double distSq = rx1*rx1 + ry1*ry1;
+
+	if ( m_type == PATHEVENT_CLOSEST_APPROACH )
+	{
+		// the first step also gives us the start point to consider
+		if ( m_bestDistSq < 0.0 )
+		{
+			m_bestDistSq = rx0*rx0 + ry0*ry0;
+			m_pointIdx = pointIdx-1;
+			m_bestRelX = rx0;
+			m_bestRelY = ry0;
+		}
+
+		if ( distSq < m_bestDistSq )
+		{
+			// a new best
+			m_bestDistSq = distSq;
+			m_pointIdx = pointIdx;
+			m_prevRelX = rx0;
+			m_prevRelY = ry0;
+			m_bestRelX = rx1;
+			m_bestRelY = ry1;
+			m_bHavePrev = true;
+			m_bHaveNext = false;
+		}
+		else if ( pointIdx == m_pointIdx+1 )
+		{
+			// the point just after the best
+			m_nextRelX = rx1;
+			m_nextRelY = ry1;
+			m_bHaveNext = true;
+		}
+		return false;
+	}
+
+	// everything else is a one-shot crossing in to m_radius
+	if ( m_bFired ) return false;
+
+	// squared distances, so no sqrt unless we've actually crossed
+	double radiusSq = m_radius*m_radius;
+	double distSq0 = rx0*rx0 + ry0*ry0;
+	double inX = rx1;
+	double inY = ry1;
+	double sIn = 1.0; // how far along the step (inX, inY) is
+	if ( distSq >= radiusSq )
+	{
+		// the end is outside, but a fast pass can go in and back out within the step.
+		// That's only possible if the closest point on the segment is between the ends,
+		// closing at the start and opening at the end.
+		double dx = rx1-rx0;
+		double dy = ry1-ry0;
+		double dot0 = rx0*dx + ry0*dy;
+		if ( (dot0 >= 0.0) || (rx1*dx + ry1*dy <= 0.0) ) return false;
+
+		// the closest distance squared is distSq0 - dot0^2/lenSq. Compare without dividing.
+		double lenSq = dx*dx + dy*dy;
+		if ( (distSq0 - radiusSq)*lenSq >= dot0*dot0 ) return false;
+
+		// it dips in. The entry is between the start and the closest point.
+		sIn = -dot0/lenSq;
+		inX = rx0 + sIn*dx;
+		inY = ry0 + sIn*dy;
+	}
+
+	// we crossed in during this step. Find out where.
+	double s = 0.0;
+	if ( distSq0 >= radiusSq )
+	{
+		s = bisectEntry(rx0, ry0, inX, inY)*sIn;
+	}
+
+	m_bFired = true;
+	m_pointIdx = pointIdx;
+	m_time = ((double)(pointIdx-1) + s)*POINTS_TIME;
+	double rx = rx0 + s*(rx1-rx0);
+	double ry = ry0 + s*(ry1-ry0);
+	m_dist = sqrt(rx*rx + ry*ry);
+	return true;
+}
+
+double PathEvent::bisectEntry(double rx0, double ry0, double rx1, double ry1)
+{
+	// we know we're outside at 0 and inside at 1
+	double radiusSq = m_radius*m_radius;
+	double lo = 0.0;
+	double hi = 1.0;
+	for ( int i=0 ; i<PATHEVENT_BISECT_STEPS ; i++ )
+	{
+		double mid = (lo+hi)*0.5;
+		double rx = rx0 + mid*(rx1-rx0);
+		double ry = ry0 + mid*(ry1-ry0);
+		if ( rx*rx + ry*ry < radiusSq )
+		{
+			hi = mid;
+		}
+		else
+		{
+			lo = mid;
+		}
+	}
+	return hi;
+}
+
+double PathEvent::closestOnSegment(double rx0, double ry0, double rx1, double ry1, double &outDistSq)
+{
+	// the closest point on the line is where the range rate is zero:
+	// s = -dot(r0, d)/dot(d, d). Past either end, the closest point is that end.
+	double dx = rx1-rx0;
+	double dy = ry1-ry0;
+	double lenSq = dx*dx + dy*dy;
+
+	double s = 0.0;
+	if ( lenSq > 0.0 )
+	{
+		s = -(rx0*dx + ry0*dy)/lenSq;
+		if ( s < 0.0 ) s = 0.0;
+		if ( s > 1.0 ) s = 1.0;
+	}
+
+	double rx = rx0 + s*dx;
+	double ry = ry0 + s*dy;
+	outDistSq = rx*rx + ry*ry;
+	return s;
+}
+
+void PathEvent::finish()
+{
+	if ( m_type != PATHEVENT_CLOSEST_APPROACH ) return;
+	if ( m_bestDistSq < 0.0 ) return;
+
+	// start with the best point itself
+	double bestDistSq = m_bestDistSq;
+	m_time = (double)m_pointIdx*POINTS_TIME;
+
+	// the real closest approach may be on the step in to the point, or the step out of it
+	if ( m_bHavePrev )
+	{
+		double distSq;
+		double s = closestOnSegment(m_prevRelX, m_prevRelY, m_bestRelX, m_bestRelY, distSq);
+		if ( distSq < bestDistSq )
+		{
+			bestDistSq = distSq;
+			m_time = ((double)(m_pointIdx-1) + s)*POINTS_TIME;
+		}
+	}
+	if ( m_bHaveNext )
+	{
+		double distSq;
+		double s = closestOnSegment(m_bestRelX, m_bestRelY, m_nextRelX, m_nextRelY, distSq);
+		if ( distSq < bestDistSq )
+		{
+			bestDistSq = distSq;
+			m_time = ((double)m_pointIdx + s)*POINTS_TIME;
+		}
+	}
+
+	m_dist = sqrt(bestDistSq);
+	m_bFired = true;
+}
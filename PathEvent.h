@@ -0,0 +1,67 @@
+
+#ifndef __PATHEVENT__
+#define __PATHEVENT__
+
+#include <list>
+
+class Path;
+
+// event types
+#define PATHEVENT_SUN_APPROACH 0     // the path comes within m_radius of the thing it's orbiting
+#define PATHEVENT_SOI_ENTRY 1        // the path enters a planet's sphere of influence (m_radius)
+#define PATHEVENT_CLOSEST_APPROACH 2 // the closest the path gets to the target
+#define PATHEVENT_THRESHOLD 3        // a user threshold: the path comes within m_radius of the target
+
+// the number of bisection steps used to refine a crossing within a step.
+// 30 gets us well under a second on a one-day step.
+#define PATHEVENT_BISECT_STEPS 30
+
+// something we watch for while propagating a path. The setup values are filled
+// in by whoever adds the event. The results are filled in by the propagation.
+class PathEvent
+{
+public:
+	PathEvent();
+
+	// clear the results, ready for a new propagation
+	void reset();
+
+	// check the step that took the path from (x0, y0) at point pointIdx-1 to (x1, y1) at pointIdx.
+	// The orbitee position is used when there's no target path.
+	// Returns true if the event fired on this step.
+	bool checkStep(int pointIdx, double x0, double y0, double x1, double y1, double orbiteeX, double orbiteeY);
+
+	// called when the propagation is done. Refines the closest approach.
+	void finish();
+
+	// setup
+	int m_type;       // a PATHEVENT_XXXX constant
+	Path *m_target;   // the path of the body we're watching. NULL means the orbitee.
+	double m_radius;  // in km. Not used for closest approach.
+	bool m_bTerminal; // stop propagating when this fires
+
+	// results
+	bool m_bFired;
+	int m_pointIdx;   // the point at the end of the step where this happened
+	double m_time;    // seconds from the start of the path, refined within the step
+	double m_dist;    // the distance to the target at m_time
+
+private:
+	void getTargetPos(int pointIdx, double orbiteeX, double orbiteeY, double &outX, double &outY);
+	double bisectEntry(double rx0, double ry0, double rx1, double ry1);
+	double closestOnSegment(double rx0, double ry0, double rx1, double ry1, double &outDistSq);
+
+	// closest approach tracking. The positions relative to the target at the best
+	// point, and the points either side of it.
+	double m_bestDistSq;
+	double m_prevRelX, m_prevRelY;
+	double m_bestRelX, m_bestRelY;
+	double m_nextRelX, m_nextRelY;
+	bool m_bHavePrev;
+	bool m_bHaveNext;
+};
+
+typedef std::list<PathEvent *> PathEventList;
+typedef PathEventList::iterator PathEventIter;
+
+#endif
@@ -0,0 +1,287 @@
+
+#include "PathHistory.h"
+
+PathSnapshot::PathSnapshot()
+{
+	m_accelerationPoints = NULL;
+	m_numAccelerationPoints = 0;
+	m_events = NULL;
+	m_numEvents = 0;
+	m_haltIdx = -1;
+	m_frontier = -1;
+	for ( int i=0 ; i<PATHHISTORY_NUM_BLOCKS ; i++ )
+	{
+		m_blocks[i] = NULL;
+	}
+}
+
+PathSnapshot::~PathSnapshot()
+{
+	// the blocks are shared, so the history releases those
+	delete[] m_accelerationPoints;
+	delete[] m_events;
+}
+
+PathHistory::PathHistory()
+{
+	m_path = NULL;
+	m_current = -1;
+}
+
+PathHistory::~PathHistory()
+{
+	clear();
+}
+
+void PathHistory::clear()
+{
+	for ( int i=0 ; i<(int)m_snapshots.size() ; i++ )
+	{
+		deleteSnapshot(m_snapshots[i]);
+	}
+	m_snapshots.clear();
+	m_current = -1;
+}
+
+void PathHistory::init(Path *path)
+{
+	clear();
+	m_path = path;
+	record();
+}
+
+void PathHistory::releaseBlock(PathPointBlock *block)
+{
+	if ( block == NULL ) return;
+
+	block->m_refCount--;
+	if ( block->m_refCount == 0 )
+	{
+		delete block;
+	}
+}
+
+void PathHistory::deleteSnapshot(PathSnapshot *snap)
+{
+	for ( int i=0 ; i<PATHHISTORY_NUM_BLOCKS ; i++ )
+	{
+		releaseBlock(snap->m_blocks[i]);
+	}
+	delete snap;
+}
+
+bool PathHistory::matchesCurrent()
+{
+	if ( m_current == -1 ) return false;
+	PathSnapshot *snap = m_snapshots[m_current];
+
+	if ( (snap->m_startPos.m_fixX != m_path->m_startPos.m_fixX) || (snap->m_startPos.m_fixY != m_path->m_startPos.m_fixY) ) return false;
+	if ( (snap->m_startVel.m_fixX != m_path->m_startVel.m_fixX) || (snap->m_startVel.m_fixY != m_path->m_startVel.m_fixY) ) return false;
+	if ( snap->m_numAccelerationPoints != (int)m_path->m_accelerationPoints.size() ) return false;
+
+	int i = 0;
+	for ( AccelerationPointIter iter = m_path->m_accelerationPoints.begin() ; iter != m_path->m_accelerationPoints.end() ; iter++ )
+	{
+		AccelerationPoint *ap = *iter;
+		AccelerationPoint *old = &snap->m_accelerationPoints[i++];
+		if ( (ap->m_pointIdx != old->m_pointIdx) || (ap->m_type != old->m_type) ||
+			(ap->m_angle != old->m_angle) || (ap->m_mag != old->m_mag) )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+PathPointBlock *PathHistory::shareOrCopyBlock(int blockIdx, PathSnapshot *prev)
+{
+	// only the points up to the frontier are worth keeping
+	int first = blockIdx*PATHHISTORY_BLOCK_SIZE;
+	int count = m_path->m_frontier+1 - first;
+	if ( count <= 0 ) return NULL;
+	if ( count > PATHHISTORY_BLOCK_SIZE ) count = PATHHISTORY_BLOCK_SIZE;
+
+	// if the previous entry has the same points here, share its block
+	PathPointBlock *old = NULL;
+	if ( prev != NULL )
+	{
+		old = prev->m_blocks[blockIdx];
+	}
+	if ( (old != NULL) && (old->m_count == count) )
+	{
+		bool bSame = true;
+		for ( int i=0 ; i<count ; i++ )
+		{
+			if ( (old->m_points[i].m_fixX != m_path->m_points[first+i].m_fixX) ||
+				(old->m_points[i].m_fixY != m_path->m_points[first+i].m_fixY) ||
+				(old->m_vels[i].m_fixX != m_path->m_vels[first+i].m_fixX) ||
+				(old->m_vels[i].m_fixY != m_path->m_vels[first+i].m_fixY) )
+			{
+				bSame = false;
+				break;
+			}
+		}
+
+		if ( bSame )
+		{
+			old->m_refCount++;
+			return old;
+		}
+	}
+
+	// otherwise take a copy
+	PathPointBlock *block = new PathPointBlock();
+	block->m_refCount = 1;
+	block->m_count = count;
+	for ( int i=0 ; i<count ; i++ )
+	{
+		block->m_points[i].set(m_path->m_points[first+i]);
+		block->m_vels[i].set(m_path->m_vels[first+i]);
+	}
+	return block;
+}
+
+void PathHistory::record()
+{
+	if ( m_path == NULL ) return;
+	if ( matchesCurrent() ) return;
+
+	// a new edit, so the redo entries are gone
+	while ( (int)m_snapshots.size() > m_current+1 )
+	{
+		deleteSnapshot(m_snapshots.back());
+		m_snapshots.pop_back();
+	}
+
+	PathSnapshot *prev = NULL;
+	if ( m_current != -1 )
+	{
+		prev = m_snapshots[m_current];
+	}
+
+	PathSnapshot *snap = new PathSnapshot();
+	snap->m_startPos.set(m_path->m_startPos);
+	snap->m_startVel.set(m_path->m_startVel);
+
+	// the acceleration points, by value
+	snap->m_numAccelerationPoints = (int)m_path->m_accelerationPoints.size();
+	snap->m_accelerationPoints = new AccelerationPoint[snap->m_numAccelerationPoints];
+	int i = 0;
+	for ( AccelerationPointIter iter = m_path->m_accelerationPoints.begin() ; iter != m_path->m_accelerationPoints.end() ; iter++ )
+	{
+		snap->m_accelerationPoints[i++] = **iter;
+	}
+
+	// the points, sharing what we can with the entry before. Work them out to the
+	// stop point first; an edit has just thrown the tail away, and a snapshot without
+	// it would have undo propagate it all over again.
+	m_path->ensurePoints(m_path->getStopPoint());
+	for ( int b=0 ; b<PATHHISTORY_NUM_BLOCKS ; b++ )
+	{
+		snap->m_blocks[b] = shareOrCopyBlock(b, prev);
+	}
+	snap->m_frontier = m_path->m_frontier;
+
+	// and the event results
+	snap->m_numEvents = (int)m_path->m_events.size();
+	snap->m_events = new PathEvent[snap->m_numEvents];
+	i = 0;
+	for ( PathEventIter iter = m_path->m_events.begin() ; iter != m_path->m_events.end() ; iter++ )
+	{
+		snap->m_events[i++] = **iter;
+	}
+	snap->m_haltIdx = m_path->m_haltIdx;
+
+	m_snapshots.push_back(snap);
+	m_current = (int)m_snapshots.size()-1;
+
+	// don't grow forever
+	if ( (int)m_snapshots.size() > PATHHISTORY_MAX_DEPTH )
+	{
+		deleteSnapshot(m_snapshots.front());
+		m_snapshots.erase(m_snapshots.begin());
+		m_current--;
+	}
+}
+
+void PathHistory::restore(PathSnapshot *snap, PathSnapshot *from)
+{
+	m_path->m_startPos.set(snap->m_startPos);
+	m_path->m_startVel.set(snap->m_startVel);
+
+	// rebuild the acceleration points
+	for ( AccelerationPointIter iter = m_path->m_accelerationPoints.begin() ; iter != m_path->m_accelerationPoints.end() ; iter++ )
+	{
+		delete *iter;
+	}
+	m_path->m_accelerationPoints.clear();
+	for ( int i=0 ; i<snap->m_numAccelerationPoints ; i++ )
+	{
+		AccelerationPoint *ap = new AccelerationPoint();
+		*ap = snap->m_accelerationPoints[i];
+		m_path->m_accelerationPoints.push_back(ap);
+	}
+
+	// the path matches the entry we're coming from, so only the blocks
+	// that differ between the two need copying
+	for ( int b=0 ; b<PATHHISTORY_NUM_BLOCKS ; b++ )
+	{
+		PathPointBlock *block = snap->m_blocks[b];
+		if ( block == NULL ) break;
+		if ( block == from->m_blocks[b] ) continue;
+
+		int first = b*PATHHISTORY_BLOCK_SIZE;
+		for ( int i=0 ; i<block->m_count ; i++ )
+		{
+			m_path->m_points[first+i].set(block->m_points[i]);
+			m_path->m_vels[first+i].set(block->m_vels[i]);
+		}
+	}
+	m_path->m_frontier = snap->m_frontier;
+
+	// the event results. If events were added or removed since, they have to be
+	// worked out again.
+	m_path->m_haltIdx = snap->m_haltIdx;
+	if ( snap->m_numEvents == (int)m_path->m_events.size() )
+	{
+		int i = 0;
+		for ( PathEventIter iter = m_path->m_events.begin() ; iter != m_path->m_events.end() ; iter++ )
+		{
+			**iter = snap->m_events[i++];
+		}
+	}
+	else
+	{
+		m_path->invalidateFrom(0);
+	}
+
+	m_path->onPointsReplaced();
+}
+
+bool PathHistory::undo()
+{
+	if ( !canUndo() ) return false;
+
+	// note any edit that wasn't recorded yet, so we can come back to it
+	record();
+
+	restore(m_snapshots[m_current-1], m_snapshots[m_current]);
+	m_current--;
+	return true;
+}
+
+bool PathHistory::redo()
+{
+	if ( !canRedo() ) return false;
+
+	// an edit that wasn't recorded yet replaces the redo entries
+	if ( !matchesCurrent() )
+	{
+		record();
+		return false;
+	}
+
+	restore(m_snapshots[m_current+1], m_snapshots[m_current]);
+	m_current++;
+	return true;
+}
@@ -0,0 +1,85 @@
+
+#ifndef __PATHHISTORY__
+#define __PATHHISTORY__
+
+#include "Path.h"
+#include <vector>
+
+// how many points go in each shared block, and how many blocks a path has
+#define PATHHISTORY_BLOCK_SIZE 64
+#define PATHHISTORY_NUM_BLOCKS ((PATH_NUM_POINTS + PATHHISTORY_BLOCK_SIZE - 1)/PATHHISTORY_BLOCK_SIZE)
+
+// how many snapshots we keep before dropping the oldest
+#define PATHHISTORY_MAX_DEPTH 200
+
+// a run of propagated points. Snapshots whose points match share the same block,
+// so an edit late in the path only costs the blocks after the edit.
+class PathPointBlock
+{
+public:
+	int m_refCount;
+	int m_count; // how many are good. The last block is short, and so is the one at the frontier.
+	FGDoubleVector m_points[PATHHISTORY_BLOCK_SIZE];
+	FGDoubleVector m_vels[PATHHISTORY_BLOCK_SIZE];
+};
+
+// everything needed to put a path back the way it was, without propagating
+class PathSnapshot
+{
+public:
+	PathSnapshot();
+	~PathSnapshot();
+
+	// the inputs
+	FGDoubleVector m_startPos;
+	FGDoubleVector m_startVel;
+	AccelerationPoint *m_accelerationPoints; // by value, in order
+	int m_numAccelerationPoints;
+
+	// the propagated results, as far as the path had got. Blocks past the frontier are NULL.
+	PathPointBlock *m_blocks[PATHHISTORY_NUM_BLOCKS];
+	int m_frontier;
+	PathEvent *m_events; // by value, in the path's order. Mid-propagation state and all.
+	int m_numEvents;
+	int m_haltIdx;
+};
+
+// Undo/redo for a path. Call record() after every finished edit; undo() and redo()
+// put the path back to a recorded state, points and all.
+class PathHistory
+{
+public:
+	PathHistory();
+	~PathHistory();
+
+	// start a history for the path, with its current state as the first entry
+	void init(Path *path);
+
+	// note the path's current state, with its points worked out to the stop point.
+	// Anything that could have been redone is dropped.
+	// Does nothing if the inputs haven't changed since the current entry.
+	void record();
+
+	// step back or forward. Returns false if there's nowhere to go. Any acceleration
+	// point pointers in to the path are no longer valid afterward.
+	bool undo();
+	bool redo();
+
+	bool canUndo() { return m_current > 0; }
+	bool canRedo() { return m_current < (int)m_snapshots.size()-1; }
+
+	void clear();
+
+private:
+	bool matchesCurrent();
+	PathPointBlock *shareOrCopyBlock(int blockIdx, PathSnapshot *prev);
+	void releaseBlock(PathPointBlock *block);
+	void deleteSnapshot(PathSnapshot *snap);
+	void restore(PathSnapshot *snap, PathSnapshot *from);
+
+	Path *m_path;
+	std::vector<PathSnapshot *> m_snapshots;
+	int m_current; // the entry the path currently matches
+};
+
+#endif
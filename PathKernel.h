@@ -0,0 +1,224 @@
+
+#ifndef __PATHKERNEL__
+#define __PATHKERNEL__
+
+#include <cmath>
+#include "Vec2d.h"
+
+// The propagation kernel. This is the math behind Path::calcPoints and
+// OBObject::tick, pulled out so it can be instantiated for different
+// scalar types and integrators. Everything in here is a template, so each
+// configuration gets its own fully inlined loop.
+//
+// Angles and rotations follow the same convention as FGDoubleVector.
+
+// a plain 2d vector over any scalar type
+template <typename T>
+class KernelVec
+{
+public:
+	typedef T Scalar;
+
+	KernelVec() {}
+	KernelVec(T x, T y) : m_x(x), m_y(y) {}
+
+	T x() const { return m_x; }
+	T y() const { return m_y; }
+
+	KernelVec operator+(const KernelVec &o) const { return KernelVec(m_x+o.m_x, m_y+o.m_y); }
+	KernelVec operator-(const KernelVec &o) const { return KernelVec(m_x-o.m_x, m_y-o.m_y); }
+	KernelVec operator*(T s) const { return KernelVec(m_x*s, m_y*s); }
+	KernelVec &operator+=(const KernelVec &o) { m_x += o.m_x; m_y += o.m_y; return *this; }
+	KernelVec &operator-=(const KernelVec &o) { m_x -= o.m_x; m_y -= o.m_y; return *this; }
+
+	T m_x;
+	T m_y;
+};
+
+template <typename V>
+inline typename V::Scalar kernelDot(const V &a, const V &b)
+{
+	return a.x()*b.x() + a.y()*b.y();
+}
+
+inline double kernelDot(const Vec2d &a, const Vec2d &b)
+{
+	return Vec2d::dot(a, b);
+}
+
+// the vector type a kernel uses for a scalar type. Doubles get the SIMD one.
+template <typename T>
+class KernelVecType
+{
+public:
+	typedef KernelVec<T> Type;
+};
+
+template <>
+class KernelVecType<double>
+{
+public:
+	typedef Vec2d Type;
+};
+
+// the position and velocity of a body
+template <typename V>
+class KernelState
+{
+public:
+	V m_pos;
+	V m_vel;
+};
+
+// the acceleration toward a body of the given sgp. It'll be u/d^2 along the
+// line to the body, where u = SGP, and d = distance to the object
+template <typename T, typename V>
+inline V kernelGravity(const V &center, T sgp, const V &pos)
+{
+	V toCenter = center - pos;
+	T distSq = kernelDot(toCenter, toCenter);
+	T dist = std::sqrt(distSq);
+	return toCenter*(sgp/(distSq*dist));
+}
+
+// the thrust vector for an acceleration point: the direction to the orbitee,
+// rotated by (rotX, rotY). That's (cos, sin) of the deflection angle, scaled by
+// the magnitude, which AccelerationPoint keeps so steps don't need any trig.
+template <typename T, typename V>
+inline V kernelThrustRot(const V &center, const V &pos, T rotX, T rotY)
+{
+	V toCenter = center - pos;
+	T dist = std::sqrt(kernelDot(toCenter, toCenter));
+	if ( dist == (T)0 ) return V((T)0, (T)0);
+
+	V dir = toCenter*((T)1/dist);
+	return V(dir.x()*rotX - dir.y()*rotY, dir.x()*rotY + dir.y()*rotX);
+}
+
+// the same, from the deflection angle and magnitude
+template <typename T, typename V>
+inline V kernelThrust(const V &center, const V &pos, T angle, T mag)
+{
+	return kernelThrustRot(center, pos, std::cos(angle)*mag, std::sin(angle)*mag);
+}
+
+// point the velocity along the thrust, keeping its speed. This is what
+// an ACCTYPE_REDIRECT point does.
+template <typename T, typename V>
+inline void kernelRedirect(KernelState<V> &s, const V &thrust)
+{
+	T speed = std::sqrt(kernelDot(s.m_vel, s.m_vel));
+	T thrustLen = std::sqrt(kernelDot(thrust, thrust));
+	if ( thrustLen == (T)0 )
+	{
+		// no thrust direction to speak of. Angle 0, like FGDoubleVector gives us.
+		s.m_vel = V(speed, (T)0);
+		return;
+	}
+	s.m_vel = thrust*(speed/thrustLen);
+}
+
+/************ INTEGRATORS *****************/
+// Each integrator advances a state by dt under the pull of one body plus a
+// thrust that is held constant over the step.
+
+// Semi-implicit Euler. This is what the app has always used: kick the
+// velocity with the acceleration at the start of the step, then move with
+// the new velocity. A redirect happens between the kick and the move.
+class EulerIntegrator
+{
+public:
+	template <typename T, typename V>
+	static inline void step(KernelState<V> &s, const V &center, T sgp, const V &thrust, T dt, bool bRedirect)
+	{
+		s.m_vel += kernelGravity(center, sgp, s.m_pos)*dt;
+		s.m_vel += thrust*dt;
+		if ( bRedirect ) kernelRedirect<T>(s, thrust);
+		s.m_pos += s.m_vel*dt;
+	}
+};
+
+// Kick-drift-kick leapfrog. Second order, and still cheap: one new
+// gravity evaluation per step. Redirects happen at the start of the step.
+class LeapfrogIntegrator
+{
+public:
+	template <typename T, typename V>
+	static inline void step(KernelState<V> &s, const V &center, T sgp, const V &thrust, T dt, bool bRedirect)
+	{
+		if ( bRedirect ) kernelRedirect<T>(s, thrust);
+
+		T halfDt = dt*(T)0.5;
+		s.m_vel += (kernelGravity(center, sgp, s.m_pos) + thrust)*halfDt;
+		s.m_pos += s.m_vel*dt;
+		s.m_vel += (kernelGravity(center, sgp, s.m_pos) + thrust)*halfDt;
+	}
+};
+
+// Classic fourth order Runge-Kutta. Four gravity evaluations per step.
+// Redirects happen at the start of the step.
+class RK4Integrator
+{
+public:
+	template <typename T, typename V>
+	static inline void step(KernelState<V> &s, const V &center, T sgp, const V &thrust, T dt, bool bRedirect)
+	{
+		if ( bRedirect ) kernelRedirect<T>(s, thrust);
+
+		T halfDt = dt*(T)0.5;
+		V p1 = s.m_pos;
+		V v1 = s.m_vel;
+		V a1 = kernelGravity(center, sgp, p1) + thrust;
+
+		V p2 = p1 + v1*halfDt;
+		V v2 = v1 + a1*halfDt;
+		V a2 = kernelGravity(center, sgp, p2) + thrust;
+
+		V p3 = p1 + v2*halfDt;
+		V v3 = v1 + a2*halfDt;
+		V a3 = kernelGravity(center, sgp, p3) + thrust;
+
+		V p4 = p1 + v3*dt;
+		V v4 = v1 + a3*dt;
+		V a4 = kernelGravity(center, sgp, p4) + thrust;
+
+		T sixth = dt/(T)6;
+		s.m_pos += (v1 + (v2 + v3)*(T)2 + v4)*sixth;
+		s.m_vel += (a1 + (a2 + a3)*(T)2 + a4)*sixth;
+	}
+};
+
+/************ KERNELS *****************/
+// a kernel is a scalar type bound to an integrator
+template <typename T, typename Integrator>
+class PathKernel
+{
+public:
+	typedef T Scalar;
+	typedef typename KernelVecType<T>::Type Vec;
+	typedef KernelState<Vec> State;
+
+	static inline void step(State &s, const Vec &center, T sgp, const Vec &thrust, T dt, bool bRedirect)
+	{
+		Integrator::step(s, center, sgp, thrust, dt, bRedirect);
+	}
+
+	static inline Vec thrust(const Vec &center, const Vec &pos, T angle, T mag)
+	{
+		return kernelThrust(center, pos, angle, mag);
+	}
+
+	static inline Vec thrustRot(const Vec &center, const Vec &pos, T rotX, T rotY)
+	{
+		return kernelThrustRot(center, pos, rotX, rotY);
+	}
+};
+
+// the configurations we build. Path::propagate is explicitly instantiated for each.
+typedef PathKernel<double, EulerIntegrator> PathKernelDefault;       // what calcPoints and OBObject::tick use
+typedef PathKernel<float, EulerIntegrator> PathKernelFast;           // screening sweeps
+typedef PathKernel<long double, RK4Integrator> PathKernelPrecise;   // checking drift on long missions
+typedef PathKernel<double, LeapfrogIntegrator> PathKernelLeapfrog;  // the integrator harness
+typedef PathKernel<double, RK4Integrator> PathKernelRK4;            // the integrator harness
+
+#endif
@@ -0,0 +1,179 @@
+
+#include "PointGrid.h"
+#include <stddef.h>
+
+// never let the grid have more than this many cells per point. Keeps
+// the grid small when the points are spread far beyond the screen.
+#define POINTGRID_MAX_CELLS_PER_POINT 4
+
+PointGrid::PointGrid()
+{
+	m_cellStart = NULL;
+	m_x = NULL;
+	m_y = NULL;
+	m_id = NULL;
+	m_numPoints = 0;
+	m_numCols = 0;
+	m_numRows = 0;
+	m_cellSize = 1;
+	m_minX = 0;
+	m_minY = 0;
+}
+
+PointGrid::~PointGrid()
+{
+	clear();
+}
+
+void PointGrid::clear()
+{
+	delete[] m_cellStart;
+	delete[] m_x;
+	delete[] m_y;
+	delete[] m_id;
+	m_cellStart = NULL;
+	m_x = NULL;
+	m_y = NULL;
+	m_id = NULL;
+	m_numPoints = 0;
+	m_numCols = 0;
+	m_numRows = 0;
+}
+
+int PointGrid::getCol(int viewX)
+{
+	// floor division, the offsets can be negative during queries
+	int dx = viewX - m_minX;
+	if ( dx < 0 ) return (dx - m_cellSize + 1)/m_cellSize;
+	return dx/m_cellSize;
+}
+
+int PointGrid::getRow(int viewY)
+{
+	int dy = viewY - m_minY;
+	if ( dy < 0 ) return (dy - m_cellSize + 1)/m_cellSize;
+	return dy/m_cellSize;
+}
+
+void PointGrid::build(const int *viewX, const int *viewY, int count, int cellSize)
+{
+	clear();
+	if ( count <= 0 ) return;
+	if ( cellSize < 1 ) cellSize = 1;
+
+	// find the bounds
+	int minX = viewX[0];
+	int maxX = viewX[0];
+	int minY = viewY[0];
+	int maxY = viewY[0];
+	for ( int i=1 ; i<count ; i++ )
+	{
+		if ( viewX[i] < minX ) minX = viewX[i];
+		if ( viewX[i] > maxX ) maxX = viewX[i];
+		if ( viewY[i] < minY ) minY = viewY[i];
+		if ( viewY[i] > maxY ) maxY = viewY[i];
+	}
+
+	// size the cells. If the points are spread out a long way (way off
+	// screen, for instance) we grow the cells rather than the grid.
+	double maxCells = (double)(count*POINTGRID_MAX_CELLS_PER_POINT + 64);
+	while ( true )
+	{
+		double cols = (double)((maxX-minX)/cellSize + 1);
+		double rows = (double)((maxY-minY)/cellSize + 1);
+		if ( cols*rows <= maxCells ) break;
+		cellSize *= 2;
+	}
+
+	m_minX = minX;
+	m_minY = minY;
+	m_cellSize = cellSize;
+	m_numCols = (maxX-minX)/cellSize + 1;
+	m_numRows = (maxY-minY)/cellSize + 1;
+	int numCells = m_numCols*m_numRows;
+
+	// count how many points land in each cell
+	m_cellStart = new int[numCells+1];
+	for ( int c=0 ; c<=numCells ; c++ )
+	{
+		m_cellStart[c] = 0;
+	}
+	for ( int i=0 ; i<count ; i++ )
+	{
+		int cell = getRow(viewY[i])*m_numCols + getCol(viewX[i]);
+		m_cellStart[cell+1]++;
+	}
+
+	// turn the counts in to start offsets
+	for ( int c=0 ; c<numCells ; c++ )
+	{
+		m_cellStart[c+1] += m_cellStart[c];
+	}
+
+	// drop the points in to their cells. Going in id order keeps
+	// each cell sorted by id.
+	m_x = new int[count];
+	m_y = new int[count];
+	m_id = new int[count];
+	int *cursor = new int[numCells];
+	for ( int c=0 ; c<numCells ; c++ )
+	{
+		cursor[c] = m_cellStart[c];
+	}
+	for ( int i=0 ; i<count ; i++ )
+	{
+		int cell = getRow(viewY[i])*m_numCols + getCol(viewX[i]);
+		int slot = cursor[cell]++;
+		m_x[slot] = viewX[i];
+		m_y[slot] = viewY[i];
+		m_id[slot] = i;
+	}
+	delete[] cursor;
+
+	m_numPoints = count;
+}
+
+int PointGrid::findNearest(int viewX, int viewY, int maxDist)
+{
+	if ( m_numPoints == 0 ) return -1;
+
+	int maxDistSq = maxDist*maxDist;
+
+	// the range of cells that could hold something within maxDist
+	int col0 = getCol(viewX - maxDist);
+	int col1 = getCol(viewX + maxDist);
+	int row0 = getRow(viewY - maxDist);
+	int row1 = getRow(viewY + maxDist);
+	if ( col0 < 0 ) col0 = 0;
+	if ( row0 < 0 ) row0 = 0;
+	if ( col1 >= m_numCols ) col1 = m_numCols-1;
+	if ( row1 >= m_numRows ) row1 = m_numRows-1;
+
+	int closestId = -1;
+	int closestDistSq = 0;
+	for ( int row=row0 ; row<=row1 ; row++ )
+	{
+		for ( int col=col0 ; col<=col1 ; col++ )
+		{
+			int cell = row*m_numCols + col;
+			for ( int e=m_cellStart[cell] ; e<m_cellStart[cell+1] ; e++ )
+			{
+				// the cells grow when the points are spread out, so one can be a long
+				// way off. Squaring that would overflow, so it's ruled out first.
+				int dx = viewX - m_x[e];
+				int dy = viewY - m_y[e];
+				if ( (dx >= maxDist) || (dx <= -maxDist) || (dy >= maxDist) || (dy <= -maxDist) ) continue;
+				int distSq = dx*dx + dy*dy;
+				if ( distSq >= maxDistSq ) continue;
+
+				if ( (closestId == -1) || (distSq < closestDistSq) || ((distSq == closestDistSq) && (m_id[e] < closestId)) )
+				{
+					closestDistSq = distSq;
+					closestId = m_id[e];
+				}
+			}
+		}
+	}
+
+	return closestId;
+}
@@ -0,0 +1,48 @@
+
+#ifndef __POINTGRID__
+#define __POINTGRID__
+
+// a uniform grid over a set of view-space points. Used for hit-testing,
+// so a nearest point query only has to look at the cells around the mouse
+// instead of every point on the path.
+class PointGrid
+{
+public:
+	PointGrid();
+	~PointGrid();
+
+	// throw away the grid
+	void clear();
+
+	// build the grid over count points. The ids handed back by findNearest
+	// are the indices in to these arrays. cellSize is in pixels, and is best
+	// set to the largest distance you'll be querying with.
+	void build(const int *viewX, const int *viewY, int count, int cellSize);
+
+	// find the point nearest to viewX, viewY that is strictly closer than maxDist.
+	// Returns -1 if there is no such point. Ties go to the lowest id, which
+	// matches what a linear scan would have returned.
+	int findNearest(int viewX, int viewY, int maxDist);
+
+	int getNumPoints() { return m_numPoints; }
+
+private:
+	int getCol(int viewX);
+	int getRow(int viewY);
+
+	// grid layout
+	int m_minX;
+	int m_minY;
+	int m_cellSize;
+	int m_numCols;
+	int m_numRows;
+
+	// the points, sorted by cell. Cell c owns entries m_cellStart[c] to m_cellStart[c+1]-1
+	int *m_cellStart;
+	int *m_x;
+	int *m_y;
+	int *m_id;
+	int m_numPoints;
+};
+
+#endif
@@ -0,0 +1,155 @@
+
+#include "Polyline.h"
+#include <stddef.h>
+
+Polyline::Polyline()
+{
+	m_x = NULL;
+	m_y = NULL;
+	m_numPoints = 0;
+	m_workX = NULL;
+	m_workY = NULL;
+	m_keep = NULL;
+	m_stack = NULL;
+	m_capacity = 0;
+}
+
+Polyline::~Polyline()
+{
+	delete[] m_x;
+	delete[] m_y;
+	delete[] m_workX;
+	delete[] m_workY;
+	delete[] m_keep;
+	delete[] m_stack;
+}
+
+void Polyline::clear()
+{
+	m_numPoints = 0;
+}
+
+void Polyline::reserve(int count)
+{
+	if ( count <= m_capacity ) return;
+
+	delete[] m_x;
+	delete[] m_y;
+	delete[] m_workX;
+	delete[] m_workY;
+	delete[] m_keep;
+	delete[] m_stack;
+	m_x = new int[count];
+	m_y = new int[count];
+	m_workX = new int[count];
+	m_workY = new int[count];
+	m_keep = new bool[count];
+	m_stack = new int[count*2];
+	m_capacity = count;
+}
+
+void Polyline::build(const int *viewX, const int *viewY, int count, double tolerance)
+{
+	clear();
+	if ( count <= 0 ) return;
+	reserve(count);
+
+	// drop the points that land on the same pixel as the one before
+	int numWork = 0;
+	for ( int i=0 ; i<count ; i++ )
+	{
+		if ( (numWork > 0) && (viewX[i] == m_workX[numWork-1]) && (viewY[i] == m_workY[numWork-1]) ) continue;
+
+		m_workX[numWork] = viewX[i];
+		m_workY[numWork] = viewY[i];
+		m_keep[numWork] = false;
+		numWork++;
+	}
+
+	// then simplify what's left. The ends always stay.
+	m_keep[0] = true;
+	m_keep[numWork-1] = true;
+	simplify(0, numWork-1, tolerance*tolerance);
+
+	for ( int i=0 ; i<numWork ; i++ )
+	{
+		if ( !m_keep[i] ) continue;
+
+		m_x[m_numPoints] = m_workX[i];
+		m_y[m_numPoints] = m_workY[i];
+		m_numPoints++;
+	}
+}
+
+void Polyline::simplify(int first, int last, double toleranceSq)
+{
+	// Douglas-Peucker, with our own stack of ranges so a long line can't
+	// run the real one out
+	int stackSize = 0;
+	m_stack[stackSize++] = first;
+	m_stack[stackSize++] = last;
+	while ( stackSize > 0 )
+	{
+		int b = m_stack[--stackSize];
+		int a = m_stack[--stackSize];
+		if ( b - a < 2 ) continue;
+
+		// find the point furthest from the segment a-b. Past either end, that's
+		// the distance to the end, so a line that doubles back keeps its turn.
+		// If a and b are the same pixel (a closed orbit), it's just the furthest from a.
+		double ax = (double)m_workX[a];
+		double ay = (double)m_workY[a];
+		double dx = (double)m_workX[b] - ax;
+		double dy = (double)m_workY[b] - ay;
+		double lenSq = dx*dx + dy*dy;
+
+		int furthest = -1;
+		double furthestDistSq = toleranceSq;
+		for ( int i=a+1 ; i<b ; i++ )
+		{
+			double px = (double)m_workX[i] - ax;
+			double py = (double)m_workY[i] - ay;
+			double along = px*dx + py*dy;
+			double distSq;
+			if ( along <= 0.0 )
+			{
+				distSq = px*px + py*py;
+			}
+			else if ( along >= lenSq )
+			{
+				double qx = px - dx;
+				double qy = py - dy;
+				distSq = qx*qx + qy*qy;
+			}
+			else
+			{
+				double cross = px*dy - py*dx;
+				distSq = cross*cross/lenSq;
+			}
+
+			if ( distSq > furthestDistSq )
+			{
+				furthestDistSq = distSq;
+				furthest = i;
+			}
+		}
+
+		// everything between is close enough to the line, so it all goes
+		if ( furthest == -1 ) continue;
+
+		// otherwise keep that one, and look at either side of it
+		m_keep[furthest] = true;
+		m_stack[stackSize++] = a;
+		m_stack[stackSize++] = furthest;
+		m_stack[stackSize++] = furthest;
+		m_stack[stackSize++] = b;
+	}
+}
+
+void Polyline::drawSelf(FGGraphics &g)
+{
+	for ( int i=1 ; i<m_numPoints ; i++ )
+	{
+		g.drawLine(m_x[i-1], m_y[i-1], m_x[i], m_y[i]);
+	}
+}
@@ -0,0 +1,50 @@
+
+#ifndef __POLYLINE__
+#define __POLYLINE__
+
+#include "FGGraphics.h"
+
+// how far (in pixels) a dropped point can be from the line that replaces it
+#define POLYLINE_DEFAULT_TOLERANCE 0.5
+
+// A line through view-space points, simplified for drawing. Points that land on
+// the same pixel as the one before are dropped, then Douglas-Peucker removes any
+// that are within the tolerance of the line between their neighbours. Build it
+// when the points or the view change and draw it as often as you like.
+class Polyline
+{
+public:
+	Polyline();
+	~Polyline();
+
+	void clear();
+
+	// simplify count points. tolerance is in pixels. Keep it under a pixel and the
+	// line looks the same as drawing every point.
+	void build(const int *viewX, const int *viewY, int count, double tolerance);
+
+	void drawSelf(FGGraphics &g);
+
+	int getNumPoints() { return m_numPoints; }
+	int getX(int idx) { return m_x[idx]; }
+	int getY(int idx) { return m_y[idx]; }
+
+private:
+	void reserve(int count);
+	void simplify(int first, int last, double toleranceSq);
+
+	// the kept points
+	int *m_x;
+	int *m_y;
+	int m_numPoints;
+
+	// working space: the deduped points, which of them we keep, and the
+	// ranges still to look at
+	int *m_workX;
+	int *m_workY;
+	bool *m_keep;
+	int *m_stack;
+	int m_capacity;
+};
+
+#endif
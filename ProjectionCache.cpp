@@ -0,0 +1,180 @@
+
+#include "ProjectionCache.h"
+#include <stddef.h>
+
+// floor division, for tiles left of or above the origin
+static int getTile(int levelPixel)
+{
+	if ( levelPixel < 0 ) return (levelPixel - PROJECTION_TILE_SIZE + 1)/PROJECTION_TILE_SIZE;
+	return levelPixel/PROJECTION_TILE_SIZE;
+}
+
+ProjectionCache::ProjectionCache()
+{
+	m_drawCount = 0;
+}
+
+ProjectionCache::~ProjectionCache()
+{
+	clearLevels();
+}
+
+void ProjectionCache::clearLevels()
+{
+	for ( ProjectionLevelIter iter = m_levels.begin() ; iter != m_levels.end() ; iter++ )
+	{
+		delete *iter;
+	}
+	m_levels.clear();
+}
+
+void ProjectionCache::clear()
+{
+	clearLevels();
+	m_modelX.clear();
+	m_modelY.clear();
+}
+
+void ProjectionCache::setPoints(const double *modelX, const double *modelY, int count)
+{
+	clearLevels();
+	m_modelX.assign(modelX, modelX + count);
+	m_modelY.assign(modelY, modelY + count);
+}
+
+void ProjectionCache::setPoints(ProjectionCache &other)
+{
+	clearLevels();
+	m_modelX = other.m_modelX;
+	m_modelY = other.m_modelY;
+}
+
+ProjectionLevel *ProjectionCache::getLevel(OBView &view)
+{
+	double kmPerPixel = view.m_kmPerPixel;
+
+	// have we drawn at this zoom lately?
+	for ( ProjectionLevelIter iter = m_levels.begin() ; iter != m_levels.end() ; iter++ )
+	{
+		ProjectionLevel *level = *iter;
+		if ( level->m_kmPerPixel == kmPerPixel )
+		{
+			m_levels.erase(iter);
+			m_levels.push_front(level);
+			return level;
+		}
+	}
+
+	// no. Make it, and make room for it.
+	ProjectionLevel *level = new ProjectionLevel();
+	level->m_kmPerPixel = kmPerPixel;
+	buildLevel(level, view);
+	m_levels.push_front(level);
+	while ( (int)m_levels.size() > PROJECTION_MAX_LEVELS )
+	{
+		delete m_levels.back();
+		m_levels.pop_back();
+	}
+	return level;
+}
+
+void ProjectionCache::buildLevel(ProjectionLevel *level, OBView &view)
+{
+	// project in to level pixels and simplify
+	int count = (int)m_modelX.size();
+	int *levelX = new int[count];
+	int *levelY = new int[count];
+	for ( int i=0 ; i<count ; i++ )
+	{
+		levelX[i] = view.modelToLevelX(m_modelX[i]);
+		levelY[i] = view.modelToLevelY(m_modelY[i]);
+	}
+	level->m_line.build(levelX, levelY, count, POLYLINE_DEFAULT_TOLERANCE);
+	delete[] levelX;
+	delete[] levelY;
+
+	// put each segment in the tiles its bounds cover
+	Polyline &line = level->m_line;
+	int numSegments = line.getNumPoints() - 1;
+	for ( int i=0 ; i<numSegments ; i++ )
+	{
+		int x0 = line.getX(i);
+		int y0 = line.getY(i);
+		int x1 = line.getX(i+1);
+		int y1 = line.getY(i+1);
+		int firstTileX = getTile((x0 < x1) ? x0 : x1);
+		int lastTileX = getTile((x0 < x1) ? x1 : x0);
+		int firstTileY = getTile((y0 < y1) ? y0 : y1);
+		int lastTileY = getTile((y0 < y1) ? y1 : y0);
+
+		if ( (long long)(lastTileX - firstTileX + 1)*(lastTileY - firstTileY + 1) > PROJECTION_MAX_TILES_PER_SEGMENT )
+		{
+			level->m_bigSegments.push_back(i);
+			continue;
+		}
+
+		for ( int tileX=firstTileX ; tileX<=lastTileX ; tileX++ )
+		{
+			for ( int tileY=firstTileY ; tileY<=lastTileY ; tileY++ )
+			{
+				level->m_tiles[getTileKey(tileX, tileY)].push_back(i);
+			}
+		}
+	}
+}
+
+void ProjectionCache::drawSelf(FGGraphics &g, OBView &view)
+{
+	if ( m_modelX.size() < 2 ) return;
+
+	ProjectionLevel *level = getLevel(view);
+	Polyline &line = level->m_line;
+	int numSegments = line.getNumPoints() - 1;
+	if ( numSegments < 1 ) return;
+
+	// a new draw
+	m_drawCount++;
+	if ( (int)m_drawnIn.size() < numSegments ) m_drawnIn.resize(numSegments, 0);
+
+	// the screen, in level pixels
+	int originX = view.getViewOriginX();
+	int originY = view.getViewOriginY();
+	int minX = originX;
+	int minY = originY;
+	int maxX = originX + view.m_screenW;
+	int maxY = originY + view.m_screenH;
+
+	// the segments in the tiles on screen
+	for ( int tileX=getTile(minX) ; tileX<=getTile(maxX) ; tileX++ )
+	{
+		for ( int tileY=getTile(minY) ; tileY<=getTile(maxY) ; tileY++ )
+		{
+			std::map<long long, std::vector<int> >::iterator found = level->m_tiles.find(getTileKey(tileX, tileY));
+			if ( found == level->m_tiles.end() ) continue;
+
+			std::vector<int> &segments = found->second;
+			for ( int s=0 ; s<(int)segments.size() ; s++ )
+			{
+				int i = segments[s];
+				if ( m_drawnIn[i] == m_drawCount ) continue;
+				m_drawnIn[i] = m_drawCount;
+				g.drawLine(line.getX(i) - originX, line.getY(i) - originY, line.getX(i+1) - originX, line.getY(i+1) - originY);
+			}
+		}
+	}
+
+	// and the big ones, if they're anywhere near the screen
+	for ( int s=0 ; s<(int)level->m_bigSegments.size() ; s++ )
+	{
+		int i = level->m_bigSegments[s];
+		int x0 = line.getX(i);
+		int y0 = line.getY(i);
+		int x1 = line.getX(i+1);
+		int y1 = line.getY(i+1);
+		if ( (x0 < minX) && (x1 < minX) ) continue;
+		if ( (x0 > maxX) && (x1 > maxX) ) continue;
+		if ( (y0 < minY) && (y1 < minY) ) continue;
+		if ( (y0 > maxY) && (y1 > maxY) ) continue;
+		g.drawLine(x0 - originX, y0 - originY, x1 - originX, y1 - originY);
+	}
+}
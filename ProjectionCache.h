@@ -0,0 +1,75 @@
+
+#ifndef __PROJECTIONCACHE__
+#define __PROJECTIONCACHE__
+
+#include "FGGraphics.h"
+#include "Polyline.h"
+#include "OBView.h"
+#include <list>
+#include <map>
+#include <vector>
+
+// the tiles are this many pixels on a side
+#define PROJECTION_TILE_SIZE 256
+
+// how many zoom levels a line keeps before dropping the least recently drawn
+#define PROJECTION_MAX_LEVELS 6
+
+// a segment that covers more tiles than this goes on a list that's checked
+// against the screen every draw, instead of in to every tile it crosses
+#define PROJECTION_MAX_TILES_PER_SEGMENT 16
+
+// One zoom level of a line. The points are in level pixels, which is model space
+// divided by the zoom's km per pixel, so panning never changes them. Each tile
+// notes the segments that cross it, so drawing only looks at the tiles on screen.
+class ProjectionLevel
+{
+public:
+	double m_kmPerPixel;
+	Polyline m_line;
+	std::map<long long, std::vector<int> > m_tiles; // tile key -> segments (segment i runs from point i to i+1)
+	std::vector<int> m_bigSegments;
+};
+
+typedef std::list<ProjectionLevel *> ProjectionLevelList;
+typedef ProjectionLevelList::iterator ProjectionLevelIter;
+
+// A line through model-space points, drawn at any zoom and pan. The model points are
+// kept, and each zoom level is projected and simplified the first time it's drawn,
+// then kept. So zooming back and forth and panning don't rebuild anything.
+class ProjectionCache
+{
+public:
+	ProjectionCache();
+	~ProjectionCache();
+
+	// note the model-space points. This drops every zoom level.
+	void setPoints(const double *modelX, const double *modelY, int count);
+	void setPoints(ProjectionCache &other);
+	void clear();
+
+	int getNumPoints() { return (int)m_modelX.size(); }
+
+	// draw with the view's current zoom and pan
+	void drawSelf(FGGraphics &g, OBView &view);
+
+private:
+	void clearLevels();
+	ProjectionLevel *getLevel(OBView &view);
+	void buildLevel(ProjectionLevel *level, OBView &view);
+	static long long getTileKey(int tileX, int tileY) { return ((long long)tileX << 32) | (unsigned int)tileY; }
+
+	// the line in model space
+	std::vector<double> m_modelX;
+	std::vector<double> m_modelY;
+
+	// the zoom levels, most recently drawn at the front
+	ProjectionLevelList m_levels;
+
+	// which draw each segment was last drawn in, so one that crosses several
+	// tiles on screen only gets drawn once
+	std::vector<unsigned int> m_drawnIn;
+	unsigned int m_drawCount;
+};
+
+#endif
@@ -0,0 +1,187 @@
+
+#include "RecomputeGraph.h"
+#include <stddef.h>
+
+RecomputeGraph::RecomputeGraph()
+{
+	m_nextTask = 0;
+	m_tasksLeft = 0;
+	m_bStopping = false;
+}
+
+RecomputeGraph::~RecomputeGraph()
+{
+	stop();
+
+	for ( int i=0 ; i<(int)m_nodes.size() ; i++ )
+	{
+		delete m_nodes[i];
+	}
+	m_nodes.clear();
+}
+
+void RecomputeGraph::start(int numThreads)
+{
+	stop();
+
+	// we're one of the threads
+	m_bStopping = false;
+	for ( int i=1 ; i<numThreads ; i++ )
+	{
+		m_workers.push_back(std::thread(&RecomputeGraph::workerMain, this));
+	}
+}
+
+void RecomputeGraph::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+		m_wake.notify_all();
+	}
+
+	for ( int i=0 ; i<(int)m_workers.size() ; i++ )
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+}
+
+RecomputeNode *RecomputeGraph::addNode(const char *name, RecomputeFunc func, void *context)
+{
+	RecomputeNode *node = new RecomputeNode();
+	node->m_name = name;
+	node->m_func = func;
+	node->m_context = context;
+	node->m_bDirty = false;
+	m_nodes.push_back(node);
+	return node;
+}
+
+void RecomputeGraph::addDependency(RecomputeNode *node, RecomputeNode *dependsOn)
+{
+	node->m_dependsOn.push_back(dependsOn);
+	dependsOn->m_dependents.push_back(node);
+}
+
+void RecomputeGraph::markDirty(RecomputeNode *node)
+{
+	// if it's already dirty, so is everything after it
+	if ( node->m_bDirty ) return;
+
+	node->m_bDirty = true;
+	for ( int i=0 ; i<(int)node->m_dependents.size() ; i++ )
+	{
+		markDirty(node->m_dependents[i]);
+	}
+}
+
+void RecomputeGraph::markAllDirty()
+{
+	for ( int i=0 ; i<(int)m_nodes.size() ; i++ )
+	{
+		m_nodes[i]->m_bDirty = true;
+	}
+}
+
+void RecomputeGraph::update()
+{
+	// a wave at a time. A dirty node is ready once nothing it depends on is dirty,
+	// and nothing in a wave depends on anything else in it.
+	std::vector<RecomputeNode *> ready;
+	while ( true )
+	{
+		ready.clear();
+		for ( int i=0 ; i<(int)m_nodes.size() ; i++ )
+		{
+			RecomputeNode *node = m_nodes[i];
+			if ( !node->m_bDirty ) continue;
+
+			bool bReady = true;
+			for ( int d=0 ; d<(int)node->m_dependsOn.size() ; d++ )
+			{
+				if ( node->m_dependsOn[d]->m_bDirty )
+				{
+					bReady = false;
+					break;
+				}
+			}
+			if ( bReady ) ready.push_back(node);
+		}
+
+		// all done. (Or there's a cycle, and the nodes in it never get to go.)
+		if ( ready.empty() ) break;
+
+		runWave(ready);
+		for ( int i=0 ; i<(int)ready.size() ; i++ )
+		{
+			ready[i]->m_bDirty = false;
+		}
+	}
+}
+
+void RecomputeGraph::runWave(std::vector<RecomputeNode *> &wave)
+{
+	// not worth waking anyone for one node
+	if ( (wave.size() == 1) || m_workers.empty() )
+	{
+		for ( int i=0 ; i<(int)wave.size() ; i++ )
+		{
+			wave[i]->m_func(wave[i]->m_context);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_wave = wave;
+		m_nextTask = 0;
+		m_tasksLeft = (int)m_wave.size();
+		m_wake.notify_all();
+	}
+
+	// help out, then wait for the stragglers
+	runTasks();
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while ( m_tasksLeft > 0 )
+	{
+		m_waveDone.wait(lock);
+	}
+	m_wave.clear();
+}
+
+void RecomputeGraph::runTasks()
+{
+	while ( true )
+	{
+		RecomputeNode *node;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if ( m_nextTask >= (int)m_wave.size() ) return;
+			node = m_wave[m_nextTask++];
+		}
+
+		node->m_func(node->m_context);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasksLeft--;
+		if ( m_tasksLeft == 0 ) m_waveDone.notify_all();
+	}
+}
+
+void RecomputeGraph::workerMain()
+{
+	while ( true )
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while ( !m_bStopping && (m_nextTask >= (int)m_wave.size()) )
+			{
+				m_wake.wait(lock);
+			}
+			if ( m_bStopping ) return;
+		}
+
+		runTasks();
+	}
+}
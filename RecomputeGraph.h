@@ -0,0 +1,68 @@
+
+#ifndef __RECOMPUTEGRAPH__
+#define __RECOMPUTEGRAPH__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// does the work for a node. context is whatever the node was added with.
+typedef void (*RecomputeFunc)(void *context);
+
+class RecomputeNode
+{
+public:
+	const char *m_name;
+	RecomputeFunc m_func;
+	void *m_context;
+	bool m_bDirty;
+	std::vector<RecomputeNode *> m_dependsOn;  // these have to be done before we are
+	std::vector<RecomputeNode *> m_dependents; // and these are stale when we change
+};
+
+// What has to be worked out again when something changes. Each node is a piece of
+// derived state (a path, the ship's events) and knows what it's worked out from.
+// Marking a node dirty marks everything downstream of it, and update() runs just
+// the dirty nodes, in order. Nodes that don't depend on each other run at the
+// same time on the worker threads, so they mustn't share anything they write.
+class RecomputeGraph
+{
+public:
+	RecomputeGraph();
+	~RecomputeGraph();
+
+	// start the workers. The thread calling update() works too, so numThreads
+	// of 1 runs everything on it.
+	void start(int numThreads);
+	void stop();
+
+	// a new node is taken to be up to date
+	RecomputeNode *addNode(const char *name, RecomputeFunc func, void *context);
+	void addDependency(RecomputeNode *node, RecomputeNode *dependsOn); // no cycles, please
+
+	void markDirty(RecomputeNode *node);
+	void markAllDirty();
+
+	// bring every dirty node up to date
+	void update();
+
+private:
+	void runWave(std::vector<RecomputeNode *> &wave);
+	void runTasks();
+	void workerMain();
+
+	std::vector<RecomputeNode *> m_nodes;
+
+	// workers, and the wave they're helping with
+	std::vector<std::thread> m_workers;
+	std::vector<RecomputeNode *> m_wave;
+	int m_nextTask;     // the next node in the wave to hand out
+	int m_tasksLeft;    // nodes in the wave not finished yet
+	bool m_bStopping;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_waveDone;
+};
+
+#endif
@@ -0,0 +1,178 @@
+
+#include <math.h>
+#include "StateTransition.h"
+
+void StateTransition::identity(double *out)
+{
+	for ( int i=0 ; i<16 ; i++ )
+	{
+		out[i] = 0.0;
+	}
+	out[0] = out[5] = out[10] = out[15] = 1.0;
+}
+
+void StateTransition::multiply(const double *a, const double *b, double *out)
+{
+	for ( int r=0 ; r<4 ; r++ )
+	{
+		for ( int c=0 ; c<4 ; c++ )
+		{
+			out[r*4+c] = a[r*4]*b[c] + a[r*4+1]*b[4+c] + a[r*4+2]*b[8+c] + a[r*4+3]*b[12+c];
+		}
+	}
+}
+
+bool StateTransition::invert(const double *m, double *out)
+{
+	// gauss-jordan with partial pivoting, on [m | I]
+	double work[4][8];
+	for ( int r=0 ; r<4 ; r++ )
+	{
+		for ( int c=0 ; c<4 ; c++ )
+		{
+			work[r][c] = m[r*4+c];
+			work[r][c+4] = (r == c) ? 1.0 : 0.0;
+		}
+	}
+
+	for ( int col=0 ; col<4 ; col++ )
+	{
+		// find the biggest pivot
+		int pivot = col;
+		for ( int r=col+1 ; r<4 ; r++ )
+		{
+			if ( fabs(work[r][col]) > fabs(work[pivot][col]) ) pivot = r;
+		}
+		if ( work[pivot][col] == 0.0 ) return false;
+
+		if ( pivot != col )
+		{
+			for ( int c=0 ; c<8 ; c++ )
+			{
+				double t = work[col][c];
+				work[col][c] = work[pivot][c];
+				work[pivot][c] = t;
+			}
+		}
+
+		double scale = 1.0/work[col][col];
+		for ( int c=0 ; c<8 ; c++ )
+		{
+			work[col][c] *= scale;
+		}
+
+		for ( int r=0 ; r<4 ; r++ )
+		{
+			if ( r == col ) continue;
+			double f = work[r][col];
+			if ( f == 0.0 ) continue;
+			for ( int c=0 ; c<8 ; c++ )
+			{
+				work[r][c] -= f*work[col][c];
+			}
+		}
+	}
+
+	for ( int r=0 ; r<4 ; r++ )
+	{
+		for ( int c=0 ; c<4 ; c++ )
+		{
+			out[r*4+c] = work[r][c+4];
+		}
+	}
+	return true;
+}
+
+void StateTransition::eulerStepJacobian(double px, double py, double vx, double vy,
+	double cx, double cy, double sgp,
+	bool bThrust, double rotX, double rotY, bool bRedirect, double dt, double *outJ)
+{
+	// the vector to the body
+	double ux = cx - px;
+	double uy = cy - py;
+	double distSq = ux*ux + uy*uy;
+	double dist = sqrt(distSq);
+
+	// the gravity gradient: d(accel)/d(pos) = sgp*(3uu'/d^5 - I/d^3)
+	double d3 = distSq*dist;
+	double d5 = d3*distSq;
+	double a00 = sgp*(3.0*ux*ux/d5 - 1.0/d3);
+	double a01 = sgp*(3.0*ux*uy/d5);
+	double a11 = sgp*(3.0*uy*uy/d5 - 1.0/d3);
+	double a10 = a01;
+
+	// the thrust, and how it turns as we move: T = R*u/d, where R is the rotation
+	// scaled by the magnitude, so d(T)/d(pos) = -R*(I/d - uu'/d^3)
+	double tx = 0.0;
+	double ty = 0.0;
+	double t00 = 0.0, t01 = 0.0, t10 = 0.0, t11 = 0.0;
+	if ( bThrust && (dist > 0.0) )
+	{
+		double c = rotX;
+		double s = rotY;
+		tx = (ux*c - uy*s)/dist;
+		ty = (ux*s + uy*c)/dist;
+
+		double n00 = 1.0/dist - ux*ux/d3;
+		double n01 = -ux*uy/d3;
+		double n11 = 1.0/dist - uy*uy/d3;
+		t00 = -(c*n00 - s*n01);
+		t01 = -(c*n01 - s*n11);
+		t10 = -(s*n00 + c*n01);
+		t11 = -(s*n01 + c*n11);
+	}
+
+	// the kick. v1 = v + (gravity + thrust)*dt
+	double gx = ux*sgp/d3;
+	double gy = uy*sgp/d3;
+	double v1x = vx + (gx + tx)*dt;
+	double v1y = vy + (gy + ty)*dt;
+
+	// d(v2)/d(pos) and d(v2)/d(vel), where v2 is the velocity we move with
+	double vp00 = (a00 + t00)*dt, vp01 = (a01 + t01)*dt;
+	double vp10 = (a10 + t10)*dt, vp11 = (a11 + t11)*dt;
+	double vv00 = 1.0, vv01 = 0.0, vv10 = 0.0, vv11 = 1.0;
+
+	if ( bRedirect )
+	{
+		double speed = sqrt(v1x*v1x + v1y*v1y);
+		double thrustLen = sqrt(tx*tx + ty*ty);
+		double sx = (speed > 0.0) ? v1x/speed : 0.0;
+		double sy = (speed > 0.0) ? v1y/speed : 0.0;
+
+		// the redirect as a function of v1: the speed goes along the thrust (or along x)
+		double hx = 1.0, hy = 0.0;
+		if ( thrustLen > 0.0 )
+		{
+			hx = tx/thrustLen;
+			hy = ty/thrustLen;
+		}
+		double r00 = hx*sx, r01 = hx*sy;
+		double r10 = hy*sx, r11 = hy*sy;
+
+		// and as a function of the thrust direction: speed/|T|*(I - hh')
+		double q00 = 0.0, q01 = 0.0, q10 = 0.0, q11 = 0.0;
+		if ( thrustLen > 0.0 )
+		{
+			double k = speed/thrustLen;
+			q00 = k*(1.0 - hx*hx);
+			q01 = -k*hx*hy;
+			q10 = q01;
+			q11 = k*(1.0 - hy*hy);
+		}
+
+		// chain them together. v2 depends on pos through v1 and through the thrust.
+		double n00 = r00*vp00 + r01*vp10 + q00*t00 + q01*t10;
+		double n01 = r00*vp01 + r01*vp11 + q00*t01 + q01*t11;
+		double n10 = r10*vp00 + r11*vp10 + q10*t00 + q11*t10;
+		double n11 = r10*vp01 + r11*vp11 + q10*t01 + q11*t11;
+		vp00 = n00; vp01 = n01; vp10 = n10; vp11 = n11;
+		vv00 = r00; vv01 = r01; vv10 = r10; vv11 = r11;
+	}
+
+	// the drift. pos2 = pos + v2*dt
+	outJ[0] = 1.0 + vp00*dt; outJ[1] = vp01*dt;       outJ[2] = vv00*dt;  outJ[3] = vv01*dt;
+	outJ[4] = vp10*dt;       outJ[5] = 1.0 + vp11*dt; outJ[6] = vv10*dt;  outJ[7] = vv11*dt;
+	outJ[8] = vp00;          outJ[9] = vp01;          outJ[10] = vv00;    outJ[11] = vv01;
+	outJ[12] = vp10;         outJ[13] = vp11;         outJ[14] = vv10;    outJ[15] = vv11;
+}
@@ -0,0 +1,29 @@
+
+#ifndef __STATETRANSITION__
+#define __STATETRANSITION__
+
+// Helpers for state transition matrices. The state is the planar (x, y, vx, vy),
+// so the matrices are 4x4, stored row major in 16 doubles. A state transition
+// matrix says how a small change in an earlier state moves a later one.
+class StateTransition
+{
+public:
+	static void identity(double *out);
+
+	// out = a*b. out can't be a or b.
+	static void multiply(const double *a, const double *b, double *out);
+
+	// returns false if m is singular
+	static bool invert(const double *m, double *out);
+
+	// The jacobian of one EulerIntegrator step, starting from pos/vel, around a body at
+	// center. bThrust is false when there is no acceleration point governing the step.
+	// rotX, rotY are the acceleration point's rotation, see AccelerationPoint.
+	// This is the exact derivative of the discrete step, not of the continuous motion,
+	// so it matches the points the path actually has.
+	static void eulerStepJacobian(double px, double py, double vx, double vy,
+		double cx, double cy, double sgp,
+		bool bThrust, double rotX, double rotY, bool bRedirect, double dt, double *outJ);
+};
+
+#endif
@@ -0,0 +1,481 @@
+
+#ifndef _WIN32
+
+#include "Sweep.h"
+#include "OBScenario.h"
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
+// little endian byte helpers, so the files are the same on any machine
+static void putInt(unsigned char *out, int value)
+{
+	for ( int i=0 ; i<4 ; i++ )
+	{
+		out[i] = (unsigned char)(((unsigned int)value >> (i*8)) & 0xff);
+	}
+}
+
+static void putLong(unsigned char *out, long long value)
+{
+	for ( int i=0 ; i<8 ; i++ )
+	{
+		out[i] = (unsigned char)(((unsigned long long)value >> (i*8)) & 0xff);
+	}
+}
+
+static void putDouble(unsigned char *out, double value)
+{
+	long long bits;
+	memcpy(&bits, &value, 8);
+	putLong(out, bits);
+}
+
+static long long getLong(const unsigned char *data)
+{
+	unsigned long long value = 0;
+	for ( int i=0 ; i<8 ; i++ )
+	{
+		value |= ((unsigned long long)data[i]) << (i*8);
+	}
+	return (long long)value;
+}
+
+SweepSpec::SweepSpec()
+{
+	m_firstDepart = 0;
+	m_numDeparts = 1;
+	m_departStep = 1;
+	m_numAngles = 1;
+	m_firstAngle = 0.0;
+	m_angleStep = 0.0;
+	m_firstBurn = 0;
+	m_numBurns = 1;
+	m_burnStep = 1;
+}
+
+bool SweepSpec::load(const char *filename)
+{
+	FILE *f = fopen(filename, "r");
+	if ( f == NULL ) return false;
+
+	int numRead = fscanf(f, "%d %d %d %d %lf %lf %d %d %d",
+		&m_firstDepart, &m_numDeparts, &m_departStep,
+		&m_numAngles, &m_firstAngle, &m_angleStep,
+		&m_firstBurn, &m_numBurns, &m_burnStep);
+	fclose(f);
+	if ( numRead != 9 ) return false;
+
+	// every departure has to be on the path
+	if ( (m_numDeparts < 1) || (m_numAngles < 1) || (m_numBurns < 1) ) return false;
+	if ( (m_departStep < 0) || (m_burnStep < 0) || (m_firstBurn < 0) ) return false;
+	int lastDepart = m_firstDepart + (m_numDeparts-1)*m_departStep;
+	if ( (m_firstDepart < 0) || (lastDepart >= PATH_NUM_POINTS) ) return false;
+	return true;
+}
+
+long long SweepSpec::getNumCells()
+{
+	return (long long)m_numDeparts*m_numAngles*m_numBurns;
+}
+
+void SweepSpec::getCell(long long cellIdx, int &outDepartIdx, double &outAngle, int &outBurnDays)
+{
+	long long perDepart = (long long)m_numAngles*m_numBurns;
+	int d = (int)(cellIdx/perDepart);
+	int a = (int)((cellIdx%perDepart)/m_numBurns);
+	int b = (int)(cellIdx%m_numBurns);
+	outDepartIdx = m_firstDepart + d*m_departStep;
+	outAngle = m_firstAngle + (double)a*m_angleStep;
+	outBurnDays = m_firstBurn + b*m_burnStep;
+}
+
+Sweep::Sweep()
+{
+	memset(m_shipStart, 0, sizeof(m_shipStart));
+	memset(m_marsStart, 0, sizeof(m_marsStart));
+}
+
+Sweep::~Sweep()
+{
+}
+
+bool Sweep::init(const char *specFilename)
+{
+	if ( !m_spec.load(specFilename) ) return false;
+
+	// the ship and mars start where the app has them
+	OBScenario *scenario = new OBScenario();
+	scenario->init();
+	m_shipStart[0] = scenario->m_ship.m_startPos.m_fixX;
+	m_shipStart[1] = scenario->m_ship.m_startPos.m_fixY;
+	m_shipStart[2] = scenario->m_ship.m_startVel.m_fixX;
+	m_shipStart[3] = scenario->m_ship.m_startVel.m_fixY;
+	m_marsStart[0] = scenario->m_marsPath.m_startPos.m_fixX;
+	m_marsStart[1] = scenario->m_marsPath.m_startPos.m_fixY;
+	m_marsStart[2] = scenario->m_marsPath.m_startVel.m_fixX;
+	m_marsStart[3] = scenario->m_marsPath.m_startVel.m_fixY;
+	delete scenario;
+	return true;
+}
+
+void Sweep::getShardRange(int shardIdx, int numShards, long long &outFirst, long long &outCount)
+{
+	long long numCells = m_spec.getNumCells();
+	outFirst = numCells*shardIdx/numShards;
+	outCount = numCells*(shardIdx+1)/numShards - outFirst;
+}
+
+void Sweep::getShardFilename(const char *outDir, int shardIdx, int numShards, char *outFilename, int size)
+{
+	snprintf(outFilename, size, "%s/shard_%d_of_%d.dat", outDir, shardIdx, numShards);
+}
+
+void Sweep::makeHeader(long long firstCell, long long numCells, unsigned char *out)
+{
+	memset(out, 0, SWEEP_HEADER_SIZE);
+	putInt(&out[0], SWEEP_FILE_VERSION);
+	putInt(&out[4], m_spec.m_firstDepart);
+	putInt(&out[8], m_spec.m_numDeparts);
+	putInt(&out[12], m_spec.m_departStep);
+	putInt(&out[16], m_spec.m_numAngles);
+	putDouble(&out[20], m_spec.m_firstAngle);
+	putDouble(&out[28], m_spec.m_angleStep);
+	putInt(&out[36], m_spec.m_firstBurn);
+	putInt(&out[40], m_spec.m_numBurns);
+	putInt(&out[44], m_spec.m_burnStep);
+	putLong(&out[48], firstCell);
+	putLong(&out[56], numCells);
+}
+
+bool Sweep::checkHeader(FILE *f, long long firstCell, long long numCells)
+{
+	unsigned char expected[SWEEP_HEADER_SIZE];
+	unsigned char header[SWEEP_HEADER_SIZE];
+	makeHeader(firstCell, numCells, expected);
+	if ( fread(header, 1, SWEEP_HEADER_SIZE, f) != SWEEP_HEADER_SIZE ) return false;
+	return memcmp(header, expected, SWEEP_HEADER_SIZE) == 0;
+}
+
+long long Sweep::resumeShard(const char *filename, long long firstCell, long long numCells)
+{
+	FILE *f = fopen(filename, "rb");
+	if ( f == NULL ) return -1;
+
+	// it has to be for this sweep and this shard
+	if ( !checkHeader(f, firstCell, numCells) )
+	{
+		fclose(f);
+		return -1;
+	}
+
+	// count the whole records. A run that was stopped might have left part of one.
+	fseek(f, 0, SEEK_END);
+	long long size = (long long)ftell(f);
+	long long numDone = (size - SWEEP_HEADER_SIZE)/SWEEP_RECORD_SIZE;
+	if ( numDone > numCells ) numDone = numCells;
+
+	// and the last one has to be the cell we think it is
+	if ( numDone > 0 )
+	{
+		unsigned char record[SWEEP_RECORD_SIZE];
+		fseek(f, (long)(SWEEP_HEADER_SIZE + (numDone-1)*SWEEP_RECORD_SIZE), SEEK_SET);
+		if ( (fread(record, 1, SWEEP_RECORD_SIZE, f) != SWEEP_RECORD_SIZE) || (getLong(record) != firstCell+numDone-1) )
+		{
+			fclose(f);
+			return -1;
+		}
+	}
+	fclose(f);
+
+	// drop anything after the last whole record
+	if ( truncate(filename, (off_t)(SWEEP_HEADER_SIZE + numDone*SWEEP_RECORD_SIZE)) != 0 ) return -1;
+	return numDone;
+}
+
+void Sweep::runChunk(traj_context *ctx, long long firstCell, int count, unsigned char *out)
+{
+	// the inputs, a cell at a time
+	double shipPosX[SWEEP_CHUNK_CELLS], shipPosY[SWEEP_CHUNK_CELLS], shipVelX[SWEEP_CHUNK_CELLS], shipVelY[SWEEP_CHUNK_CELLS];
+	double marsPosX[SWEEP_CHUNK_CELLS], marsPosY[SWEEP_CHUNK_CELLS], marsVelX[SWEEP_CHUNK_CELLS], marsVelY[SWEEP_CHUNK_CELLS];
+	int accelFirst[SWEEP_CHUNK_CELLS+1];
+	int accelStep[SWEEP_CHUNK_CELLS*3];
+	int accelType[SWEEP_CHUNK_CELLS*3];
+	double accelAngle[SWEEP_CHUNK_CELLS*3];
+	double accelMag[SWEEP_CHUNK_CELLS*3];
+
+	int numAccel = 0;
+	for ( int i=0 ; i<count ; i++ )
+	{
+		shipPosX[i] = m_shipStart[0];
+		shipPosY[i] = m_shipStart[1];
+		shipVelX[i] = m_shipStart[2];
+		shipVelY[i] = m_shipStart[3];
+		marsPosX[i] = m_marsStart[0];
+		marsPosY[i] = m_marsStart[1];
+		marsVelX[i] = m_marsStart[2];
+		marsVelY[i] = m_marsStart[3];
+
+		int departIdx, burnDays;
+		double angle;
+		m_spec.getCell(firstCell+i, departIdx, angle, burnDays);
+
+		// coast with earth, burn, coast
+		accelFirst[i] = numAccel;
+		if ( departIdx > 0 )
+		{
+			accelStep[numAccel] = 0;
+			accelType[numAccel] = TRAJ_ACCEL_NORMAL;
+			accelAngle[numAccel] = 0.0;
+			accelMag[numAccel] = 0.0;
+			numAccel++;
+		}
+		if ( burnDays > 0 )
+		{
+			accelStep[numAccel] = departIdx;
+			accelType[numAccel] = TRAJ_ACCEL_NORMAL;
+			accelAngle[numAccel] = angle;
+			accelMag[numAccel] = PATH_ACCELERATION;
+			numAccel++;
+		}
+		if ( (burnDays > 0) && (departIdx+burnDays < PATH_NUM_POINTS) )
+		{
+			accelStep[numAccel] = departIdx+burnDays;
+			accelType[numAccel] = TRAJ_ACCEL_NORMAL;
+			accelAngle[numAccel] = 0.0;
+			accelMag[numAccel] = 0.0;
+			numAccel++;
+		}
+	}
+	accelFirst[count] = numAccel;
+
+	traj_batch_in in;
+	memset(&in, 0, sizeof(in));
+	in.count = count;
+	in.ship_pos_x = shipPosX;
+	in.ship_pos_y = shipPosY;
+	in.ship_vel_x = shipVelX;
+	in.ship_vel_y = shipVelY;
+	in.mars_pos_x = marsPosX;
+	in.mars_pos_y = marsPosY;
+	in.mars_vel_x = marsVelX;
+	in.mars_vel_y = marsVelY;
+	in.accel_first = accelFirst;
+	in.accel_step = accelStep;
+	in.accel_type = accelType;
+	in.accel_angle = accelAngle;
+	in.accel_mag = accelMag;
+	in.max_substeps = SWEEP_MAX_SUBSTEPS;
+
+	int status[SWEEP_CHUNK_CELLS], numPoints[SWEEP_CHUNK_CELLS], haltIdx[SWEEP_CHUNK_CELLS], soiFired[SWEEP_CHUNK_CELLS];
+	double soiTime[SWEEP_CHUNK_CELLS], closestDist[SWEEP_CHUNK_CELLS], closestTime[SWEEP_CHUNK_CELLS];
+	int substeps[SWEEP_CHUNK_CELLS];
+	double energyDrift[SWEEP_CHUNK_CELLS];
+	traj_batch_out results;
+	memset(&results, 0, sizeof(results));
+	results.status = status;
+	results.num_points = numPoints;
+	results.halt_idx = haltIdx;
+	results.soi_fired = soiFired;
+	results.soi_time = soiTime;
+	results.closest_dist = closestDist;
+	results.closest_time = closestTime;
+	results.substeps = substeps;
+	results.energy_drift = energyDrift;
+	traj_propagate_batch(ctx, &in, &results);
+
+	for ( int i=0 ; i<count ; i++ )
+	{
+		unsigned char *record = &out[i*SWEEP_RECORD_SIZE];
+		bool bOK = (status[i] == TRAJ_STATUS_OK);
+		putLong(&record[0], firstCell+i);
+		putInt(&record[8], status[i]);
+		putInt(&record[12], bOK ? numPoints[i] : 0);
+		putInt(&record[16], bOK ? haltIdx[i] : -1);
+		putInt(&record[20], bOK ? soiFired[i] : 0);
+		putDouble(&record[24], bOK ? soiTime[i] : 0.0);
+		putDouble(&record[32], bOK ? closestDist[i] : 0.0);
+		putDouble(&record[40], bOK ? closestTime[i] : 0.0);
+		putInt(&record[48], bOK ? substeps[i] : 0);
+		putDouble(&record[52], bOK ? energyDrift[i] : 0.0);
+	}
+}
+
+bool Sweep::runShard(const char *outDir, int shardIdx, int numShards, int numThreads)
+{
+	if ( (numShards < 1) || (shardIdx < 0) || (shardIdx >= numShards) ) return false;
+	if ( numThreads < 1 ) numThreads = 1;
+
+	long long firstCell, numCells;
+	getShardRange(shardIdx, numShards, firstCell, numCells);
+
+	char filename[1024];
+	getShardFilename(outDir, shardIdx, numShards, filename, sizeof(filename));
+
+	// pick up where we left off, or start again
+	long long numDone = resumeShard(filename, firstCell, numCells);
+	if ( numDone < 0 )
+	{
+		FILE *f = fopen(filename, "wb");
+		if ( f == NULL ) return false;
+		unsigned char header[SWEEP_HEADER_SIZE];
+		makeHeader(firstCell, numCells, header);
+		bool bWritten = (fwrite(header, 1, SWEEP_HEADER_SIZE, f) == SWEEP_HEADER_SIZE);
+		fclose(f);
+		if ( !bWritten ) return false;
+		numDone = 0;
+	}
+	if ( numDone == numCells ) return true;
+
+	FILE *f = fopen(filename, "r+b");
+	if ( f == NULL ) return false;
+	fseek(f, (long)(SWEEP_HEADER_SIZE + numDone*SWEEP_RECORD_SIZE), SEEK_SET);
+
+	// a context and a chunk of records for each thread
+	std::vector<traj_context *> contexts;
+	for ( int t=0 ; t<numThreads ; t++ )
+	{
+		traj_context *ctx = traj_create();
+		if ( ctx == NULL ) break;
+		contexts.push_back(ctx);
+	}
+	numThreads = (int)contexts.size();
+	if ( numThreads == 0 )
+	{
+		fclose(f);
+		return false;
+	}
+	std::vector<unsigned char> records((size_t)numThreads*SWEEP_CHUNK_CELLS*SWEEP_RECORD_SIZE);
+
+	bool bOK = true;
+	while ( bOK && (numDone < numCells) )
+	{
+		// a chunk each, as far as the cells go
+		long long roundFirst = firstCell + numDone;
+		int roundCount = 0;
+		int ourCount = 0;
+		std::vector<std::thread> workers;
+		for ( int t=0 ; t<numThreads ; t++ )
+		{
+			long long chunkFirst = roundFirst + (long long)t*SWEEP_CHUNK_CELLS;
+			long long left = firstCell + numCells - chunkFirst;
+			if ( left <= 0 ) break;
+			int chunkCount = (left < SWEEP_CHUNK_CELLS) ? (int)left : SWEEP_CHUNK_CELLS;
+			unsigned char *out = &records[(size_t)t*SWEEP_CHUNK_CELLS*SWEEP_RECORD_SIZE];
+			roundCount += chunkCount;
+
+			if ( t == 0 )
+			{
+				// ours, once the rest are going
+				ourCount = chunkCount;
+				continue;
+			}
+			workers.push_back(std::thread(&Sweep::runChunk, this, contexts[t], chunkFirst, chunkCount, out));
+		}
+		runChunk(contexts[0], roundFirst, ourCount, &records[0]);
+		for ( int i=0 ; i<(int)workers.size() ; i++ )
+		{
+			workers[i].join();
+		}
+
+		// the chunks are back to back, so the round goes out in one go
+		size_t roundBytes = (size_t)roundCount*SWEEP_RECORD_SIZE;
+		bOK = (fwrite(&records[0], 1, roundBytes, f) == roundBytes) && (fflush(f) == 0);
+		numDone += roundCount;
+	}
+	fclose(f);
+
+	for ( int t=0 ; t<(int)contexts.size() ; t++ )
+	{
+		traj_destroy(contexts[t]);
+	}
+	return bOK;
+}
+
+bool Sweep::runAll(const char *outDir, int numShards, int numThreads, const char *mergedFilename)
+{
+	if ( numShards < 1 ) return false;
+	mkdir(outDir, 0755);
+
+	// a process per shard
+	fflush(stdout);
+	std::vector<pid_t> workers;
+	for ( int k=0 ; k<numShards ; k++ )
+	{
+		pid_t pid = fork();
+		if ( pid == 0 )
+		{
+			_exit(runShard(outDir, k, numShards, numThreads) ? 0 : 1);
+		}
+		if ( pid > 0 ) workers.push_back(pid);
+	}
+
+	bool bOK = ((int)workers.size() == numShards);
+	for ( int i=0 ; i<(int)workers.size() ; i++ )
+	{
+		int status = 0;
+		if ( (waitpid(workers[i], &status, 0) == -1) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0) ) bOK = false;
+	}
+	if ( !bOK ) return false;
+
+	return merge(outDir, numShards, mergedFilename);
+}
+
+bool Sweep::merge(const char *outDir, int numShards, const char *mergedFilename)
+{
+	if ( numShards < 1 ) return false;
+
+	FILE *out = fopen(mergedFilename, "wb");
+	if ( out == NULL ) return false;
+
+	unsigned char header[SWEEP_HEADER_SIZE];
+	makeHeader(0, m_spec.getNumCells(), header);
+	bool bOK = (fwrite(header, 1, SWEEP_HEADER_SIZE, out) == SWEEP_HEADER_SIZE);
+
+	// the shards are in cell order, so it's their records one after another
+	std::vector<unsigned char> records((size_t)SWEEP_CHUNK_CELLS*SWEEP_RECORD_SIZE);
+	for ( int k=0 ; bOK && (k<numShards) ; k++ )
+	{
+		long long firstCell, numCells;
+		getShardRange(k, numShards, firstCell, numCells);
+
+		char filename[1024];
+		getShardFilename(outDir, k, numShards, filename, sizeof(filename));
+		FILE *f = fopen(filename, "rb");
+		if ( (f == NULL) || !checkHeader(f, firstCell, numCells) )
+		{
+			if ( f != NULL ) fclose(f);
+			bOK = false;
+			break;
+		}
+
+		long long numCopied = 0;
+		while ( bOK && (numCopied < numCells) )
+		{
+			int count = (numCells - numCopied < SWEEP_CHUNK_CELLS) ? (int)(numCells - numCopied) : SWEEP_CHUNK_CELLS;
+			size_t bytes = (size_t)count*SWEEP_RECORD_SIZE;
+			if ( fread(&records[0], 1, bytes, f) != bytes )
+			{
+				// not finished
+				bOK = false;
+				break;
+			}
+			for ( int i=0 ; i<count ; i++ )
+			{
+				if ( getLong(&records[i*SWEEP_RECORD_SIZE]) != firstCell+numCopied+i ) bOK = false;
+			}
+			if ( bOK ) bOK = (fwrite(&records[0], 1, bytes, out) == bytes);
+			numCopied += count;
+		}
+		fclose(f);
+	}
+
+	if ( fclose(out) != 0 ) bOK = false;
+	if ( !bOK ) remove(mergedFilename);
+	return bOK;
+}
+
+#endif
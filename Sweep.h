@@ -0,0 +1,107 @@
+
+#ifndef __SWEEP__
+#define __SWEEP__
+
+// the sweep runs shards as processes, so it's not built on windows
+#ifndef _WIN32
+
+#include "TrajectoryAPI.h"
+#include <stdio.h>
+#include <vector>
+
+// bump this when the result file layout changes
+#define SWEEP_FILE_VERSION 2
+
+// bytes in a result file header and in each cell's record
+#define SWEEP_HEADER_SIZE 64
+#define SWEEP_RECORD_SIZE 60
+
+// each thread propagates this many cells at a time. The shard file is written
+// (and can be picked up from) after every round of chunks.
+#define SWEEP_CHUNK_CELLS 256
+
+// cells whose coasts drift are run again with finer steps, up to this many a day
+#define SWEEP_MAX_SUBSTEPS 8
+
+// The grid we sweep: departure day x burn angle x burn length. The ship coasts
+// with earth until it departs, burns at full thrust at the angle for the length,
+// then coasts to the end.
+class SweepSpec
+{
+public:
+	SweepSpec();
+
+	// a text file of the nine numbers below, in order, separated by white space
+	bool load(const char *filename);
+
+	long long getNumCells();
+
+	// the inputs for one cell. Cells go by departure, then angle, then burn length.
+	void getCell(long long cellIdx, int &outDepartIdx, double &outAngle, int &outBurnDays);
+
+	int m_firstDepart; // days
+	int m_numDeparts;
+	int m_departStep;
+	int m_numAngles;
+	double m_firstAngle; // radians, relative to the direction to the sun
+	double m_angleStep;
+	int m_firstBurn; // days
+	int m_numBurns;
+	int m_burnStep;
+};
+
+// Sweeps a grid in shards. The cells are split in to numShards contiguous runs,
+// the same way every time, so each shard can run on its own: a process here, or
+// a machine sharing the output directory. Each shard writes its own result file
+// as it goes, and picks up where that left off if it's run again.
+//
+// Every cell's result only depends on its inputs, and the merge just puts the
+// records back in cell order under a header for the whole grid. So the merged
+// file is the same, byte for byte, however many shards made it.
+//
+// Files are little endian and unpadded. The header is:
+//   int version, then the spec in order (ints as 4 bytes, doubles as 8),
+//   long long first cell, long long number of cells, padded with zeros to SWEEP_HEADER_SIZE
+// Then a record per cell:
+//   long long cell, int status, int number of points, int halt point,
+//   int 1 if it reached mars's sphere of influence, double when,
+//   double closest distance to mars (km), double when,
+//   int steps a day it was run with, double worst energy drift over the coasts
+class Sweep
+{
+public:
+	Sweep();
+	~Sweep();
+
+	bool init(const char *specFilename);
+
+	// run one shard with numThreads threads, writing to outDir. Returns false on failure.
+	bool runShard(const char *outDir, int shardIdx, int numShards, int numThreads);
+
+	// run every shard, each in its own process, then merge them
+	bool runAll(const char *outDir, int numShards, int numThreads, const char *mergedFilename);
+
+	// put the shards back together. They all have to be complete.
+	bool merge(const char *outDir, int numShards, const char *mergedFilename);
+
+	void getShardRange(int shardIdx, int numShards, long long &outFirst, long long &outCount);
+
+private:
+	void getShardFilename(const char *outDir, int shardIdx, int numShards, char *outFilename, int size);
+	void makeHeader(long long firstCell, long long numCells, unsigned char *out);
+	bool checkHeader(FILE *f, long long firstCell, long long numCells);
+	long long resumeShard(const char *filename, long long firstCell, long long numCells); // the cells already done, or -1
+
+	// propagate count cells from firstCell, writing the records in to out
+	void runChunk(traj_context *ctx, long long firstCell, int count, unsigned char *out);
+
+	SweepSpec m_spec;
+
+	// where the ship and mars start, from the scenario
+	double m_shipStart[4];
+	double m_marsStart[4];
+};
+
+#endif
+
+#endif
@@ -0,0 +1,65 @@
+
+#include "Sweep.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+// usage: trajectory-sweep run <spec file> <out dir> <shards> [threads per shard]
+//        trajectory-sweep shard <spec file> <out dir> <shard> <shards> [threads]
+//        trajectory-sweep merge <spec file> <out dir> <shards> <merged file>
+//
+// run does every shard here, a process each, and merges them in to <out dir>/sweep.dat.
+// shard does just one, so shards can be spread over machines sharing <out dir>.
+// Running a shard again picks up where it stopped.
+static int usage()
+{
+	printf("usage: trajectory-sweep run <spec file> <out dir> <shards> [threads per shard]\n");
+	printf("       trajectory-sweep shard <spec file> <out dir> <shard> <shards> [threads]\n");
+	printf("       trajectory-sweep merge <spec file> <out dir> <shards> <merged file>\n");
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	if ( argc < 5 ) return usage();
+
+	const char *command = argv[1];
+	Sweep sweep;
+	if ( !sweep.init(argv[2]) )
+	{
+		printf("Couldn't read the spec %s\n", argv[2]);
+		return 1;
+	}
+	const char *outDir = argv[3];
+
+	int numThreads = (int)std::thread::hardware_concurrency();
+	if ( numThreads < 1 ) numThreads = 1;
+
+	bool bOK;
+	if ( strcmp(command, "run") == 0 )
+	{
+		int numShards = atoi(argv[4]);
+		if ( argc > 5 ) numThreads = atoi(argv[5]);
+
+		char mergedFilename[1024];
+		snprintf(mergedFilename, sizeof(mergedFilename), "%s/sweep.dat", outDir);
+		bOK = sweep.runAll(outDir, numShards, numThreads, mergedFilename);
+	}
+	else if ( (strcmp(command, "shard") == 0) && (argc > 5) )
+	{
+		if ( argc > 6 ) numThreads = atoi(argv[6]);
+		bOK = sweep.runShard(outDir, atoi(argv[4]), atoi(argv[5]), numThreads);
+	}
+	else if ( (strcmp(command, "merge") == 0) && (argc > 5) )
+	{
+		bOK = sweep.merge(outDir, atoi(argv[4]), argv[5]);
+	}
+	else
+	{
+		return usage();
+	}
+
+	printf(bOK ? "Done\n" : "Failed\n");
+	return bOK ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+
+#include "ThrustSchedule.h"
+#include "Path.h"
+#include <math.h>
+#include <string.h>
+
+ThrustSchedule::ThrustSchedule()
+{
+	m_lastStep = 0;
+}
+
+void ThrustSchedule::addArc(int start, int type, bool bRedirect, double angle, double mag, double rotX, double rotY)
+{
+	// another point on the same step takes over from the one before, the same
+	// as walking the list does
+	if ( !m_arcs.empty() && (m_arcs.back().m_start == start) )
+	{
+		m_arcs.pop_back();
+	}
+
+	// nothing new? Then it's more of the same run.
+	if ( !m_arcs.empty() && !bRedirect && (type != ACCTYPE_STOPTRACE) )
+	{
+		ThrustArc &last = m_arcs.back();
+		if ( (last.m_type != THRUSTARC_COAST) && (last.m_angle == angle) && (last.m_mag == mag) ) return;
+	}
+
+	ThrustArc arc;
+	arc.m_start = start;
+	arc.m_end = start;
+	arc.m_type = type;
+	arc.m_bRedirect = bRedirect;
+	arc.m_angle = angle;
+	arc.m_mag = mag;
+	arc.m_rotX = rotX;
+	arc.m_rotY = rotY;
+	m_arcs.push_back(arc);
+}
+
+void ThrustSchedule::build(std::list<AccelerationPoint *> &points, int lastStep)
+{
+	m_arcs.clear();
+	m_lastStep = lastStep;
+
+	// no thrust until the first point
+	addArc(0, THRUSTARC_COAST, false, 0.0, 0.0, 0.0, 0.0);
+
+	for ( AccelerationPointIter iter = points.begin() ; iter != points.end() ; iter++ )
+	{
+		AccelerationPoint *ap = *iter;
+		if ( ap->m_pointIdx > lastStep ) break;
+
+		addArc(ap->m_pointIdx, ap->m_type, ap->m_type == ACCTYPE_REDIRECT, ap->m_angle, ap->m_mag, ap->m_rotX, ap->m_rotY);
+		if ( ap->m_type == ACCTYPE_STOPTRACE ) break;
+	}
+
+	// each run goes up to the start of the next
+	for ( int i=0 ; i<(int)m_arcs.size() ; i++ )
+	{
+		m_arcs[i].m_end = (i+1 < (int)m_arcs.size()) ? m_arcs[i+1].m_start-1 : lastStep;
+	}
+}
+
+int ThrustSchedule::findArc(int step)
+{
+	int lo = 0;
+	int hi = (int)m_arcs.size()-1;
+	while ( lo < hi )
+	{
+		int mid = (lo + hi + 1)/2;
+		if ( m_arcs[mid].m_start <= step )
+		{
+			lo = mid;
+		}
+		else
+		{
+			hi = mid-1;
+		}
+	}
+	return lo;
+}
+
+static void packInt(std::vector<unsigned char> &out, int value, int numBytes)
+{
+	for ( int i=0 ; i<numBytes ; i++ )
+	{
+		out.push_back((unsigned char)(((unsigned int)value >> (i*8)) & 0xff));
+	}
+}
+
+static void packFloat(std::vector<unsigned char> &out, double value)
+{
+	float f = (float)value;
+	unsigned int bits;
+	memcpy(&bits, &f, 4);
+	packInt(out, (int)bits, 4);
+}
+
+static unsigned int unpackInt(const unsigned char *data, int numBytes)
+{
+	unsigned int value = 0;
+	for ( int i=0 ; i<numBytes ; i++ )
+	{
+		value |= ((unsigned int)data[i]) << (i*8);
+	}
+	return value;
+}
+
+static double unpackFloat(const unsigned char *data)
+{
+	unsigned int bits = unpackInt(data, 4);
+	float f;
+	memcpy(&f, &bits, 4);
+	return (double)f;
+}
+
+void ThrustSchedule::pack(std::vector<unsigned char> &out)
+{
+	packInt(out, (int)m_arcs.size(), 2);
+	packInt(out, m_lastStep, 2);
+	for ( int i=0 ; i<(int)m_arcs.size() ; i++ )
+	{
+		// the ends are where the next one starts, so they aren't kept
+		ThrustArc &arc = m_arcs[i];
+		packInt(out, arc.m_start, 2);
+		packInt(out, arc.m_type+1, 1);
+		packFloat(out, arc.m_angle);
+		packFloat(out, arc.m_mag);
+	}
+}
+
+bool ThrustSchedule::unpack(const unsigned char *data, int size, int &pos, int numSteps)
+{
+	if ( pos+4 > size ) return false;
+	int count = (int)unpackInt(&data[pos], 2);
+	int lastStep = (int)unpackInt(&data[pos+2], 2);
+	if ( (count < 1) || (lastStep >= numSteps) ) return false;
+	if ( pos+4+count*THRUSTSCHEDULE_PACKED_ARC_SIZE > size ) return false;
+	pos += 4;
+
+	m_arcs.clear();
+	m_lastStep = lastStep;
+	for ( int i=0 ; i<count ; i++ )
+	{
+		const unsigned char *packed = &data[pos];
+		ThrustArc arc;
+		arc.m_start = (int)unpackInt(packed, 2);
+		arc.m_type = (int)packed[2] - 1;
+		arc.m_bRedirect = (arc.m_type == ACCTYPE_REDIRECT);
+		arc.m_angle = unpackFloat(&packed[3]);
+		arc.m_mag = unpackFloat(&packed[7]);
+		arc.m_rotX = cos(arc.m_angle)*arc.m_mag;
+		arc.m_rotY = sin(arc.m_angle)*arc.m_mag;
+		pos += THRUSTSCHEDULE_PACKED_ARC_SIZE;
+
+		// the runs have to go forwards, from step 0, and stay on the path
+		if ( (arc.m_type < THRUSTARC_COAST) || (arc.m_type > ACCTYPE_STOPTRACE) ) return false;
+		if ( (i == 0) ? (arc.m_start != 0) : (arc.m_start <= m_arcs.back().m_start) ) return false;
+		if ( arc.m_start > lastStep ) return false;
+		m_arcs.push_back(arc);
+	}
+
+	for ( int i=0 ; i<count ; i++ )
+	{
+		m_arcs[i].m_end = (i+1 < count) ? m_arcs[i+1].m_start-1 : lastStep;
+	}
+	return true;
+}
+
+void ThrustSchedule::makeAccelerationPoints(std::list<AccelerationPoint *> &outPoints)
+{
+	for ( int i=0 ; i<(int)m_arcs.size() ; i++ )
+	{
+		ThrustArc &arc = m_arcs[i];
+		if ( arc.m_type == THRUSTARC_COAST ) continue;
+
+		AccelerationPoint *ap = new AccelerationPoint();
+		ap->m_pointIdx = arc.m_start;
+		ap->m_type = arc.m_type;
+		ap->setAccel(arc.m_angle, arc.m_mag);
+		outPoints.push_back(ap);
+	}
+}
@@ -0,0 +1,122 @@
+
+#ifndef __THRUSTSCHEDULE__
+#define __THRUSTSCHEDULE__
+
+#include <list>
+#include <vector>
+#include "PathKernel.h"
+
+class AccelerationPoint;
+
+// the type of the arc before the first acceleration point, where there's no thrust at all
+#define THRUSTARC_COAST (-1)
+
+// bytes per arc in the packed form: start step, flags, angle and magnitude
+#define THRUSTSCHEDULE_PACKED_ARC_SIZE 11
+
+// a run of steps with the same thrust
+class ThrustArc
+{
+public:
+	int m_start;     // first step
+	int m_end;       // last step
+	int m_type;      // the ACCTYPE_XXXX of the point that started it, or THRUSTARC_COAST
+	bool m_bRedirect; // reset the direction of travel on the first step
+	double m_angle;
+	double m_mag;
+	double m_rotX;   // (cos, sin)*mag, as AccelerationPoint has it
+	double m_rotY;
+};
+
+// The acceleration points compiled down to what the integrator wants: runs of
+// steps with the thrust for each, covering every step from 0 to the stop point.
+// Points that change nothing are merged in to the run before them, and a stop
+// trace point ends the last run. Walking it is just moving to the next arc when
+// the step passes the end of this one.
+class ThrustSchedule
+{
+public:
+	ThrustSchedule();
+
+	void build(std::list<AccelerationPoint *> &points, int lastStep);
+	void reserve(int numArcs) { m_arcs.reserve(numArcs); } // so building never has to allocate
+
+	int getNumArcs() { return (int)m_arcs.size(); }
+	ThrustArc &getArc(int arcIdx) { return m_arcs[arcIdx]; }
+	int getLastStep() { return m_lastStep; }
+	int findArc(int step); // the arc covering step
+
+	// the compact form, for keeping alongside results. A count, the last step, then
+	// THRUSTSCHEDULE_PACKED_ARC_SIZE bytes per arc. The angle and magnitude are kept
+	// as floats, so a packed schedule is close to the original rather than exact.
+	void pack(std::vector<unsigned char> &out);
+	// false if it's cut short or doesn't make sense. numSteps is how many steps the
+	// path it's for has, so a Path's is PATH_NUM_POINTS and a MissionPath's its point count.
+	bool unpack(const unsigned char *data, int size, int &pos, int numSteps);
+
+	// turn it back in to acceleration points, one per arc. The caller owns them.
+	void makeAccelerationPoints(std::list<AccelerationPoint *> &outPoints);
+
+private:
+	void addArc(int start, int type, bool bRedirect, double angle, double mag, double rotX, double rotY);
+
+	std::vector<ThrustArc> m_arcs;
+	int m_lastStep;
+};
+
+// Steps a state through a schedule a day at a time, with any kernel. This is the
+// one stepping loop: Path, MissionPath and the integrator harness all go through
+// it, so they can't drift apart. Days have to be stepped in order from firstStep.
+template <typename Kernel>
+class ScheduleStepper
+{
+public:
+	typedef typename Kernel::Scalar T;
+	typedef typename Kernel::Vec Vec;
+
+	ScheduleStepper(ThrustSchedule &schedule, const Vec &center, T sgp, int substeps, double dayTime, int firstStep)
+		: m_schedule(schedule), m_center(center), m_sgp(sgp), m_substeps(substeps), m_dt((T)(dayTime/(double)substeps))
+	{
+		m_arcIdx = schedule.findArc(firstStep);
+		m_arc = &schedule.getArc(m_arcIdx);
+	}
+
+	// the arc the last day stepped was in
+	ThrustArc &getArc() { return *m_arc; }
+
+	// step day i: from point i-1 to point i
+	inline void stepDay(typename Kernel::State &state, int i)
+	{
+		if ( i > m_arc->m_end )
+		{
+			m_arcIdx++;
+			m_arc = &m_schedule.getArc(m_arcIdx);
+		}
+
+		for ( int s=0 ; s<m_substeps ; s++ )
+		{
+			// work out the thrust, relative to the direction to the orbitee
+			Vec thrust((T)0, (T)0);
+			bool bRedirect = false;
+			if ( m_arc->m_type != THRUSTARC_COAST )
+			{
+				thrust = Kernel::thrustRot(m_center, state.m_pos, (T)m_arc->m_rotX, (T)m_arc->m_rotY);
+				bRedirect = m_arc->m_bRedirect && (m_arc->m_start == i) && (s == 0);
+			}
+
+			// gravity, thrust, and the move
+			Kernel::step(state, m_center, m_sgp, thrust, m_dt, bRedirect);
+		}
+	}
+
+private:
+	ThrustSchedule &m_schedule;
+	Vec m_center;
+	T m_sgp;
+	int m_substeps;
+	T m_dt;
+	int m_arcIdx;
+	ThrustArc *m_arc;
+};
+
+#endif
@@ -0,0 +1,194 @@
+
+#include "TrajectoryAPI.h"
+#include "OBScenario.h"
+#include "DriftMonitor.h"
+#include <new>
+
+// the interface's constants have to agree with the app's
+#if (TRAJ_NUM_POINTS != PATH_NUM_POINTS) || (TRAJ_ACCEL_NORMAL != ACCTYPE_NORMAL) || \
+	(TRAJ_ACCEL_REDIRECT != ACCTYPE_REDIRECT) || (TRAJ_ACCEL_STOPTRACE != ACCTYPE_STOPTRACE)
+#error TrajectoryAPI.h is out of step with Path.h
+#endif
+
+// the caller's points are x, y pairs of doubles, which we write as PathPoints
+static_assert(sizeof(PathPoint) == sizeof(double)*2, "PathPoint has to be two packed doubles");
+
+// everything a propagation needs, made up front so a batch never allocates
+struct traj_context
+{
+	OBScenario m_scenario;
+
+	// acceleration points not in use. The ship's are moved between here and its
+	// list, which doesn't allocate either.
+	AccelerationPointList m_spare;
+
+	// where mars was last worked out from, so a batch with one mars only does it once
+	bool m_bMarsValid;
+	double m_marsStart[4];
+
+	// watches the ship's coasts
+	DriftMonitor m_drift;
+
+	// the ship's points when the caller doesn't want them
+	PathPoint m_scratchPoints[PATH_NUM_POINTS];
+};
+
+static bool checkAccelPoints(const traj_batch_in *in, int first, int count)
+{
+	if ( (count < 0) || (count > PATH_NUM_POINTS) ) return false;
+
+	// the propagation needs them in order, and in range
+	int lastStep = -1;
+	for ( int i=first ; i<first+count ; i++ )
+	{
+		int step = in->accel_step[i];
+		int type = in->accel_type[i];
+		if ( (step < 0) || (step >= PATH_NUM_POINTS) || (step <= lastStep) ) return false;
+		if ( (type < ACCTYPE_NORMAL) || (type > ACCTYPE_STOPTRACE) ) return false;
+		lastStep = step;
+	}
+	return true;
+}
+
+static void setMars(traj_context *ctx, double posX, double posY, double velX, double velY)
+{
+	if ( ctx->m_bMarsValid &&
+		(ctx->m_marsStart[0] == posX) && (ctx->m_marsStart[1] == posY) &&
+		(ctx->m_marsStart[2] == velX) && (ctx->m_marsStart[3] == velY) ) return;
+
+	Path &mars = ctx->m_scenario.m_marsPath;
+	mars.m_startPos.setXY(posX, posY);
+	mars.m_startVel.setXY(velX, velY);
+	mars.calcPoints();
+
+	ctx->m_marsStart[0] = posX;
+	ctx->m_marsStart[1] = posY;
+	ctx->m_marsStart[2] = velX;
+	ctx->m_marsStart[3] = velY;
+	ctx->m_bMarsValid = true;
+}
+
+static void setShipAccelPoints(traj_context *ctx, const traj_batch_in *in, int first, int count)
+{
+	AccelerationPointList &points = ctx->m_scenario.m_ship.m_accelerationPoints;
+	ctx->m_spare.splice(ctx->m_spare.end(), points);
+	for ( int i=first ; i<first+count ; i++ )
+	{
+		AccelerationPoint *ap = ctx->m_spare.front();
+		ap->m_pointIdx = in->accel_step[i];
+		ap->m_type = in->accel_type[i];
+		ap->setAccel(in->accel_angle[i], in->accel_mag[i]);
+		points.splice(points.end(), ctx->m_spare, ctx->m_spare.begin());
+	}
+}
+
+int traj_api_version(void)
+{
+	return TRAJ_API_VERSION;
+}
+
+traj_context *traj_create(void)
+{
+	traj_context *ctx = new (std::nothrow) traj_context();
+	if ( ctx == NULL ) return NULL;
+
+	OBScenario &scenario = ctx->m_scenario;
+	scenario.init();
+	ctx->m_bMarsValid = false;
+
+	// no caches. They grow, and the caller can keep their own results.
+	scenario.m_earthPath.m_cache = NULL;
+	scenario.m_marsPath.m_cache = NULL;
+	scenario.m_ship.m_cache = NULL;
+
+	// enough acceleration points and thrust runs for any ship
+	for ( int i=0 ; i<PATH_NUM_POINTS ; i++ )
+	{
+		ctx->m_spare.push_back(new AccelerationPoint());
+	}
+	scenario.m_ship.m_schedule.reserve(PATH_NUM_POINTS+1);
+	scenario.m_ship.m_driftMonitor = &ctx->m_drift;
+	return ctx;
+}
+
+void traj_destroy(traj_context *ctx)
+{
+	if ( ctx == NULL ) return;
+
+	AccelerationPointList &points = ctx->m_scenario.m_ship.m_accelerationPoints;
+	ctx->m_spare.splice(ctx->m_spare.end(), points);
+	for ( AccelerationPointIter iter = ctx->m_spare.begin() ; iter != ctx->m_spare.end() ; iter++ )
+	{
+		delete *iter;
+	}
+	ctx->m_spare.clear();
+	delete ctx;
+}
+
+int traj_propagate_batch(traj_context *ctx, const traj_batch_in *in, traj_batch_out *out)
+{
+	if ( (ctx == NULL) || (in == NULL) || (out == NULL) ) return 0;
+	if ( (in->ship_pos_x == NULL) || (in->ship_pos_y == NULL) || (in->ship_vel_x == NULL) || (in->ship_vel_y == NULL) ||
+		(in->mars_pos_x == NULL) || (in->mars_pos_y == NULL) || (in->mars_vel_x == NULL) || (in->mars_vel_y == NULL) ) return 0;
+	if ( (in->accel_first != NULL) &&
+		((in->accel_step == NULL) || (in->accel_type == NULL) || (in->accel_angle == NULL) || (in->accel_mag == NULL)) ) return 0;
+
+	OBScenario &scenario = ctx->m_scenario;
+	Path &ship = scenario.m_ship;
+	DriftMonitor &drift = ctx->m_drift;
+	drift.m_threshold = (in->drift_threshold > 0.0) ? in->drift_threshold : DRIFT_DEFAULT_THRESHOLD;
+	int numOK = 0;
+	for ( int i=0 ; i<in->count ; i++ )
+	{
+		int first = 0;
+		int numAccel = 0;
+		if ( in->accel_first != NULL )
+		{
+			first = in->accel_first[i];
+			numAccel = in->accel_first[i+1] - first;
+		}
+		if ( (first < 0) || !checkAccelPoints(in, first, numAccel) )
+		{
+			if ( out->status != NULL ) out->status[i] = TRAJ_STATUS_BAD_INPUT;
+			continue;
+		}
+
+		// set it up
+		setMars(ctx, in->mars_pos_x[i], in->mars_pos_y[i], in->mars_vel_x[i], in->mars_vel_y[i]);
+		ship.m_startPos.setXY(in->ship_pos_x[i], in->ship_pos_y[i]);
+		ship.m_startVel.setXY(in->ship_vel_x[i], in->ship_vel_y[i]);
+		setShipAccelPoints(ctx, in, first, numAccel);
+
+		// and run it, straight in to the caller's points if they want them
+		PathPoint *points = ctx->m_scratchPoints;
+		if ( out->points != NULL )
+		{
+			points = (PathPoint *)&out->points[(long long)i*PATH_NUM_POINTS*2];
+		}
+		ship.setSubsteps(1);
+		int numPoints = ship.propagate<PathKernelDefault, PathPoint>(points);
+
+		// if the steps look too coarse for it, do it again finer
+		while ( drift.isFlagged() && (ship.getSubsteps()*2 <= in->max_substeps) )
+		{
+			ship.setSubsteps(ship.getSubsteps()*2);
+			numPoints = ship.propagate<PathKernelDefault, PathPoint>(points);
+		}
+
+		PathEvent *soi = scenario.m_marsSOIEvent;
+		PathEvent *closest = scenario.m_marsClosestEvent;
+		if ( out->status != NULL ) out->status[i] = TRAJ_STATUS_OK;
+		if ( out->num_points != NULL ) out->num_points[i] = numPoints;
+		if ( out->halt_idx != NULL ) out->halt_idx[i] = ship.m_haltIdx;
+		if ( out->soi_fired != NULL ) out->soi_fired[i] = soi->m_bFired ? 1 : 0;
+		if ( out->soi_time != NULL ) out->soi_time[i] = soi->m_time;
+		if ( out->closest_dist != NULL ) out->closest_dist[i] = closest->m_dist;
+		if ( out->closest_time != NULL ) out->closest_time[i] = closest->m_time;
+		if ( out->energy_drift != NULL ) out->energy_drift[i] = drift.m_maxEnergyDrift;
+		if ( out->ang_mom_drift != NULL ) out->ang_mom_drift[i] = drift.m_maxAngMomDrift;
+		if ( out->drift_flagged != NULL ) out->drift_flagged[i] = drift.isFlagged() ? 1 : 0;
+		if ( out->substeps != NULL ) out->substeps[i] = ship.getSubsteps();
+		numOK++;
+	}
+	return numOK;
+}
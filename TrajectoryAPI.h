@@ -0,0 +1,115 @@
+
+#ifndef __TRAJECTORYAPI__
+#define __TRAJECTORYAPI__
+
+/* A C interface to the simulation core, for building it as a shared library and
+   calling it from other tools.
+
+   The caller owns all the memory. Inputs are structure of arrays: one array per
+   value, with an entry per scenario. Outputs are written straight in to the
+   caller's arrays. A context holds the bodies and paths a propagation works in,
+   and once it's made, propagating doesn't allocate anything.
+
+   There's no global state. A context must only be used by one thread at a time,
+   so give each thread its own, and they can all run at once. */
+
+#if defined(_WIN32)
+	#if defined(TRAJ_BUILDING_LIBRARY)
+		#define TRAJ_EXPORT __declspec(dllexport)
+	#else
+		#define TRAJ_EXPORT __declspec(dllimport)
+	#endif
+#else
+	#define TRAJ_EXPORT __attribute__((visibility("default")))
+#endif
+
+/* bump this when anything below changes in a way old callers would notice */
+#define TRAJ_API_VERSION 2
+
+/* every path has this many points, a day apart */
+#define TRAJ_NUM_POINTS 900
+#define TRAJ_POINT_SECONDS 86400.0
+
+/* acceleration point types. The same as the app's ACCTYPE_XXXX. */
+#define TRAJ_ACCEL_NORMAL 0
+#define TRAJ_ACCEL_REDIRECT 1  /* reset the direction of travel, keep the speed */
+#define TRAJ_ACCEL_STOPTRACE 2 /* the path ends here */
+
+/* per scenario status */
+#define TRAJ_STATUS_OK 0
+#define TRAJ_STATUS_BAD_INPUT 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct traj_context traj_context;
+
+/* a batch of scenarios. Positions are km and velocities km/s, relative to the sun,
+   the same as a save file. */
+typedef struct traj_batch_in
+{
+	int count; /* how many scenarios */
+
+	/* where the ship and mars start. count entries each. */
+	const double *ship_pos_x;
+	const double *ship_pos_y;
+	const double *ship_vel_x;
+	const double *ship_vel_y;
+	const double *mars_pos_x;
+	const double *mars_pos_y;
+	const double *mars_vel_x;
+	const double *mars_vel_y;
+
+	/* the ship's acceleration points, every scenario's back to back. Scenario i's are
+	   entries accel_first[i] to accel_first[i+1]-1, so accel_first has count+1 entries.
+	   Each scenario's have to be in step order, with no two on the same step. */
+	const int *accel_first;
+	const int *accel_step;    /* the point it starts at, 0 to TRAJ_NUM_POINTS-1 */
+	const int *accel_type;    /* a TRAJ_ACCEL_XXXX constant */
+	const double *accel_angle; /* radians, relative to the direction to the sun */
+	const double *accel_mag;   /* km/s^2 */
+
+	/* the ship's energy and angular momentum are watched over the coasts, and if they
+	   drift more than drift_threshold (see DriftMonitor.h, 0 for the default), the
+	   scenario is run again with each day split in to twice as many steps, until it's
+	   under or it would take more than max_substeps. 0 or 1 means no reruns. */
+	double drift_threshold;
+	int max_substeps;
+} traj_batch_in;
+
+/* where the results go. Each array has count entries, except points. Any of them
+   can be NULL if you don't want it. */
+typedef struct traj_batch_out
+{
+	/* TRAJ_NUM_POINTS x, y pairs per scenario. Only the first num_points of each are
+	   written. After a halt, the rest sit at the halt point. */
+	double *points;
+
+	int *status;          /* TRAJ_STATUS_XXXX. If it isn't OK, nothing else is written for that scenario. */
+	int *num_points;      /* up to the stop trace point, or TRAJ_NUM_POINTS */
+	int *halt_idx;        /* where it got too close to the sun, or -1 */
+	int *soi_fired;       /* 1 if it got inside mars's sphere of influence */
+	double *soi_time;     /* when, in seconds */
+	double *closest_dist; /* closest distance to mars, in km */
+	double *closest_time; /* and when, in seconds */
+	double *energy_drift;  /* the worst drift over the coasts, from the last run */
+	double *ang_mom_drift;
+	int *drift_flagged;   /* 1 if it was still over the threshold on the last run */
+	int *substeps;        /* the steps a day the results are from */
+} traj_batch_out;
+
+TRAJ_EXPORT int traj_api_version(void);
+
+/* make a context, or NULL if there's no memory for it */
+TRAJ_EXPORT traj_context *traj_create(void);
+TRAJ_EXPORT void traj_destroy(traj_context *ctx);
+
+/* propagate every scenario in the batch, in order. Returns how many were OK. */
+TRAJ_EXPORT int traj_propagate_batch(traj_context *ctx, const traj_batch_in *in, traj_batch_out *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
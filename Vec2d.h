@@ -0,0 +1,73 @@
+
+#ifndef __VEC2D__
+#define __VEC2D__
+
+#include <cmath>
+
+// SSE2 is always there on x64, and gcc/clang tell us when it's on for x86
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VEC2D_SSE2
+#include <emmintrin.h>
+#endif
+
+// A 2d double vector by value, for the math core. Everything is inline, and
+// it's trivially copyable, so the compiler can keep it in a register and fuse
+// the per-step arithmetic instead of calling out to FGDoubleVector. With SSE2
+// both lanes go through one instruction; without it it's two plain doubles,
+// and the results are the same either way.
+//
+// It has the same interface as KernelVec, so the kernels can use it as is.
+class Vec2d
+{
+public:
+	typedef double Scalar;
+
+	Vec2d() {}
+
+#ifdef VEC2D_SSE2
+	Vec2d(double x, double y) : m_v(_mm_set_pd(y, x)) {}
+	explicit Vec2d(__m128d v) : m_v(v) {}
+
+	double x() const { return _mm_cvtsd_f64(m_v); }
+	double y() const { return _mm_cvtsd_f64(_mm_unpackhi_pd(m_v, m_v)); }
+
+	Vec2d operator+(const Vec2d &o) const { return Vec2d(_mm_add_pd(m_v, o.m_v)); }
+	Vec2d operator-(const Vec2d &o) const { return Vec2d(_mm_sub_pd(m_v, o.m_v)); }
+	Vec2d operator*(double s) const { return Vec2d(_mm_mul_pd(m_v, _mm_set1_pd(s))); }
+	Vec2d &operator+=(const Vec2d &o) { m_v = _mm_add_pd(m_v, o.m_v); return *this; }
+	Vec2d &operator-=(const Vec2d &o) { m_v = _mm_sub_pd(m_v, o.m_v); return *this; }
+
+	static double dot(const Vec2d &a, const Vec2d &b)
+	{
+		__m128d p = _mm_mul_pd(a.m_v, b.m_v);
+		return _mm_cvtsd_f64(_mm_add_sd(p, _mm_unpackhi_pd(p, p)));
+	}
+
+	__m128d m_v; // x in the low lane, y in the high
+#else
+	Vec2d(double x, double y) : m_x(x), m_y(y) {}
+
+	double x() const { return m_x; }
+	double y() const { return m_y; }
+
+	Vec2d operator+(const Vec2d &o) const { return Vec2d(m_x+o.m_x, m_y+o.m_y); }
+	Vec2d operator-(const Vec2d &o) const { return Vec2d(m_x-o.m_x, m_y-o.m_y); }
+	Vec2d operator*(double s) const { return Vec2d(m_x*s, m_y*s); }
+	Vec2d &operator+=(const Vec2d &o) { m_x += o.m_x; m_y += o.m_y; return *this; }
+	Vec2d &operator-=(const Vec2d &o) { m_x -= o.m_x; m_y -= o.m_y; return *this; }
+
+	static double dot(const Vec2d &a, const Vec2d &b)
+	{
+		return a.m_x*b.m_x + a.m_y*b.m_y;
+	}
+
+	double m_x;
+	double m_y;
+#endif
+
+	double lengthSq() const { return dot(*this, *this); }
+	double length() const { return std::sqrt(lengthSq()); }
+	double angle() const { return std::atan2(y(), x()); } // the same as FGDoubleVector's, and 0 for a zero vector
+};
+
+#endif